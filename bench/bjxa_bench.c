@@ -0,0 +1,369 @@
+/*-
+ * Copyright (C) 2020  Dridi Boukelmoune
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmark harness.
+ *
+ * Every file is loaded in memory and each operation runs a number of
+ * rounds, keeping the fastest one. The output is one tab-separated line
+ * per file and operation, preceded by a header line starting with '#'.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include <bjxa.h>
+
+#define BENCH_ROUNDS	5
+#define BENCH_HEADERS	100000
+
+struct bench_file {
+	const char	*path;
+	uint8_t		*buf;
+	size_t		len;
+};
+
+struct bench_result {
+	const char	*op;
+	uint64_t	bytes;
+	uint64_t	samples;
+	uint64_t	blocks;
+	uint64_t	ns;
+};
+
+static uint64_t
+bench_now(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
+		perror("clock_gettime");
+		exit(EXIT_FAILURE);
+	}
+	return ((uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec);
+}
+
+static void
+bench_report(const struct bench_file *bf, unsigned bits, unsigned channels,
+    const struct bench_result *res)
+{
+	double secs, ns_block;
+
+	secs = res->ns > 0 ? (double)res->ns / 1e9 : 1e-9;
+	ns_block = 0.0;
+	if (res->blocks > 0)
+		ns_block = (double)res->ns / (double)res->blocks;
+
+	printf("%s\t%s\t%u\t%u\t%ju\t%ju\t%ju\t%ju\t%.2f\t%.0f\t%.1f\n",
+	    bf->path, res->op, bits, channels, (uintmax_t)res->bytes,
+	    (uintmax_t)res->samples, (uintmax_t)res->blocks,
+	    (uintmax_t)res->ns, (double)res->bytes / secs / 1e6,
+	    (double)res->samples / secs, ns_block);
+}
+
+static int
+bench_load(struct bench_file *bf)
+{
+	FILE *file;
+	long len;
+
+	file = fopen(bf->path, "r");
+	if (file == NULL || fseek(file, 0, SEEK_END) < 0 ||
+	    (len = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) < 0) {
+		perror(bf->path);
+		if (file != NULL)
+			(void)fclose(file);
+		return (-1);
+	}
+
+	bf->len = (size_t)len;
+	bf->buf = malloc(bf->len);
+	if (bf->buf == NULL) {
+		perror("malloc");
+		(void)fclose(file);
+		return (-1);
+	}
+
+	if (fread(bf->buf, bf->len, 1, file) != 1) {
+		perror(bf->path);
+		(void)fclose(file);
+		return (-1);
+	}
+
+	(void)fclose(file);
+	return (0);
+}
+
+static int
+bench_xa_rounds(const struct bench_file *bf, bjxa_decoder_t *dec,
+    unsigned rounds)
+{
+	struct bench_result res[3];
+	bjxa_format_t fmt;
+	uint64_t t0, t1;
+	uint32_t xa_len;
+	unsigned bits, r, n;
+	const uint8_t *xa;
+	void *pcm;
+	FILE *null;
+	int ret = 0;
+
+	if (bjxa_parse_header(dec, bf->buf, bf->len) < 0 ||
+	    bjxa_decode_format(dec, &fmt) < 0) {
+		perror(bf->path);
+		return (-1);
+	}
+
+	bits = (fmt.block_size_xa / fmt.channels - 1) / 4;
+	xa = bf->buf + BJXA_HEADER_SIZE_XA;
+	xa_len = fmt.blocks * fmt.block_size_xa;
+	if (bf->len - BJXA_HEADER_SIZE_XA < xa_len) {
+		fprintf(stderr, "%s: truncated XA file\n", bf->path);
+		return (-1);
+	}
+
+	memset(res, 0, sizeof res);
+	res[0].op = "parse_header";
+	res[1].op = "decode";
+	res[2].op = "fwrite_pcm";
+	for (n = 0; n < 3; n++)
+		res[n].ns = UINT64_MAX;
+
+	pcm = malloc(fmt.data_len_pcm);
+	null = fopen("/dev/null", "w");
+
+	if (pcm == NULL || null == NULL) {
+		perror("bench_xa");
+		ret = -1;
+	}
+
+	for (r = 0; ret == 0 && r < rounds; r++) {
+		t0 = bench_now();
+		for (n = 0; n < BENCH_HEADERS; n++)
+			(void)bjxa_parse_header(dec, bf->buf, bf->len);
+		t1 = bench_now();
+		if (t1 - t0 < res[0].ns)
+			res[0].ns = t1 - t0;
+
+		t0 = bench_now();
+		if (bjxa_decode(dec, pcm, fmt.data_len_pcm, xa, xa_len) !=
+		    (int)fmt.blocks) {
+			perror("bjxa_decode");
+			ret = -1;
+			break;
+		}
+		t1 = bench_now();
+		if (t1 - t0 < res[1].ns)
+			res[1].ns = t1 - t0;
+
+		t0 = bench_now();
+		if (bjxa_fwrite_pcm(pcm, fmt.data_len_pcm, null) < 0 ||
+		    fflush(null) != 0) {
+			perror("bjxa_fwrite_pcm");
+			ret = -1;
+			break;
+		}
+		t1 = bench_now();
+		if (t1 - t0 < res[2].ns)
+			res[2].ns = t1 - t0;
+	}
+
+	res[0].bytes = (uint64_t)BJXA_HEADER_SIZE_XA * BENCH_HEADERS;
+	res[1].bytes = xa_len;
+	res[1].samples = fmt.data_len_pcm / sizeof(int16_t);
+	res[1].blocks = fmt.blocks;
+	res[2].bytes = fmt.data_len_pcm;
+	res[2].samples = res[1].samples;
+
+	for (n = 0; ret == 0 && n < 3; n++)
+		bench_report(bf, bits, fmt.channels, &res[n]);
+
+	if (null != NULL)
+		(void)fclose(null);
+	free(pcm);
+	return (ret);
+}
+
+static int
+bench_wav_rounds(const struct bench_file *bf, bjxa_encoder_t *enc,
+    unsigned rounds)
+{
+	struct bench_result res;
+	bjxa_format_t fmt, tmp;
+	uint64_t t0, t1;
+	unsigned bits, r, n;
+	ssize_t off;
+	void *xa;
+	int ret = 0;
+
+	off = bjxa_parse_riff_header(&fmt, bf->buf, bf->len);
+	if (off < 0 || fmt.data_len_pcm == 0 ||
+	    bf->len - (size_t)off < fmt.data_len_pcm) {
+		fprintf(stderr, "%s: unsupported WAV file\n", bf->path);
+		return (-1);
+	}
+
+	memset(&res, 0, sizeof res);
+	res.op = "parse_riff_header";
+	res.ns = UINT64_MAX;
+
+	for (r = 0; r < rounds; r++) {
+		t0 = bench_now();
+		for (n = 0; n < BENCH_HEADERS; n++)
+			(void)bjxa_parse_riff_header(&tmp, bf->buf, bf->len);
+		t1 = bench_now();
+		if (t1 - t0 < res.ns)
+			res.ns = t1 - t0;
+	}
+
+	res.bytes = (uint64_t)off * BENCH_HEADERS;
+	/* the bits column holds XA bits, there are none yet */
+	bench_report(bf, 0, fmt.channels, &res);
+
+	/* large enough for 8 bits XA blocks */
+	tmp = fmt;
+	if (bjxa_encode_init(enc, &tmp, 8) < 0) {
+		perror("bjxa_encode_init");
+		return (-1);
+	}
+
+	xa = malloc((size_t)tmp.blocks * tmp.block_size_xa);
+	if (xa == NULL) {
+		perror("malloc");
+		return (-1);
+	}
+
+	for (bits = 4; ret == 0 && bits <= 8; bits += 2) {
+		memset(&res, 0, sizeof res);
+		res.op = bits == 4 ? "encode_4bits" :
+		    bits == 6 ? "encode_6bits" : "encode_8bits";
+		res.ns = UINT64_MAX;
+
+		for (r = 0; ret == 0 && r < rounds; r++) {
+			tmp = fmt;
+			t0 = bench_now();
+			if (bjxa_encode_init(enc, &tmp, (uint8_t)bits) < 0 ||
+			    bjxa_encode(enc, xa, (size_t)tmp.blocks *
+			    tmp.block_size_xa, bf->buf + off,
+			    fmt.data_len_pcm) != (int)tmp.blocks) {
+				perror("bjxa_encode");
+				ret = -1;
+			}
+			t1 = bench_now();
+			if (t1 - t0 < res.ns)
+				res.ns = t1 - t0;
+		}
+
+		res.bytes = fmt.data_len_pcm;
+		res.samples = fmt.data_len_pcm / (fmt.sample_bits / 8);
+		res.blocks = tmp.blocks;
+		if (ret == 0)
+			bench_report(bf, bits, fmt.channels, &res);
+	}
+
+	free(xa);
+	return (ret);
+}
+
+static int
+bench_xa(const struct bench_file *bf, unsigned rounds)
+{
+	bjxa_decoder_t *dec;
+	int ret;
+
+	dec = bjxa_decoder();
+	if (dec == NULL) {
+		perror("bjxa_decoder");
+		return (-1);
+	}
+
+	ret = bench_xa_rounds(bf, dec, rounds);
+	(void)bjxa_free_decoder(&dec);
+	return (ret);
+}
+
+static int
+bench_wav(const struct bench_file *bf, unsigned rounds)
+{
+	bjxa_encoder_t *enc;
+	int ret;
+
+	enc = bjxa_encoder();
+	if (enc == NULL) {
+		perror("bjxa_encoder");
+		return (-1);
+	}
+
+	ret = bench_wav_rounds(bf, enc, rounds);
+	(void)bjxa_free_encoder(&enc);
+	return (ret);
+}
+
+int
+main(int argc, char * const *argv)
+{
+	struct bench_file bf;
+	unsigned long rounds = BENCH_ROUNDS;
+	size_t len;
+	char *end;
+	int status = EXIT_SUCCESS;
+
+	argc--;
+	argv++;
+
+	if (argc > 1 && !strcmp("-n", *argv)) {
+		rounds = strtoul(argv[1], &end, 10);
+		if (*end != '\0' || rounds == 0 || rounds > UINT16_MAX) {
+			fprintf(stderr, "bjxa_bench: invalid rounds\n");
+			return (EXIT_FAILURE);
+		}
+		argc -= 2;
+		argv += 2;
+	}
+
+	if (argc == 0) {
+		fprintf(stderr, "Usage: bjxa_bench [-n <rounds>] <file>...\n");
+		return (EXIT_FAILURE);
+	}
+
+	printf("# file\top\tbits\tchannels\tbytes\tsamples\tblocks"
+	    "\tns\tMB/s\tsamples/s\tns/block\n");
+
+	for (; argc > 0; argc--, argv++) {
+		memset(&bf, 0, sizeof bf);
+		bf.path = *argv;
+		len = strlen(bf.path);
+		if (bench_load(&bf) < 0)
+			status = EXIT_FAILURE;
+		else if (len > 3 && !strcmp(bf.path + len - 3, ".xa")) {
+			if (bench_xa(&bf, (unsigned)rounds) < 0)
+				status = EXIT_FAILURE;
+		}
+		else if (bench_wav(&bf, (unsigned)rounds) < 0)
+			status = EXIT_FAILURE;
+
+		free(bf.buf);
+	}
+
+	return (status);
+}
@@ -0,0 +1,245 @@
+/*-
+ * Copyright (C) 2020  Dridi Boukelmoune
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Synthetic corpus for the benchmark suite.
+ *
+ * The output only depends on the PRNG seed, so two runs on different
+ * hosts produce the same files. WAV files contain a mix of square and
+ * triangle waves with some noise. XA files contain random samples with a
+ * mix of profiles resembling real-world files: sync blocks are rare and
+ * most blocks use the first gain factors.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include <bjxa.h>
+
+#define CORPUS_RATE	44100
+#define CORPUS_SEED	0x5eed1e55
+
+static const unsigned corpus_bits[] = { 4, 6, 8 };
+static const unsigned corpus_channels[] = { 1, 2 };
+static const unsigned corpus_seconds[] = { 1, 10, 60 };
+
+/* cumulative distribution of gain factors, out of 16 */
+static const unsigned corpus_factors[] = { 1, 6, 11, 14, 16 };
+
+#define COUNTOF(a) (sizeof(a) / sizeof(*(a)))
+
+static uint32_t rnd_state;
+
+static uint32_t
+rnd_next(void)
+{
+	uint32_t rnd;
+
+	rnd = rnd_state;
+	rnd ^= rnd << 13;
+	rnd ^= rnd >> 17;
+	rnd ^= rnd << 5;
+	rnd_state = rnd;
+	return (rnd);
+}
+
+static void
+put_le(uint8_t **buf, uint32_t val, unsigned len)
+{
+
+	while (len > 0) {
+		**buf = (uint8_t)val;
+		*buf += 1;
+		val >>= 8;
+		len--;
+	}
+}
+
+static FILE *
+corpus_open(const char *dir, const char *name)
+{
+	char path[1024];
+	FILE *file;
+
+	if (snprintf(path, sizeof path, "%s/%s", dir, name) >=
+	    (int)sizeof path) {
+		fprintf(stderr, "bjxa_corpus: path too long: %s\n", name);
+		return (NULL);
+	}
+
+	file = fopen(path, "w");
+	if (file == NULL)
+		perror(path);
+	return (file);
+}
+
+static int
+corpus_close(FILE *file)
+{
+
+	if (ferror(file) || fclose(file) != 0) {
+		perror("fclose");
+		return (-1);
+	}
+	return (0);
+}
+
+static int
+corpus_wav(const char *dir, unsigned chan, unsigned secs)
+{
+	uint8_t hdr[BJXA_HEADER_SIZE_RIFF], *ptr, pcm[4];
+	uint32_t n, samples, data_len;
+	int32_t sample;
+	char name[64];
+	unsigned c;
+	FILE *file;
+
+	(void)snprintf(name, sizeof name, "%uch-%us.wav", chan, secs);
+	file = corpus_open(dir, name);
+	if (file == NULL)
+		return (-1);
+
+	samples = CORPUS_RATE * secs;
+	data_len = samples * chan * 2;
+
+	ptr = hdr;
+	memcpy(ptr, "RIFF", 4);
+	ptr += 4;
+	put_le(&ptr, data_len + 36, 4);
+	memcpy(ptr, "WAVEfmt ", 8);
+	ptr += 8;
+	put_le(&ptr, 16, 4);
+	put_le(&ptr, 1, 2);
+	put_le(&ptr, chan, 2);
+	put_le(&ptr, CORPUS_RATE, 4);
+	put_le(&ptr, CORPUS_RATE * chan * 2, 4);
+	put_le(&ptr, chan * 2, 2);
+	put_le(&ptr, 16, 2);
+	memcpy(ptr, "data", 4);
+	ptr += 4;
+	put_le(&ptr, data_len, 4);
+
+	(void)fwrite(hdr, sizeof hdr, 1, file);
+
+	for (n = 0; n < samples; n++) {
+		ptr = pcm;
+		for (c = 0; c < chan; c++) {
+			/* 441Hz square wave and 110Hz-ish triangle wave */
+			sample = (n / 50 + c) % 2 ? 8000 : -8000;
+			sample += (int32_t)(n % 400) * 80 - 16000;
+			if (n % 800 >= 400)
+				sample = -sample;
+			sample += (int32_t)(rnd_next() % 2048) - 1024;
+			put_le(&ptr, (uint32_t)sample, 2);
+		}
+		(void)fwrite(pcm, chan * 2, 1, file);
+	}
+
+	return (corpus_close(file));
+}
+
+static int
+corpus_xa(const char *dir, unsigned bits, unsigned chan, unsigned secs)
+{
+	bjxa_encoder_t *enc;
+	bjxa_format_t fmt;
+	uint8_t hdr[BJXA_HEADER_SIZE_XA], block[33];
+	uint32_t n, rnd;
+	unsigned b, factor;
+	char name[64];
+	FILE *file;
+
+	enc = bjxa_encoder();
+	if (enc == NULL) {
+		perror("bjxa_encoder");
+		return (-1);
+	}
+
+	memset(&fmt, 0, sizeof fmt);
+	fmt.data_len_pcm = CORPUS_RATE * secs * chan * 2;
+	fmt.samples_rate = CORPUS_RATE;
+	fmt.sample_bits = 16;
+	fmt.channels = (uint8_t)chan;
+
+	/* only the header comes from the encoder */
+	if (bjxa_encode_init(enc, &fmt, (uint8_t)bits) < 0) {
+		perror("bjxa_encode_init");
+		(void)bjxa_free_encoder(&enc);
+		return (-1);
+	}
+
+	if (bjxa_dump_header(enc, hdr, sizeof hdr) < 0) {
+		perror("bjxa_dump_header");
+		(void)bjxa_free_encoder(&enc);
+		return (-1);
+	}
+
+	(void)bjxa_free_encoder(&enc);
+
+	(void)snprintf(name, sizeof name, "%ubits-%uch-%us.xa", bits, chan,
+	    secs);
+	file = corpus_open(dir, name);
+	if (file == NULL)
+		return (-1);
+
+	(void)fwrite(hdr, sizeof hdr, 1, file);
+
+	for (n = 0; n < fmt.blocks * chan; n++) {
+		rnd = rnd_next();
+		factor = 0;
+		while (rnd % 16 >= corpus_factors[factor])
+			factor++;
+		block[0] = (uint8_t)(factor << 4 | (rnd >> 8) % 13);
+		for (b = 1; b < fmt.block_size_xa / chan; b++)
+			block[b] = (uint8_t)rnd_next();
+		(void)fwrite(block, fmt.block_size_xa / chan, 1, file);
+	}
+
+	return (corpus_close(file));
+}
+
+int
+main(int argc, char * const *argv)
+{
+	unsigned b, c, s;
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <directory>\n", *argv);
+		return (EXIT_FAILURE);
+	}
+
+	rnd_state = CORPUS_SEED;
+
+	for (c = 0; c < COUNTOF(corpus_channels); c++) {
+		for (s = 0; s < COUNTOF(corpus_seconds); s++) {
+			if (corpus_wav(argv[1], corpus_channels[c],
+			    corpus_seconds[s]) < 0)
+				return (EXIT_FAILURE);
+			for (b = 0; b < COUNTOF(corpus_bits); b++)
+				if (corpus_xa(argv[1], corpus_bits[b],
+				    corpus_channels[c], corpus_seconds[s]) < 0)
+					return (EXIT_FAILURE);
+		}
+	}
+
+	return (EXIT_SUCCESS);
+}
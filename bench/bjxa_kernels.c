@@ -0,0 +1,396 @@
+/*-
+ * Copyright (C) 2020  Dridi Boukelmoune
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Kernel microbenchmarks.
+ *
+ * The kernels are static functions, so the library source is included
+ * directly. Each kernel runs in isolation over working sets sized to stay
+ * in the L1 or L2 caches, or to spill to memory. When the perf_event_open
+ * system call is available, hardware counters for user-space execution are
+ * reported along with the elapsed time, otherwise they are left out and
+ * printed as '-'. The output follows the format of bjxa_bench.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef HAVE_LINUX_PERF_EVENT_H
+#  include <linux/perf_event.h>
+#  include <sys/ioctl.h>
+#  include <sys/syscall.h>
+#endif
+
+#include "libbjxa.c"
+
+#define KERNEL_ROUNDS	5
+#define KERNEL_BLOCKS	(1 << 22)
+#define KERNEL_EVENTS	4
+
+struct kernel_set {
+	const char	*name;
+	size_t		len;
+};
+
+static const struct kernel_set kernel_sets[] = {
+	{ "l1",		16 << 10 },
+	{ "l2",		256 << 10 },
+	{ "dram",	64 << 20 },
+};
+
+struct kernel_bench {
+	const char	*op;
+	const char	*variant;
+	unsigned	bits;
+	bjxa_inflate_f	*inflate;
+	bjxa_deflate_f	*deflate;
+};
+
+struct kernel_buffers {
+	uint8_t		*xa;
+	int16_t		*pcm;
+	uint8_t		*profiles;
+	size_t		blocks;
+	unsigned	block_size;
+};
+
+struct kernel_result {
+	uint64_t	ns;
+	uint64_t	counters[KERNEL_EVENTS];
+};
+
+#define COUNTOF(a) (sizeof(a) / sizeof(*(a)))
+
+/* hardware counters */
+
+static int kernel_fds[KERNEL_EVENTS];
+
+#ifdef HAVE_LINUX_PERF_EVENT_H
+static const uint64_t kernel_events[KERNEL_EVENTS] = {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_BRANCH_MISSES,
+	PERF_COUNT_HW_CACHE_MISSES,
+};
+
+static void
+kernel_perf_open(void)
+{
+	struct perf_event_attr attr;
+	unsigned n;
+
+	for (n = 0; n < KERNEL_EVENTS; n++) {
+		memset(&attr, 0, sizeof attr);
+		attr.size = sizeof attr;
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = kernel_events[n];
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+
+		/* the first counter leads the group, if any */
+		kernel_fds[n] = (int)syscall(SYS_perf_event_open, &attr, 0,
+		    -1, n > 0 ? kernel_fds[0] : -1, 0);
+		if (n == 0 && kernel_fds[0] < 0)
+			break;
+	}
+
+	for (n++; n < KERNEL_EVENTS; n++)
+		kernel_fds[n] = -1;
+}
+
+static void
+kernel_perf_ioctl(unsigned long req)
+{
+
+	if (kernel_fds[0] >= 0)
+		(void)ioctl(kernel_fds[0], req, PERF_IOC_FLAG_GROUP);
+}
+
+static void
+kernel_perf_read(uint64_t *counters)
+{
+	unsigned n;
+
+	for (n = 0; n < KERNEL_EVENTS; n++) {
+		counters[n] = UINT64_MAX;
+		if (kernel_fds[n] >= 0 &&
+		    read(kernel_fds[n], &counters[n], sizeof *counters) !=
+		    sizeof *counters)
+			counters[n] = UINT64_MAX;
+	}
+}
+
+#  define KERNEL_PERF_START() \
+	do { \
+		kernel_perf_ioctl(PERF_EVENT_IOC_RESET); \
+		kernel_perf_ioctl(PERF_EVENT_IOC_ENABLE); \
+	} while (0)
+#  define KERNEL_PERF_STOP() kernel_perf_ioctl(PERF_EVENT_IOC_DISABLE)
+#else
+static void
+kernel_perf_open(void)
+{
+	unsigned n;
+
+	for (n = 0; n < KERNEL_EVENTS; n++)
+		kernel_fds[n] = -1;
+}
+
+static void
+kernel_perf_read(uint64_t *counters)
+{
+	unsigned n;
+
+	for (n = 0; n < KERNEL_EVENTS; n++)
+		counters[n] = UINT64_MAX;
+}
+
+#  define KERNEL_PERF_START() do { } while (0)
+#  define KERNEL_PERF_STOP() do { } while (0)
+#endif
+
+static uint64_t
+kernel_now(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
+		perror("clock_gettime");
+		exit(EXIT_FAILURE);
+	}
+	return ((uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec);
+}
+
+/* kernels */
+
+static void
+kernel_pass(const struct kernel_bench *kb, struct kernel_buffers *kbuf,
+    bjxa_decoder_t *dec)
+{
+	uint8_t *xa;
+	int16_t *pcm;
+	size_t n;
+	int ret;
+
+	xa = kbuf->xa;
+	pcm = kbuf->pcm;
+
+	for (n = 0; n < kbuf->blocks; n++) {
+		if (kb->inflate != NULL)
+			kbuf->profiles[n] = kb->inflate(pcm, xa, 1);
+		else if (kb->deflate != NULL)
+			kb->deflate(xa, pcm);
+		else {
+			ret = bjxa_decode_inflated(dec, pcm,
+			    kbuf->profiles[n], 0);
+			assert(ret == 0);
+			(void)ret;
+		}
+		xa += kbuf->block_size;
+		pcm += BJXA_BLOCK_SAMPLES;
+	}
+}
+
+static void
+kernel_run(const struct kernel_bench *kb, struct kernel_buffers *kbuf,
+    struct kernel_result *res)
+{
+	bjxa_decoder_t dec;
+	uint64_t t0, t1;
+	size_t done;
+
+	INIT_OBJ(&dec, BJXA_DECODER_MAGIC);
+	dec.channels = 1;
+
+	/* warm up the caches, and for the filter the samples run in place
+	 * so they decay after the first pass, only clamping depends on them.
+	 */
+	kernel_pass(kb, kbuf, &dec);
+
+	KERNEL_PERF_START();
+	t0 = kernel_now();
+	for (done = 0; done < KERNEL_BLOCKS; done += kbuf->blocks)
+		kernel_pass(kb, kbuf, &dec);
+	t1 = kernel_now();
+	KERNEL_PERF_STOP();
+
+	res->ns = t1 - t0;
+	kernel_perf_read(res->counters);
+}
+
+static void
+kernel_report(const struct kernel_bench *kb, const struct kernel_set *ks,
+    const struct kernel_buffers *kbuf, const struct kernel_result *res)
+{
+	uint64_t blocks;
+	unsigned n;
+
+	blocks = (KERNEL_BLOCKS + kbuf->blocks - 1) / kbuf->blocks *
+	    kbuf->blocks;
+
+	printf("%s\t%s\t%u\t%s\t%zu\t%ju\t%ju\t%.2f", kb->op, kb->variant,
+	    kb->bits, ks->name, ks->len, (uintmax_t)blocks,
+	    (uintmax_t)res->ns, (double)res->ns / (double)blocks);
+
+	for (n = 0; n < KERNEL_EVENTS; n++) {
+		if (res->counters[n] == UINT64_MAX)
+			printf("\t-");
+		else
+			printf("\t%ju", (uintmax_t)res->counters[n]);
+	}
+	printf("\n");
+}
+
+static int
+kernel_bench(const struct kernel_bench *kb, const struct kernel_set *ks,
+    unsigned rounds, uint32_t *rnd)
+{
+	struct kernel_buffers kbuf;
+	struct kernel_result res, best;
+	size_t n, xa_len;
+	unsigned r;
+
+	memset(&kbuf, 0, sizeof kbuf);
+	kbuf.block_size = kb->bits * 4 + 1;
+	kbuf.blocks = ks->len / (kbuf.block_size + BJXA_BLOCK_SAMPLES * 2);
+	xa_len = kbuf.blocks * kbuf.block_size;
+
+	kbuf.xa = malloc(xa_len);
+	kbuf.pcm = calloc(kbuf.blocks, BJXA_BLOCK_SAMPLES * 2);
+	kbuf.profiles = malloc(kbuf.blocks);
+
+	if (kbuf.xa == NULL || kbuf.pcm == NULL || kbuf.profiles == NULL) {
+		perror("malloc");
+		free(kbuf.xa);
+		free(kbuf.pcm);
+		free(kbuf.profiles);
+		return (-1);
+	}
+
+	for (n = 0; n < xa_len; n++) {
+		*rnd ^= *rnd << 13;
+		*rnd ^= *rnd >> 17;
+		*rnd ^= *rnd << 5;
+		kbuf.xa[n] = (uint8_t)*rnd;
+	}
+
+	/* valid profiles and samples for the filter */
+	for (n = 0; n < kbuf.blocks; n++) {
+		kbuf.xa[n * kbuf.block_size] %= 5 << 4;
+		kbuf.profiles[n] = bjxa_inflate_8bits(
+		    kbuf.pcm + n * BJXA_BLOCK_SAMPLES,
+		    kbuf.xa + n * kbuf.block_size, 1);
+	}
+
+	memset(&best, 0, sizeof best);
+	best.ns = UINT64_MAX;
+
+	for (r = 0; r < rounds; r++) {
+		kernel_run(kb, &kbuf, &res);
+		if (res.ns < best.ns)
+			best = res;
+	}
+
+	kernel_report(kb, ks, &kbuf, &best);
+
+	free(kbuf.xa);
+	free(kbuf.pcm);
+	free(kbuf.profiles);
+	return (0);
+}
+
+int
+main(int argc, char * const *argv)
+{
+	struct kernel_bench kb[16];
+	unsigned long rounds = KERNEL_ROUNDS;
+	unsigned k, n, s;
+	uint32_t rnd;
+	char *end;
+
+	argc--;
+	argv++;
+
+	if (argc == 2 && !strcmp("-n", *argv)) {
+		rounds = strtoul(argv[1], &end, 10);
+		if (*end != '\0' || rounds == 0 || rounds > UINT16_MAX) {
+			fprintf(stderr, "bjxa_kernels: invalid rounds\n");
+			return (EXIT_FAILURE);
+		}
+		argc -= 2;
+	}
+
+	if (argc != 0) {
+		fprintf(stderr, "Usage: bjxa_kernels [-n <rounds>]\n");
+		return (EXIT_FAILURE);
+	}
+
+	memset(kb, 0, sizeof kb);
+	k = 0;
+
+	kb[k++] = (struct kernel_bench){"inflate", "scalar", 4,
+	    bjxa_inflate_4bits, NULL};
+	kb[k++] = (struct kernel_bench){"inflate", "scalar", 6,
+	    bjxa_inflate_6bits, NULL};
+	kb[k++] = (struct kernel_bench){"inflate", "scalar", 8,
+	    bjxa_inflate_8bits, NULL};
+	kb[k++] = (struct kernel_bench){"filter", "scalar", 8, NULL, NULL};
+	kb[k++] = (struct kernel_bench){"deflate", "scalar", 4, NULL,
+	    bjxa_deflate_4bits};
+	kb[k++] = (struct kernel_bench){"deflate", "scalar", 6, NULL,
+	    bjxa_deflate_6bits};
+	kb[k++] = (struct kernel_bench){"deflate", "scalar", 8, NULL,
+	    bjxa_deflate_8bits};
+
+#ifdef HAVE_SSSE3
+	if (__builtin_cpu_supports("ssse3")) {
+		kb[k++] = (struct kernel_bench){"deflate", "ssse3", 4, NULL,
+		    bjxa_deflate_4bits_ssse3};
+		kb[k++] = (struct kernel_bench){"deflate", "ssse3", 6, NULL,
+		    bjxa_deflate_6bits_ssse3};
+		kb[k++] = (struct kernel_bench){"deflate", "ssse3", 8, NULL,
+		    bjxa_deflate_8bits_ssse3};
+	}
+#endif
+
+	assert(k <= COUNTOF(kb));
+
+	kernel_perf_open();
+	if (kernel_fds[0] < 0)
+		fprintf(stderr, "bjxa_kernels: hardware counters "
+		    "unavailable, only reporting time\n");
+
+	printf("# op\tvariant\tbits\tset\tbytes\tblocks\tns\tns/block"
+	    "\tcycles\tinstructions\tbranch-misses\tcache-misses\n");
+
+	rnd = 0x5eed1e55;
+	for (n = 0; n < k; n++)
+		for (s = 0; s < COUNTOF(kernel_sets); s++)
+			if (kernel_bench(&kb[n], &kernel_sets[s],
+			    (unsigned)rounds, &rnd) < 0)
+				return (EXIT_FAILURE);
+
+	return (EXIT_SUCCESS);
+}
@@ -18,6 +18,7 @@
 #include "config.h"
 
 #include <assert.h>
+#include <errno.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -41,13 +42,99 @@ usage(FILE* file)
 	    "  help\n"
 	    "    Show this message and exit.\n"
 	    "\n"
-	    "  decode [<xa file> [<wav file>]]\n"
+	    "  decode [--stats] [--mix <left|right|mono>]\n"
+	    "         [<xa file> [<wav file>]]\n"
 	    "    Read an XA file and convert it into a WAV file.\n"
+	    "    With --stats, decoding statistics are printed to\n"
+	    "    the standard error. With --mix, a stereo XA file\n"
+	    "    is decoded to a mono WAV file with either channel\n"
+	    "    or their average.\n"
 	    "\n"
-	    "  encode [--bits <4|6|8>] [wav file> [<xa file>]]\n"
+	    "  encode [--bits <4|6|8>] [--dither] [--trim-silence]\n"
+	    "         [--cache <dir>] [--cache-size <MiB>]\n"
+	    "         [<wav file> [<xa file>]]\n"
 	    "    Read a WAV file and convert it into an XA file.\n"
 	    "    The default number of bits per sample, when left\n"
-	    "    unspecified is 6.\n"
+	    "    unspecified is 6. With --dither, 24 bits and\n"
+	    "    floating point samples are dithered when they are\n"
+	    "    reduced to 16 bits. With --trim-silence, the\n"
+	    "    leading and trailing silence is dropped. With\n"
+	    "    --cache, XA files are looked up in a cache by their\n"
+	    "    samples and options first, the cache size defaults\n"
+	    "    to 1024MiB.\n"
+	    "\n"
+	    "  compare [--worst <blocks>] <xa file> <wav file>\n"
+	    "    Decode an XA file and compare it to a reference\n"
+	    "    WAV file with 16 bits samples. The SNR, PSNR and\n"
+	    "    peak error are printed, and with --worst, the\n"
+	    "    given number of blocks with the largest errors.\n"
+	    "\n"
+	    "  batch decode|encode [--jobs <n>] [--output <dir>]\n"
+	    "        [--io-uring] [encode options] <dir|list file>\n"
+	    "    Convert all the XA or WAV files found in a\n"
+	    "    directory, or listed one per line in a file, in\n"
+	    "    parallel. Outputs are written next to the inputs\n"
+	    "    or mirrored in the --output directory. The number\n"
+	    "    of jobs defaults to the number of CPUs. With\n"
+	    "    --io-uring, decoding uses asynchronous I/O when\n"
+	    "    it is available.\n"
+	    "\n"
+	    "  pack <bundle> <xa file>...\n"
+	    "    Concatenate XA files into a bundle indexed by\n"
+	    "    file name for random access.\n"
+	    "\n"
+	    "  unpack [--decode] <bundle> [<dir>]\n"
+	    "    Extract the XA files of a bundle in a directory,\n"
+	    "    the current one by default. With --decode, they\n"
+	    "    are decoded to WAV files instead.\n"
+	    "\n"
+	    "  info [--jobs <n>] [--profiles] [--json]\n"
+	    "        <xa file|dir|->...\n"
+	    "    Print a CSV or JSON index of XA headers, with\n"
+	    "    --profiles a histogram of the gain factors of\n"
+	    "    every block. Directories are searched for XA\n"
+	    "    files and - reads a list of files.\n"
+	    "\n"
+	    "  verify <xa file|->...\n"
+	    "    Check XA headers and block profiles without\n"
+	    "    decoding, and report the offset of the first\n"
+	    "    invalid block.\n"
+	    "\n"
+	    "  cut [--from <block>] [--to <block>]\n"
+	    "      [<xa file> [<xa file>]]\n"
+	    "    Copy a range of blocks of an XA file, from the\n"
+	    "    first block up to the last one excluded, into\n"
+	    "    another XA file without re-encoding.\n"
+	    "\n"
+	    "  concat <xa output> <xa file>...\n"
+	    "    Join XA files into a single XA file without\n"
+	    "    re-encoding.\n"
+	    "\n"
+	    "  transcode [--jobs <n>] [encode options]\n"
+	    "            [<xa file> [<xa file>]]\n"
+	    "    Decode an XA file and encode it again with a\n"
+	    "    different number of bits per sample, block by\n"
+	    "    block. With more than one job, segments of the\n"
+	    "    stream are transcoded in parallel.\n"
+	    "\n"
+	    "  update <wav file> <xa file>\n"
+	    "         [<wav file> [<xa file>]]\n"
+	    "    Encode a new version of a WAV file, copying the\n"
+	    "    blocks of the XA file previously encoded from the\n"
+	    "    first WAV file where the samples did not change.\n"
+	    "\n"
+	    "  peaks [--window <samples>]\n"
+	    "        [<xa file> [<peaks file>]]\n"
+	    "    Decode an XA file into a waveform overview with\n"
+	    "    the minimum, maximum and RMS of every window of\n"
+	    "    samples per channel, 256 by default.\n"
+	    "\n"
+	    "  fingerprint [--jobs <n>] [--distance <bits>]\n"
+	    "              <xa file|dir|->...\n"
+	    "    Decode XA files into a hash of their samples and\n"
+	    "    a perceptual fingerprint, and report duplicates\n"
+	    "    with the same hash or fingerprints differing by\n"
+	    "    up to 8 bits by default.\n"
 	    "\n",
 	    progname);
 }
@@ -87,59 +174,595 @@ open_files(int argc, char * const *argv)
 	return (0);
 }
 
-int
-main(int argc, char * const *argv)
+static int
+parse_number(const char *str, uint32_t *res)
 {
+	unsigned long val;
+	char *end;
+
+	if (*str < '0' || *str > '9')
+		return (-1);
 
-	int bits = -1;
+	errno = 0;
+	val = strtoul(str, &end, 10);
+	if (errno != 0 || *end != '\0' || val > UINT32_MAX)
+		return (-1);
 
-	progname = *argv;
+	*res = (uint32_t)val;
+	return (0);
+}
+
+static int
+cmd_decode(int argc, char * const *argv)
+{
+	struct decode_options opt;
+
+	memset(&opt, 0, sizeof opt);
+	while (argc > 0 && !strncmp("--", *argv, 2)) {
+		if (!strcmp("--stats", *argv))
+			opt.stats = 1;
+		else if (!strcmp("--mix", *argv)) {
+			argc--;
+			argv++;
+			if (argc == 0)
+				cmd_fail("Missing channel mix");
+			if (!strcmp("left", *argv))
+				opt.mix = BJXA_MIX_LEFT;
+			else if (!strcmp("right", *argv))
+				opt.mix = BJXA_MIX_RIGHT;
+			else if (!strcmp("mono", *argv))
+				opt.mix = BJXA_MIX_MONO;
+			else
+				cmd_fail("Invalid channel mix");
+		}
+		else
+			cmd_fail("Unknown option");
+		argc--;
+		argv++;
+	}
+	if (argc > 2)
+		cmd_fail("Too many arguments");
+	if (open_files(argc, argv) < 0 || decode(stdin, stdout, &opt) < 0)
+		return (EXIT_FAILURE);
+	return (EXIT_SUCCESS);
+}
+
+static int
+encode_option(int *argcp, char * const **argvp, struct encode_options *opt)
+{
+	char * const *argv;
+
+	argv = *argvp;
+	if (!strcmp("--bits", *argv)) {
+		if (*argcp == 1)
+			cmd_fail("Missing number of bits per sample");
+		argv++;
+		opt->bits = 0;
+		if (strlen(*argv) == 1)
+			opt->bits = (unsigned)(**argv - '0');
+		if (opt->bits != 4 && opt->bits != 6 && opt->bits != 8)
+			cmd_fail("Invalid number of bits per sample");
+	}
+	else if (!strcmp("--dither", *argv)) {
+		opt->dither = 1;
+	}
+	else {
+		return (0);
+	}
+
+	/* leave the last argument consumed to the caller */
+	*argcp -= (int)(argv - *argvp);
+	*argvp = argv;
+	return (1);
+}
+
+#define CACHE_SIZE	1024
+
+/* options reading the whole WAV file in memory */
+static int
+memory_option(int *argcp, char * const **argvp, struct encode_options *opt)
+{
+	char * const *argv;
+	uint32_t size;
+
+	argv = *argvp;
+	if (!strcmp("--trim-silence", *argv)) {
+		opt->trim = 1;
+	}
+	else if (!strcmp("--cache", *argv)) {
+		if (*argcp == 1)
+			cmd_fail("Missing cache directory");
+		argv++;
+		opt->cache = *argv;
+	}
+	else if (!strcmp("--cache-size", *argv)) {
+		if (*argcp == 1)
+			cmd_fail("Missing cache size");
+		argv++;
+		if (parse_number(*argv, &size) < 0 || size == 0)
+			cmd_fail("Invalid cache size");
+		opt->cache_size = (uint64_t)size << 20;
+	}
+	else {
+		return (0);
+	}
+
+	/* leave the last argument consumed to the caller */
+	*argcp -= (int)(argv - *argvp);
+	*argvp = argv;
+	return (1);
+}
+
+static int
+cmd_encode(int argc, char * const *argv)
+{
+	struct encode_options opt;
+
+	memset(&opt, 0, sizeof opt);
+	opt.bits = 6;
+	opt.cache_size = (uint64_t)CACHE_SIZE << 20;
+	while (argc > 0 && !strncmp("--", *argv, 2)) {
+		if (!encode_option(&argc, &argv, &opt) &&
+		    !memory_option(&argc, &argv, &opt))
+			cmd_fail("Unknown option");
+		argc--;
+		argv++;
+	}
+	assert(opt.bits == 4 || opt.bits == 6 || opt.bits == 8);
+	if (argc > 2)
+		cmd_fail("Too many arguments");
+	if (open_files(argc, argv) < 0 || encode(stdin, stdout, &opt) < 0)
+		return (EXIT_FAILURE);
+	return (EXIT_SUCCESS);
+}
+
+static int
+cmd_compare(int argc, char * const *argv)
+{
+	struct compare_options opt;
+	FILE *xa, *wav;
+	int status;
+
+	memset(&opt, 0, sizeof opt);
+	while (argc > 0 && !strncmp("--", *argv, 2)) {
+		if (!strcmp("--worst", *argv)) {
+			argc--;
+			argv++;
+			if (argc == 0)
+				cmd_fail("Missing number of worst blocks");
+			if (parse_number(*argv, &opt.worst) < 0 ||
+			    opt.worst == 0 || opt.worst > UINT16_MAX)
+				cmd_fail("Invalid number of worst blocks");
+		}
+		else {
+			cmd_fail("Unknown option");
+		}
+		argc--;
+		argv++;
+	}
+	if (argc < 2)
+		cmd_fail("Missing arguments");
+	if (argc > 2)
+		cmd_fail("Too many arguments");
+
+	xa = fopen(argv[0], "r");
+	if (xa == NULL) {
+		perror("Error");
+		return (EXIT_FAILURE);
+	}
+
+	wav = fopen(argv[1], "r");
+	if (wav == NULL) {
+		perror("Error");
+		(void)fclose(xa);
+		return (EXIT_FAILURE);
+	}
+
+	status = EXIT_SUCCESS;
+	if (compare(xa, wav, stdout, &opt) < 0)
+		status = EXIT_FAILURE;
+
+	(void)fclose(xa);
+	(void)fclose(wav);
+	return (status);
+}
+
+static unsigned
+default_jobs(void)
+{
+	long cpus;
+
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	return (cpus > 0 && cpus <= UINT16_MAX ? (unsigned)cpus : 1);
+}
+
+static int
+cmd_batch(int argc, char * const *argv)
+{
+	struct batch_options opt;
+	uint32_t jobs;
+
+	memset(&opt, 0, sizeof opt);
+	opt.enc.bits = 6;
+	opt.enc.cache_size = (uint64_t)CACHE_SIZE << 20;
+
+	if (argc == 0)
+		cmd_fail("Missing batch action");
+	if (!strcmp("encode", *argv))
+		opt.encode = 1;
+	else if (strcmp("decode", *argv))
+		cmd_fail("Unknown batch action");
 	argc--;
 	argv++;
 
-	if (argc == 0)
-		cmd_fail("Missing an action");
+	opt.jobs = default_jobs();
 
-	if (!strcmp("help", *argv)) {
-		usage(stdout);
-		return (EXIT_SUCCESS);
+	while (argc > 0 && !strncmp("--", *argv, 2)) {
+		if (!strcmp("--jobs", *argv)) {
+			argc--;
+			argv++;
+			if (argc == 0)
+				cmd_fail("Missing number of jobs");
+			if (parse_number(*argv, &jobs) < 0 || jobs == 0 ||
+			    jobs > UINT16_MAX)
+				cmd_fail("Invalid number of jobs");
+			opt.jobs = jobs;
+		}
+		else if (!strcmp("--output", *argv)) {
+			argc--;
+			argv++;
+			if (argc == 0)
+				cmd_fail("Missing output directory");
+			opt.output = *argv;
+		}
+		else if (!strcmp("--io-uring", *argv))
+			opt.uring = 1;
+		else if (!opt.encode ||
+		    (!encode_option(&argc, &argv, &opt.enc) &&
+		    !memory_option(&argc, &argv, &opt.enc))) {
+			cmd_fail("Unknown option");
+		}
+		argc--;
+		argv++;
 	}
-	else if (!strcmp("decode", *argv)) {
+	if (argc == 0)
+		cmd_fail("Missing arguments");
+	if (argc > 1)
+		cmd_fail("Too many arguments");
+	if (batch(*argv, stdout, &opt) < 0)
+		return (EXIT_FAILURE);
+	return (EXIT_SUCCESS);
+}
+
+static int
+cmd_pack(int argc, char * const *argv)
+{
+
+	if (argc > 0 && !strncmp("--", *argv, 2))
+		cmd_fail("Unknown option");
+	if (argc < 2)
+		cmd_fail("Missing arguments");
+	if (pack(argv[0], argc - 1, argv + 1) < 0)
+		return (EXIT_FAILURE);
+	return (EXIT_SUCCESS);
+}
+
+static int
+cmd_unpack(int argc, char * const *argv)
+{
+	unsigned decode = 0;
+
+	while (argc > 0 && !strncmp("--", *argv, 2)) {
+		if (!strcmp("--decode", *argv))
+			decode = 1;
+		else
+			cmd_fail("Unknown option");
 		argc--;
 		argv++;
-		if (argc > 2)
-			cmd_fail("Too many arguments");
-		if (open_files(argc, argv) < 0 || decode(stdin, stdout) < 0)
-			return (EXIT_FAILURE);
 	}
-	else if (!strcmp("encode", *argv)) {
+	if (argc == 0)
+		cmd_fail("Missing arguments");
+	if (argc > 2)
+		cmd_fail("Too many arguments");
+	if (unpack(argv[0], argc > 1 ? argv[1] : ".", decode) < 0)
+		return (EXIT_FAILURE);
+	return (EXIT_SUCCESS);
+}
+
+static int
+cmd_info(int argc, char * const *argv)
+{
+	struct info_options opt;
+	uint32_t jobs;
+
+	memset(&opt, 0, sizeof opt);
+	opt.jobs = default_jobs();
+
+	while (argc > 0 && !strncmp("--", *argv, 2)) {
+		if (!strcmp("--jobs", *argv)) {
+			argc--;
+			argv++;
+			if (argc == 0)
+				cmd_fail("Missing number of jobs");
+			if (parse_number(*argv, &jobs) < 0 || jobs == 0 ||
+			    jobs > UINT16_MAX)
+				cmd_fail("Invalid number of jobs");
+			opt.jobs = jobs;
+		}
+		else if (!strcmp("--profiles", *argv))
+			opt.profiles = 1;
+		else if (!strcmp("--json", *argv))
+			opt.json = 1;
+		else
+			cmd_fail("Unknown option");
 		argc--;
 		argv++;
-		if (argc > 0 && !strcmp("--bits", *argv)) {
+	}
+	if (argc == 0)
+		cmd_fail("Missing arguments");
+	if (info(argc, argv, stdout, &opt) < 0)
+		return (EXIT_FAILURE);
+	return (EXIT_SUCCESS);
+}
+
+static int
+cmd_verify(int argc, char * const *argv)
+{
+
+	if (argc > 0 && !strncmp("--", *argv, 2))
+		cmd_fail("Unknown option");
+	if (argc == 0)
+		cmd_fail("Missing arguments");
+	if (verify(argc, argv, stdout) < 0)
+		return (EXIT_FAILURE);
+	return (EXIT_SUCCESS);
+}
+
+static int
+cmd_cut(int argc, char * const *argv)
+{
+	struct cut_options opt;
+
+	memset(&opt, 0, sizeof opt);
+	opt.to = UINT32_MAX;
+
+	while (argc > 0 && !strncmp("--", *argv, 2)) {
+		if (!strcmp("--from", *argv)) {
 			argc--;
 			argv++;
 			if (argc == 0)
-				cmd_fail("Missing number of bits per sample");
-			if (strlen(*argv) == 1)
-				bits = **argv - '0';
-			if (bits != 4 && bits != 6 && bits != 8)
-				cmd_fail("Invalid number of bits per sample");
+				cmd_fail("Missing first block");
+			if (parse_number(*argv, &opt.from) < 0)
+				cmd_fail("Invalid first block");
+		}
+		else if (!strcmp("--to", *argv)) {
 			argc--;
 			argv++;
+			if (argc == 0)
+				cmd_fail("Missing last block");
+			if (parse_number(*argv, &opt.to) < 0)
+				cmd_fail("Invalid last block");
 		}
-		else {
-			bits = 6;
+		else
+			cmd_fail("Unknown option");
+		argc--;
+		argv++;
+	}
+	if (argc > 2)
+		cmd_fail("Too many arguments");
+	if (open_files(argc, argv) < 0 || cut(stdin, stdout, &opt) < 0)
+		return (EXIT_FAILURE);
+	return (EXIT_SUCCESS);
+}
+
+static int
+cmd_concat(int argc, char * const *argv)
+{
+
+	if (argc > 0 && !strncmp("--", *argv, 2))
+		cmd_fail("Unknown option");
+	if (argc < 2)
+		cmd_fail("Missing arguments");
+	if (concat(argv[0], argc - 1, argv + 1) < 0)
+		return (EXIT_FAILURE);
+	return (EXIT_SUCCESS);
+}
+
+static int
+cmd_transcode(int argc, char * const *argv)
+{
+	struct transcode_options opt;
+	uint32_t jobs;
+
+	memset(&opt, 0, sizeof opt);
+	opt.jobs = 1;
+	opt.enc.bits = 6;
+
+	while (argc > 0 && !strncmp("--", *argv, 2)) {
+		if (!strcmp("--jobs", *argv)) {
+			argc--;
+			argv++;
+			if (argc == 0)
+				cmd_fail("Missing number of jobs");
+			if (parse_number(*argv, &jobs) < 0 || jobs == 0 ||
+			    jobs > UINT16_MAX)
+				cmd_fail("Invalid number of jobs");
+			opt.jobs = jobs;
 		}
-		assert(bits == 4 || bits == 6 || bits == 8);
-		if (argc > 2)
-			cmd_fail("Too many arguments");
-		if (open_files(argc, argv) < 0 ||
-		    encode(stdin, stdout, bits) < 0)
-			return (EXIT_FAILURE);
+		else if (!encode_option(&argc, &argv, &opt.enc))
+			cmd_fail("Unknown option");
+		argc--;
+		argv++;
 	}
-	else {
-		cmd_fail("Unknown action");
+	if (argc > 2)
+		cmd_fail("Too many arguments");
+	if (open_files(argc, argv) < 0 ||
+	    transcode(stdin, stdout, &opt) < 0)
+		return (EXIT_FAILURE);
+	return (EXIT_SUCCESS);
+}
+
+static int
+cmd_update(int argc, char * const *argv)
+{
+	FILE *wav, *xa;
+	int status;
+
+	if (argc > 0 && !strncmp("--", *argv, 2))
+		cmd_fail("Unknown option");
+	if (argc < 2)
+		cmd_fail("Missing arguments");
+	if (argc > 4)
+		cmd_fail("Too many arguments");
+
+	wav = fopen(argv[0], "r");
+	if (wav == NULL) {
+		perror("Error");
+		return (EXIT_FAILURE);
 	}
 
+	xa = fopen(argv[1], "r");
+	if (xa == NULL) {
+		perror("Error");
+		(void)fclose(wav);
+		return (EXIT_FAILURE);
+	}
+
+	status = EXIT_SUCCESS;
+	if (open_files(argc - 2, argv + 2) < 0 ||
+	    update(wav, xa, stdin, stdout) < 0)
+		status = EXIT_FAILURE;
+
+	(void)fclose(wav);
+	(void)fclose(xa);
+	return (status);
+}
+
+#define PEAKS_WINDOW	256
+
+static int
+cmd_peaks(int argc, char * const *argv)
+{
+	struct peaks_options opt;
+
+	memset(&opt, 0, sizeof opt);
+	opt.window = PEAKS_WINDOW;
+
+	while (argc > 0 && !strncmp("--", *argv, 2)) {
+		if (!strcmp("--window", *argv)) {
+			argc--;
+			argv++;
+			if (argc == 0)
+				cmd_fail("Missing window size");
+			if (parse_number(*argv, &opt.window) < 0 ||
+			    opt.window == 0)
+				cmd_fail("Invalid window size");
+		}
+		else
+			cmd_fail("Unknown option");
+		argc--;
+		argv++;
+	}
+	if (argc > 2)
+		cmd_fail("Too many arguments");
+	if (open_files(argc, argv) < 0 || peaks(stdin, stdout, &opt) < 0)
+		return (EXIT_FAILURE);
+	return (EXIT_SUCCESS);
+}
+
+#define FINGERPRINT_DISTANCE	8
+
+static int
+cmd_fingerprint(int argc, char * const *argv)
+{
+	struct info_options opt;
+	uint32_t jobs;
+
+	memset(&opt, 0, sizeof opt);
+	opt.jobs = default_jobs();
+	opt.fingerprint = 1;
+	opt.distance = FINGERPRINT_DISTANCE;
+
+	while (argc > 0 && !strncmp("--", *argv, 2)) {
+		if (!strcmp("--jobs", *argv)) {
+			argc--;
+			argv++;
+			if (argc == 0)
+				cmd_fail("Missing number of jobs");
+			if (parse_number(*argv, &jobs) < 0 || jobs == 0 ||
+			    jobs > UINT16_MAX)
+				cmd_fail("Invalid number of jobs");
+			opt.jobs = jobs;
+		}
+		else if (!strcmp("--distance", *argv)) {
+			argc--;
+			argv++;
+			if (argc == 0)
+				cmd_fail("Missing distance");
+			if (parse_number(*argv, &opt.distance) < 0 ||
+			    opt.distance > 64)
+				cmd_fail("Invalid distance");
+		}
+		else
+			cmd_fail("Unknown option");
+		argc--;
+		argv++;
+	}
+	if (argc == 0)
+		cmd_fail("Missing arguments");
+	if (info(argc, argv, stdout, &opt) < 0)
+		return (EXIT_FAILURE);
 	return (EXIT_SUCCESS);
 }
+
+int
+main(int argc, char * const *argv)
+{
+	const char *action;
+
+	progname = *argv;
+	argc--;
+	argv++;
+
+	if (argc == 0)
+		cmd_fail("Missing an action");
+
+	action = *argv;
+	argc--;
+	argv++;
+
+	if (!strcmp("help", action)) {
+		usage(stdout);
+		return (EXIT_SUCCESS);
+	}
+	else if (!strcmp("decode", action))
+		return (cmd_decode(argc, argv));
+	else if (!strcmp("encode", action))
+		return (cmd_encode(argc, argv));
+	else if (!strcmp("compare", action))
+		return (cmd_compare(argc, argv));
+	else if (!strcmp("batch", action))
+		return (cmd_batch(argc, argv));
+	else if (!strcmp("pack", action))
+		return (cmd_pack(argc, argv));
+	else if (!strcmp("unpack", action))
+		return (cmd_unpack(argc, argv));
+	else if (!strcmp("info", action))
+		return (cmd_info(argc, argv));
+	else if (!strcmp("verify", action))
+		return (cmd_verify(argc, argv));
+	else if (!strcmp("cut", action))
+		return (cmd_cut(argc, argv));
+	else if (!strcmp("concat", action))
+		return (cmd_concat(argc, argv));
+	else if (!strcmp("transcode", action))
+		return (cmd_transcode(argc, argv));
+	else if (!strcmp("update", action))
+		return (cmd_update(argc, argv));
+	else if (!strcmp("peaks", action))
+		return (cmd_peaks(argc, argv));
+	else if (!strcmp("fingerprint", action))
+		return (cmd_fingerprint(argc, argv));
+
+	cmd_fail("Unknown action");
+}
@@ -20,6 +20,8 @@
 
 typedef struct bjxa_decoder bjxa_decoder_t;
 typedef struct bjxa_encoder bjxa_encoder_t;
+typedef struct bjxa_pool bjxa_pool_t;
+typedef struct bjxa_bundle bjxa_bundle_t;
 
 typedef struct {
 	uint32_t	data_len_pcm;
@@ -31,6 +33,59 @@ typedef struct {
 	uint8_t		channels;
 } bjxa_format_t;
 
+typedef struct {
+	uint64_t	blocks;
+	uint64_t	samples;
+	uint64_t	clamps;
+	uint64_t	silent;
+	uint64_t	factors[5];
+	uint64_t	ranges[16];
+	uint64_t	ns_convert;
+	uint64_t	ns_inflate;
+	uint64_t	ns_filter;
+	uint64_t	ns_deflate;
+} bjxa_stats_t;
+
+typedef struct {
+	int16_t		min;
+	int16_t		max;
+	uint16_t	rms;
+} bjxa_peak_t;
+
+typedef struct {
+	uint64_t	hash;
+	uint64_t	print;
+	uint64_t	samples;
+	uint32_t	windows;
+} bjxa_fingerprint_t;
+
+typedef struct {
+	const void	*src;
+	size_t		src_len;
+	void		*dst;
+	size_t		dst_len;
+	void		*priv;
+	bjxa_format_t	fmt;
+	int		status;
+	int		error;
+} bjxa_job_t;
+
+typedef void bjxa_job_f(bjxa_job_t *);
+
+typedef struct {
+	const char	*name;
+	const void	*xa;
+	size_t		xa_len;
+	bjxa_format_t	fmt;
+} bjxa_entry_t;
+
+#define BJXA_POOL_MAX	256
+
+#define BJXA_MIX_NONE	0
+#define BJXA_MIX_LEFT	1
+#define BJXA_MIX_RIGHT	2
+#define BJXA_MIX_MONO	3
+
 /* decoder */
 
 bjxa_decoder_t * bjxa_decoder(void);
@@ -42,6 +97,26 @@ ssize_t bjxa_fread_header(bjxa_decoder_t *, FILE *);
 int bjxa_decode_format(bjxa_decoder_t *, bjxa_format_t *);
 int bjxa_decode(bjxa_decoder_t *, void *, size_t, const void *, size_t);
 
+int bjxa_decode_sync(bjxa_decoder_t *, const void *, size_t);
+int bjxa_decode_seek(bjxa_decoder_t *, uint32_t);
+
+int bjxa_decode_mix(bjxa_decoder_t *, unsigned);
+int bjxa_decode_window(bjxa_decoder_t *, uint32_t);
+ssize_t bjxa_decode_peaks(bjxa_decoder_t *, bjxa_peak_t *, size_t,
+    const void *, size_t);
+
+int bjxa_decode_fingerprint(bjxa_decoder_t *, const void *, size_t);
+int bjxa_decoder_fingerprint(bjxa_decoder_t *, bjxa_fingerprint_t *);
+
+int bjxa_validate(bjxa_decoder_t *, const void *, size_t, size_t *);
+
+ssize_t bjxa_cut(bjxa_decoder_t *, void *, size_t, const void *, size_t,
+    uint32_t, uint32_t);
+ssize_t bjxa_concat(bjxa_decoder_t *, void *, size_t, const void * const *,
+    const size_t *, unsigned);
+
+int bjxa_decoder_stats(bjxa_decoder_t *, bjxa_stats_t *);
+
 ssize_t bjxa_dump_riff_header(bjxa_decoder_t *, void *, size_t);
 ssize_t bjxa_fwrite_riff_header(bjxa_decoder_t *, FILE *);
 
@@ -61,5 +136,31 @@ ssize_t bjxa_fread_riff_header(bjxa_format_t *, FILE *);
 int bjxa_encode_format(bjxa_encoder_t *, bjxa_format_t *);
 int bjxa_encode(bjxa_encoder_t *, void *, size_t, const void *, size_t);
 
+int bjxa_encode_seek(bjxa_encoder_t *, uint32_t);
+int bjxa_encode_dither(bjxa_encoder_t *, unsigned);
+
+int bjxa_encoder_stats(bjxa_encoder_t *, bjxa_stats_t *);
+
 ssize_t bjxa_dump_header(bjxa_encoder_t *, void *, size_t);
 ssize_t bjxa_fwrite_header(bjxa_encoder_t *, FILE *);
+
+/* transcoder */
+
+int bjxa_transcode(bjxa_decoder_t *, bjxa_encoder_t *, void *, size_t,
+    const void *, size_t);
+
+/* job pool */
+
+bjxa_pool_t * bjxa_pool(unsigned, bjxa_job_f *);
+int bjxa_free_pool(bjxa_pool_t **);
+
+int bjxa_pool_submit(bjxa_pool_t *, bjxa_job_t *);
+bjxa_job_t * bjxa_pool_poll(bjxa_pool_t *, unsigned);
+
+/* bundle */
+
+bjxa_bundle_t * bjxa_bundle(const char *);
+int bjxa_free_bundle(bjxa_bundle_t **);
+
+int bjxa_bundle_find(bjxa_bundle_t *, const char *, bjxa_entry_t *);
+int bjxa_bundle_entry(bjxa_bundle_t *, uint32_t, bjxa_entry_t *);
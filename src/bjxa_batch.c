@@ -0,0 +1,1008 @@
+/*-
+ * Copyright (C) 2020  Dridi Boukelmoune
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Batch conversion.
+ *
+ * Files are distributed evenly between workers, each owning a deque of
+ * jobs. A worker takes jobs from the back of its own deque, and once it
+ * runs dry steals from the front of the other deques. Every worker owns a
+ * codec and stdio buffers, reused from one file to the next.
+ *
+ * With io_uring, a decoding worker keeps several files in flight: whole
+ * files are read asynchronously, decoded in memory on completion and the
+ * WAV files written asynchronously. When io_uring is missing or denied,
+ * the worker falls back to stdio, and so do its remaining jobs when the
+ * ring breaks down after the files in flight completed.
+ */
+
+/* for syscall(2) */
+#define _DEFAULT_SOURCE
+
+#include "config.h"
+
+#include <assert.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef HAVE_LINUX_IO_URING_H
+#  include <linux/io_uring.h>
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#  include <sys/uio.h>
+#  ifdef __NR_io_uring_enter
+#    define BATCH_URING
+#  endif
+#endif
+
+#include "bjxa.h"
+#include "bjxa_priv.h"
+
+#define BATCH_BUFFER	(64 * 1024)
+#define BATCH_DEPTH	16
+
+struct batch_job {
+	char		*src;
+	char		*dst;
+};
+
+struct batch_worker {
+	pthread_t		thread;
+	pthread_mutex_t		mtx;
+	struct batch		*batch;
+	unsigned		id;
+	size_t			head;
+	size_t			tail;
+	bjxa_decoder_t		*dec;
+	bjxa_encoder_t		*enc;
+	char			*buf_in;
+	char			*buf_out;
+	uint64_t		files;
+	uint64_t		failed;
+	uint64_t		bytes_in;
+	uint64_t		bytes_out;
+	unsigned		uring;
+};
+
+struct batch {
+	const struct batch_options	*opt;
+	const char			*src_ext;
+	const char			*dst_ext;
+	struct batch_job		*jobs;
+	size_t				jobs_len;
+	size_t				jobs_size;
+	struct batch_worker		*workers;
+	unsigned			workers_len;
+};
+
+/* job collection */
+
+static char *
+batch_path(const char *dir, const char *name, size_t name_len,
+    const char *ext)
+{
+	size_t dir_len, ext_len;
+	char *path;
+
+	dir_len = dir != NULL ? strlen(dir) : 0;
+	ext_len = ext != NULL ? strlen(ext) : 0;
+
+	path = malloc(dir_len + name_len + ext_len + 2);
+	if (path == NULL)
+		return (NULL);
+
+	if (dir_len > 0) {
+		memcpy(path, dir, dir_len);
+		path[dir_len++] = '/';
+	}
+	memcpy(path + dir_len, name, name_len);
+	memcpy(path + dir_len + name_len, ext, ext_len);
+	path[dir_len + name_len + ext_len] = '\0';
+	return (path);
+}
+
+static int
+batch_match(const struct batch *b, const char *path)
+{
+	size_t len, ext_len;
+
+	len = strlen(path);
+	ext_len = strlen(b->src_ext);
+	return (len > ext_len &&
+	    !strcasecmp(path + len - ext_len, b->src_ext));
+}
+
+static int
+batch_add(struct batch *b, const char *src, const char *rel)
+{
+	struct batch_job *job;
+	const char *dir;
+	size_t len;
+	void *ptr;
+	int unsafe;
+
+	if (b->jobs_len == b->jobs_size) {
+		b->jobs_size = b->jobs_size > 0 ? b->jobs_size * 2 : 64;
+		ptr = realloc(b->jobs, b->jobs_size * sizeof *b->jobs);
+		if (ptr == NULL) {
+			perror("realloc");
+			return (-1);
+		}
+		b->jobs = ptr;
+	}
+
+	/* the relative path is mirrored in the output directory */
+	dir = b->opt->output;
+	if (dir == NULL)
+		rel = src;
+	while (dir != NULL && *rel == '/')
+		rel++;
+
+	len = strlen(rel);
+	if (batch_match(b, rel))
+		len -= strlen(b->src_ext);
+
+	/* an unsafe path fails its job without aborting the batch */
+	job = &b->jobs[b->jobs_len];
+	job->src = strdup(src);
+	job->dst = NULL;
+	unsafe = dir != NULL && safe_path(rel) < 0;
+	if (unsafe)
+		fprintf(stderr, "batch: %s: unsafe path\n", src);
+	else
+		job->dst = batch_path(dir, rel, len, b->dst_ext);
+	if (job->src == NULL || (!unsafe && job->dst == NULL)) {
+		perror("malloc");
+		free(job->src);
+		free(job->dst);
+		return (-1);
+	}
+
+	b->jobs_len++;
+	return (0);
+}
+
+static int
+batch_walk(struct batch *b, const char *dir, size_t root_len)
+{
+	struct dirent *ent;
+	struct stat st;
+	char *path;
+	DIR *d;
+	int ret = 0;
+
+	d = opendir(dir);
+	if (d == NULL) {
+		perror(dir);
+		return (-1);
+	}
+
+	while (ret == 0 && (errno = 0, ent = readdir(d)) != NULL) {
+		if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, ".."))
+			continue;
+
+		path = batch_path(dir, ent->d_name, strlen(ent->d_name),
+		    NULL);
+		if (path == NULL) {
+			perror("malloc");
+			ret = -1;
+			break;
+		}
+
+		/* symbolic links to directories are not followed */
+		if (lstat(path, &st) < 0) {
+			perror(path);
+			ret = -1;
+		}
+		else if (S_ISDIR(st.st_mode))
+			ret = batch_walk(b, path, root_len);
+		else if (batch_match(b, path) && stat(path, &st) == 0 &&
+		    S_ISREG(st.st_mode))
+			ret = batch_add(b, path, path + root_len);
+
+		free(path);
+	}
+
+	if (ret == 0 && errno != 0) {
+		perror(dir);
+		ret = -1;
+	}
+
+	(void)closedir(d);
+	return (ret);
+}
+
+static int
+batch_list(struct batch *b, FILE *list)
+{
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+	int ret = 0;
+
+	while (ret == 0 && (len = getline(&line, &size, list)) >= 0) {
+		if (len > 0 && line[len - 1] == '\n')
+			line[--len] = '\0';
+		if (len > 0)
+			ret = batch_add(b, line, line);
+	}
+
+	if (ret == 0 && ferror(list)) {
+		perror("getline");
+		ret = -1;
+	}
+
+	free(line);
+	return (ret);
+}
+
+static int
+batch_cmp(const void *a, const void *b)
+{
+	const struct batch_job *ja = a, *jb = b;
+
+	return (strcmp(ja->src, jb->src));
+}
+
+/* conversion */
+
+static int
+batch_file(struct batch_worker *w, const struct batch_job *job)
+{
+	const struct batch_options *opt;
+	struct stat st;
+	FILE *in, *out;
+	int ret = 0;
+
+	opt = w->batch->opt;
+
+	if (job->dst == NULL) {
+		errno = EINVAL;
+		perror(job->src);
+		return (-1);
+	}
+
+	if (opt->output != NULL && mkdirs(job->dst) < 0) {
+		perror(job->dst);
+		return (-1);
+	}
+
+	in = fopen(job->src, "r");
+	if (in == NULL) {
+		perror(job->src);
+		return (-1);
+	}
+
+	out = fopen(job->dst, "w");
+	if (out == NULL) {
+		perror(job->dst);
+		(void)fclose(in);
+		return (-1);
+	}
+
+	if (setvbuf(in, w->buf_in, _IOFBF, BATCH_BUFFER) != 0 ||
+	    setvbuf(out, w->buf_out, _IOFBF, BATCH_BUFFER) != 0) {
+		perror("setvbuf");
+		ret = -1;
+	}
+
+	if (ret == 0 && opt->encode)
+		ret = encode_batch(w->enc, in, out, &opt->enc);
+	else if (ret == 0)
+		ret = decode_batch(w->dec, in, out);
+
+	if (ret == 0 && fflush(out) != 0) {
+		perror(job->dst);
+		ret = -1;
+	}
+
+	if (ret == 0 && fstat(fileno(in), &st) == 0)
+		w->bytes_in += (uint64_t)st.st_size;
+	if (ret == 0 && fstat(fileno(out), &st) == 0)
+		w->bytes_out += (uint64_t)st.st_size;
+
+	(void)fclose(in);
+	if (fclose(out) != 0 && ret == 0) {
+		perror(job->dst);
+		ret = -1;
+	}
+
+	/* do not leave truncated files behind */
+	if (ret < 0)
+		(void)unlink(job->dst);
+
+	return (ret);
+}
+
+/* work stealing */
+
+static int
+batch_pop(struct batch_worker *w, size_t *job)
+{
+	int ret = 0;
+
+	(void)pthread_mutex_lock(&w->mtx);
+	if (w->head < w->tail) {
+		w->tail--;
+		*job = w->tail;
+		ret = 1;
+	}
+	(void)pthread_mutex_unlock(&w->mtx);
+	return (ret);
+}
+
+static int
+batch_steal(struct batch_worker *w, size_t *job)
+{
+	struct batch_worker *victim;
+	unsigned n;
+	int ret = 0;
+
+	for (n = 1; ret == 0 && n < w->batch->workers_len; n++) {
+		victim = &w->batch->workers[(w->id + n) %
+		    w->batch->workers_len];
+		(void)pthread_mutex_lock(&victim->mtx);
+		if (victim->head < victim->tail) {
+			*job = victim->head;
+			victim->head++;
+			ret = 1;
+		}
+		(void)pthread_mutex_unlock(&victim->mtx);
+	}
+
+	return (ret);
+}
+
+/* io_uring backend */
+
+#ifdef BATCH_URING
+
+struct batch_ring {
+	int			fd;
+	unsigned		sq_tail;
+	unsigned		to_submit;
+	unsigned		inflight;
+	void			*sq_ptr;
+	size_t			sq_len;
+	void			*cq_ptr;
+	size_t			cq_len;
+	struct io_uring_sqe	*sqes;
+	size_t			sqes_len;
+	unsigned		*sq_array;
+	unsigned		*sq_mask;
+	unsigned		*sq_ktail;
+	unsigned		*cq_khead;
+	unsigned		*cq_ktail;
+	unsigned		*cq_mask;
+	struct io_uring_cqe	*cqes;
+};
+
+struct batch_slot {
+	size_t			job;
+	unsigned		busy;
+	unsigned		writing;
+	int			fd;
+	uint8_t			*buf;
+	size_t			len;
+	size_t			off;
+	size_t			src_len;
+	struct iovec		iov;
+};
+
+static void
+batch_ring_fini(struct batch_ring *r)
+{
+
+	if (r->sqes != NULL && r->sqes != MAP_FAILED)
+		(void)munmap(r->sqes, r->sqes_len);
+	if (r->cq_ptr != NULL && r->cq_ptr != MAP_FAILED)
+		(void)munmap(r->cq_ptr, r->cq_len);
+	if (r->sq_ptr != NULL && r->sq_ptr != MAP_FAILED)
+		(void)munmap(r->sq_ptr, r->sq_len);
+	if (r->fd >= 0)
+		(void)close(r->fd);
+}
+
+static int
+batch_ring_init(struct batch_ring *r)
+{
+	struct io_uring_params p;
+	uint8_t *sq, *cq;
+
+	memset(r, 0, sizeof *r);
+	memset(&p, 0, sizeof p);
+
+	/* one operation in flight per slot at most */
+	r->fd = (int)syscall(__NR_io_uring_setup, BATCH_DEPTH, &p);
+	if (r->fd < 0)
+		return (-1);
+
+	r->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	r->cq_len = p.cq_off.cqes + p.cq_entries * sizeof *r->cqes;
+	r->sqes_len = p.sq_entries * sizeof *r->sqes;
+
+	r->sq_ptr = mmap(NULL, r->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+	    r->fd, IORING_OFF_SQ_RING);
+	r->cq_ptr = mmap(NULL, r->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+	    r->fd, IORING_OFF_CQ_RING);
+	r->sqes = mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+	    r->fd, IORING_OFF_SQES);
+
+	if (r->sq_ptr == MAP_FAILED || r->cq_ptr == MAP_FAILED ||
+	    r->sqes == MAP_FAILED) {
+		batch_ring_fini(r);
+		return (-1);
+	}
+
+	sq = r->sq_ptr;
+	cq = r->cq_ptr;
+	r->sq_array = (void *)(sq + p.sq_off.array);
+	r->sq_mask = (void *)(sq + p.sq_off.ring_mask);
+	r->sq_ktail = (void *)(sq + p.sq_off.tail);
+	r->cq_khead = (void *)(cq + p.cq_off.head);
+	r->cq_ktail = (void *)(cq + p.cq_off.tail);
+	r->cq_mask = (void *)(cq + p.cq_off.ring_mask);
+	r->cqes = (void *)(cq + p.cq_off.cqes);
+	r->sq_tail = *r->sq_ktail;
+	return (0);
+}
+
+static void
+batch_ring_queue(struct batch_ring *r, struct batch_slot *slot)
+{
+	struct io_uring_sqe *sqe;
+	unsigned idx;
+
+	slot->iov.iov_base = slot->buf + slot->off;
+	slot->iov.iov_len = slot->len - slot->off;
+
+	idx = r->sq_tail & *r->sq_mask;
+	sqe = &r->sqes[idx];
+	memset(sqe, 0, sizeof *sqe);
+	sqe->opcode = slot->writing ? IORING_OP_WRITEV : IORING_OP_READV;
+	sqe->fd = slot->fd;
+	sqe->off = slot->off;
+	sqe->addr = (uintptr_t)&slot->iov;
+	sqe->len = 1;
+	sqe->user_data = (uintptr_t)slot;
+
+	r->sq_array[idx] = idx;
+	r->sq_tail++;
+	__atomic_store_n(r->sq_ktail, r->sq_tail, __ATOMIC_RELEASE);
+	r->to_submit++;
+}
+
+static int
+batch_ring_enter(struct batch_ring *r, unsigned to_submit)
+{
+	long res;
+
+	do
+		res = syscall(__NR_io_uring_enter, r->fd, to_submit, 1,
+		    IORING_ENTER_GETEVENTS, NULL, 0);
+	while (res < 0 && errno == EINTR);
+
+	if (res < 0)
+		return (-1);
+	r->to_submit -= (unsigned)res;
+	r->inflight += (unsigned)res;
+	return (0);
+}
+
+static struct io_uring_cqe *
+batch_ring_reap(struct batch_ring *r, unsigned *head)
+{
+	struct io_uring_cqe *cqe;
+
+	if (*head == __atomic_load_n(r->cq_ktail, __ATOMIC_ACQUIRE))
+		return (NULL);
+	cqe = &r->cqes[*head & *r->cq_mask];
+	r->inflight--;
+	return (cqe);
+}
+
+static void
+batch_ring_seen(struct batch_ring *r, unsigned *head)
+{
+
+	(*head)++;
+	__atomic_store_n(r->cq_khead, *head, __ATOMIC_RELEASE);
+}
+
+static int
+batch_ring_drain(struct batch_ring *r)
+{
+	unsigned head;
+
+	/* queued operations that were never submitted are dropped, the
+	 * submitted ones still own their buffers until they complete.
+	 */
+	while (r->inflight > 0) {
+		if (batch_ring_enter(r, 0) < 0)
+			return (-1);
+		head = *r->cq_khead;
+		while (batch_ring_reap(r, &head) != NULL)
+			batch_ring_seen(r, &head);
+	}
+	return (0);
+}
+
+static int
+batch_decode_mem(bjxa_decoder_t *dec, struct batch_slot *slot)
+{
+	bjxa_format_t fmt;
+	uint8_t *wav;
+	size_t xa_len, wav_len;
+	void *pcm;
+
+	if (bjxa_parse_header(dec, slot->buf, slot->len) < 0 ||
+	    bjxa_decode_format(dec, &fmt) < 0)
+		return (-1);
+
+	xa_len = (size_t)fmt.blocks * fmt.block_size_xa;
+	if (slot->len - BJXA_HEADER_SIZE_XA < xa_len) {
+		errno = EPROTO;
+		return (-1);
+	}
+
+	wav_len = BJXA_HEADER_SIZE_RIFF + fmt.data_len_pcm;
+	wav = malloc(wav_len);
+	if (wav == NULL)
+		return (-1);
+
+	/* samples are converted to little endian in place */
+	pcm = wav + BJXA_HEADER_SIZE_RIFF;
+	if (bjxa_dump_riff_header(dec, wav, wav_len) < 0 ||
+	    bjxa_decode(dec, pcm, fmt.data_len_pcm,
+	    slot->buf + BJXA_HEADER_SIZE_XA, xa_len) != (int)fmt.blocks ||
+	    bjxa_dump_pcm(pcm, pcm, fmt.data_len_pcm) < 0) {
+		free(wav);
+		return (-1);
+	}
+
+	free(slot->buf);
+	slot->buf = wav;
+	slot->len = wav_len;
+	slot->off = 0;
+	return (0);
+}
+
+static void
+batch_slot_fail(struct batch_worker *w, struct batch_slot *slot,
+    const char *path)
+{
+	const struct batch_job *job;
+
+	job = &w->batch->jobs[slot->job];
+	fprintf(stderr, "%s: %s\n", path, strerror(errno));
+	fprintf(stderr, "batch: %s: failed\n", job->src);
+	w->failed++;
+
+	if (slot->fd >= 0)
+		(void)close(slot->fd);
+	if (slot->writing)
+		(void)unlink(job->dst);
+	free(slot->buf);
+	memset(slot, 0, sizeof *slot);
+	slot->fd = -1;
+}
+
+static int
+batch_slot_start(struct batch_worker *w, struct batch_ring *r,
+    struct batch_slot *slot, size_t job)
+{
+	const struct batch_job *bj;
+	struct stat st;
+
+	bj = &w->batch->jobs[job];
+	slot->job = job;
+	slot->busy = 1;
+	w->files++;
+
+	if (bj->dst == NULL) {
+		errno = EINVAL;
+		batch_slot_fail(w, slot, bj->src);
+		return (-1);
+	}
+
+	if (w->batch->opt->output != NULL && mkdirs(bj->dst) < 0) {
+		batch_slot_fail(w, slot, bj->dst);
+		return (-1);
+	}
+
+	slot->fd = open(bj->src, O_RDONLY | O_CLOEXEC);
+	if (slot->fd < 0 || fstat(slot->fd, &st) < 0) {
+		batch_slot_fail(w, slot, bj->src);
+		return (-1);
+	}
+
+	slot->len = (size_t)st.st_size;
+	if (slot->len < BJXA_HEADER_SIZE_XA) {
+		errno = EPROTO;
+		batch_slot_fail(w, slot, bj->src);
+		return (-1);
+	}
+
+	slot->buf = malloc(slot->len);
+	if (slot->buf == NULL) {
+		batch_slot_fail(w, slot, bj->src);
+		return (-1);
+	}
+
+	batch_ring_queue(r, slot);
+	return (0);
+}
+
+static void
+batch_slot_done(struct batch_worker *w, struct batch_ring *r,
+    struct batch_slot *slot, int res)
+{
+	const struct batch_job *job;
+
+	job = &w->batch->jobs[slot->job];
+
+	if (res < 0) {
+		errno = -res;
+		batch_slot_fail(w, slot, slot->writing ? job->dst : job->src);
+		return;
+	}
+	if (res == 0) {
+		errno = EIO;
+		batch_slot_fail(w, slot, slot->writing ? job->dst : job->src);
+		return;
+	}
+
+	/* short reads and writes are resumed */
+	slot->off += (size_t)res;
+	if (slot->off < slot->len) {
+		batch_ring_queue(r, slot);
+		return;
+	}
+
+	if (!slot->writing) {
+		slot->src_len = slot->len;
+		(void)close(slot->fd);
+		slot->fd = -1;
+		if (batch_decode_mem(w->dec, slot) < 0) {
+			batch_slot_fail(w, slot, job->src);
+			return;
+		}
+		slot->writing = 1;
+		slot->fd = open(job->dst, O_WRONLY | O_CREAT | O_TRUNC |
+		    O_CLOEXEC, 0666);
+		if (slot->fd < 0) {
+			batch_slot_fail(w, slot, job->dst);
+			return;
+		}
+		batch_ring_queue(r, slot);
+		return;
+	}
+
+	if (close(slot->fd) < 0) {
+		slot->fd = -1;
+		batch_slot_fail(w, slot, job->dst);
+		return;
+	}
+
+	w->bytes_in += slot->src_len;
+	w->bytes_out += slot->len;
+	free(slot->buf);
+	memset(slot, 0, sizeof *slot);
+	slot->fd = -1;
+}
+
+static int
+batch_work_uring(struct batch_worker *w)
+{
+	struct batch_slot slots[BATCH_DEPTH], *slot;
+	struct io_uring_cqe *cqe;
+	struct batch_ring r;
+	unsigned head, n, busy, more;
+	size_t job;
+	int ret = 0;
+
+	if (w->batch->opt->encode || batch_ring_init(&r) < 0)
+		return (-1);
+
+	w->uring = 1;
+	memset(slots, 0, sizeof slots);
+	for (n = 0; n < BATCH_DEPTH; n++)
+		slots[n].fd = -1;
+
+	more = 1;
+	while (1) {
+		busy = 0;
+		for (n = 0; n < BATCH_DEPTH; n++) {
+			slot = &slots[n];
+			while (more && !slot->busy) {
+				more = batch_pop(w, &job) ||
+				    batch_steal(w, &job);
+				if (more)
+					(void)batch_slot_start(w, &r, slot,
+					    job);
+			}
+			busy += slot->busy;
+		}
+
+		if (busy == 0)
+			break;
+
+		if (batch_ring_enter(&r, r.to_submit) < 0) {
+			perror("io_uring_enter");
+			ret = -1;
+			break;
+		}
+
+		head = *r.cq_khead;
+		while ((cqe = batch_ring_reap(&r, &head)) != NULL) {
+			slot = (void *)(uintptr_t)cqe->user_data;
+			batch_slot_done(w, &r, slot, cqe->res);
+			batch_ring_seen(&r, &head);
+		}
+	}
+
+	if (ret == 0) {
+		batch_ring_fini(&r);
+		return (0);
+	}
+
+	/* a broken ring fails the files in flight, and the remaining jobs
+	 * fall back to stdio. Buffers that the kernel may still use after
+	 * a failed drain are leaked rather than freed.
+	 */
+	if (batch_ring_drain(&r) < 0) {
+		perror("io_uring_enter");
+		for (n = 0; n < BATCH_DEPTH; n++)
+			slots[n].buf = NULL;
+	}
+	batch_ring_fini(&r);
+	for (n = 0; n < BATCH_DEPTH; n++)
+		if (slots[n].busy) {
+			errno = EIO;
+			batch_slot_fail(w, &slots[n],
+			    w->batch->jobs[slots[n].job].src);
+		}
+
+	w->uring = 0;
+	return (-1);
+}
+
+#endif /* BATCH_URING */
+
+static void *
+batch_work(void *priv)
+{
+	struct batch_worker *w;
+	size_t job;
+
+	w = priv;
+
+#ifdef BATCH_URING
+	if (w->batch->opt->uring && batch_work_uring(w) == 0)
+		return (NULL);
+#endif
+
+	while (batch_pop(w, &job) || batch_steal(w, &job)) {
+		w->files++;
+		if (batch_file(w, &w->batch->jobs[job]) < 0) {
+			fprintf(stderr, "batch: %s: failed\n",
+			    w->batch->jobs[job].src);
+			w->failed++;
+		}
+	}
+
+	return (NULL);
+}
+
+static int
+batch_worker_init(struct batch *b, struct batch_worker *w, unsigned id)
+{
+	size_t share, extra;
+
+	w->id = id;
+
+	/* the first workers get one more job when it does not divide */
+	share = b->jobs_len / b->workers_len;
+	extra = b->jobs_len % b->workers_len;
+	w->head = id * share + (id < extra ? id : extra);
+	w->tail = w->head + share + (id < extra);
+
+	if (pthread_mutex_init(&w->mtx, NULL) != 0)
+		return (-1);
+	w->batch = b;
+
+	w->buf_in = malloc(BATCH_BUFFER);
+	w->buf_out = malloc(BATCH_BUFFER);
+	if (b->opt->encode)
+		w->enc = bjxa_encoder();
+	else
+		w->dec = bjxa_decoder();
+
+	if (w->buf_in == NULL || w->buf_out == NULL ||
+	    (w->enc == NULL && w->dec == NULL))
+		return (-1);
+
+	return (0);
+}
+
+static void
+batch_worker_fini(struct batch_worker *w)
+{
+
+	if (w->batch == NULL)
+		return;
+	if (w->dec != NULL)
+		(void)bjxa_free_decoder(&w->dec);
+	if (w->enc != NULL)
+		(void)bjxa_free_encoder(&w->enc);
+	free(w->buf_in);
+	free(w->buf_out);
+	(void)pthread_mutex_destroy(&w->mtx);
+}
+
+static double
+batch_now(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+		return (0.0);
+	return ((double)ts.tv_sec + (double)ts.tv_nsec * 1e-9);
+}
+
+static int
+batch_run(struct batch *b, FILE *out)
+{
+	struct batch_worker *w;
+	uint64_t files, failed, bytes_in, bytes_out;
+	double t0, secs;
+	unsigned n, started, uring;
+	int ret = 0;
+
+	b->workers_len = b->opt->jobs;
+	if (b->workers_len > b->jobs_len)
+		b->workers_len = (unsigned)b->jobs_len;
+	if (b->workers_len == 0)
+		b->workers_len = 1;
+
+	b->workers = calloc(b->workers_len, sizeof *b->workers);
+	if (b->workers == NULL) {
+		perror("calloc");
+		return (-1);
+	}
+
+	for (n = 0; ret == 0 && n < b->workers_len; n++)
+		if (batch_worker_init(b, &b->workers[n], n) < 0) {
+			perror("batch");
+			ret = -1;
+		}
+
+	t0 = batch_now();
+	started = 0;
+	for (n = 0; ret == 0 && n < b->workers_len; n++) {
+		errno = pthread_create(&b->workers[n].thread, NULL,
+		    batch_work, &b->workers[n]);
+		if (errno != 0) {
+			perror("pthread_create");
+			ret = -1;
+		}
+		else
+			started++;
+	}
+
+	/* the jobs of a thread that failed to start are stolen */
+	for (n = 0; n < started; n++)
+		(void)pthread_join(b->workers[n].thread, NULL);
+	if (started > 0 && started < b->workers_len)
+		(void)batch_work(&b->workers[0]);
+	secs = batch_now() - t0;
+
+	files = failed = bytes_in = bytes_out = 0;
+	uring = started > 0;
+	for (n = 0; n < b->workers_len; n++) {
+		w = &b->workers[n];
+		if (n < started)
+			uring &= w->uring;
+		files += w->files;
+		failed += w->failed;
+		bytes_in += w->bytes_in;
+		bytes_out += w->bytes_out;
+		batch_worker_fini(w);
+	}
+	free(b->workers);
+
+	if (started == 0)
+		return (-1);
+
+	if (secs <= 0.0)
+		secs = 1e-9;
+
+	fprintf(out, "files: %ju\n", (uintmax_t)files);
+	fprintf(out, "failed: %ju\n", (uintmax_t)failed);
+	fprintf(out, "workers: %u\n", b->workers_len);
+	fprintf(out, "backend: %s\n", uring ? "io_uring" : "stdio");
+	fprintf(out, "input_bytes: %ju\n", (uintmax_t)bytes_in);
+	fprintf(out, "output_bytes: %ju\n", (uintmax_t)bytes_out);
+	fprintf(out, "seconds: %.3f\n", secs);
+	fprintf(out, "files_per_second: %.1f\n", (double)files / secs);
+	fprintf(out, "throughput: %.2f MB/s\n", (double)bytes_in / secs / 1e6);
+
+	if (ret == 0 && failed > 0)
+		ret = -1;
+	return (ret);
+}
+
+int
+batch(const char *src, FILE *out, const struct batch_options *opt)
+{
+	struct batch b;
+	struct stat st;
+	FILE *list;
+	size_t n, len;
+	int ret;
+
+	memset(&b, 0, sizeof b);
+	b.opt = opt;
+	b.src_ext = opt->encode ? ".wav" : ".xa";
+	b.dst_ext = opt->encode ? ".xa" : ".wav";
+
+	if (strcmp(src, "-") && stat(src, &st) == 0 && S_ISDIR(st.st_mode)) {
+		len = strlen(src);
+		while (len > 1 && src[len - 1] == '/')
+			len--;
+		ret = batch_walk(&b, src, len);
+	}
+	else {
+		list = strcmp(src, "-") ? fopen(src, "r") : stdin;
+		if (list == NULL) {
+			perror(src);
+			return (-1);
+		}
+		ret = batch_list(&b, list);
+		if (list != stdin)
+			(void)fclose(list);
+	}
+
+	if (ret == 0 && b.jobs_len > 0)
+		qsort(b.jobs, b.jobs_len, sizeof *b.jobs, batch_cmp);
+
+	if (ret == 0)
+		ret = batch_run(&b, out);
+
+	/* prune the cache once all the jobs are done */
+	if (opt->encode && opt->enc.cache != NULL &&
+	    cache_prune(opt->enc.cache, opt->enc.cache_size) < 0)
+		ret = -1;
+
+	for (n = 0; n < b.jobs_len; n++) {
+		free(b.jobs[n].src);
+		free(b.jobs[n].dst);
+	}
+	free(b.jobs);
+	return (ret);
+}
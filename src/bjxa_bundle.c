@@ -0,0 +1,459 @@
+/*-
+ * Copyright (C) 2020  Dridi Boukelmoune
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Bundle writer and extractor.
+ *
+ * The whole index is computed from the XA headers before anything is
+ * written, then the XA streams are copied verbatim after the index. The
+ * extractor relies on the libbjxa reader.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "bjxa.h"
+#include "bjxa_bundle.h"
+#include "bjxa_priv.h"
+
+#define BUNDLE_BUFFER	(64 * 1024)
+
+struct pack_entry {
+	const char	*path;
+	const char	*name;
+	uint64_t	hash;
+	uint32_t	offset;
+	uint32_t	length;
+	uint32_t	name_off;
+	uint8_t		bits;
+	bjxa_format_t	fmt;
+};
+
+struct pack {
+	struct pack_entry	*ent;
+	uint32_t		entries;
+	uint32_t		slots;
+	uint32_t		*table;
+};
+
+static void
+pack_le(uint8_t **buf, uint64_t val, unsigned len)
+{
+
+	while (len > 0) {
+		**buf = (uint8_t)val;
+		*buf += 1;
+		val >>= 8;
+		len--;
+	}
+}
+
+static int
+pack_header(bjxa_decoder_t *dec, struct pack_entry *ent)
+{
+	struct stat st;
+	FILE *file;
+	int ret = 0;
+
+	file = fopen(ent->path, "r");
+	if (file == NULL) {
+		perror(ent->path);
+		return (-1);
+	}
+
+	if (bjxa_fread_header(dec, file) < 0 ||
+	    bjxa_decode_format(dec, &ent->fmt) < 0 ||
+	    fstat(fileno(file), &st) < 0) {
+		perror(ent->path);
+		ret = -1;
+	}
+
+	(void)fclose(file);
+	if (ret < 0)
+		return (-1);
+
+	ent->bits = (uint8_t)((ent->fmt.block_size_xa / ent->fmt.channels -
+	    1) / 4);
+	ent->length = BJXA_HEADER_SIZE_XA +
+	    ent->fmt.blocks * ent->fmt.block_size_xa;
+	if ((uint64_t)st.st_size < ent->length) {
+		fprintf(stderr, "pack: %s: truncated XA file\n", ent->path);
+		return (-1);
+	}
+
+	return (0);
+}
+
+static int
+pack_index(struct pack *p)
+{
+	struct pack_entry *ent, *other;
+	uint32_t n, mask, slot;
+
+	p->slots = 2;
+	while (p->slots < p->entries * 2)
+		p->slots *= 2;
+
+	p->table = calloc(p->slots, sizeof *p->table);
+	if (p->table == NULL) {
+		perror("calloc");
+		return (-1);
+	}
+
+	mask = p->slots - 1;
+	for (n = 0; n < p->entries; n++) {
+		ent = &p->ent[n];
+		slot = (uint32_t)ent->hash & mask;
+		while (p->table[slot] != 0) {
+			other = &p->ent[p->table[slot] - 1];
+			if (other->hash == ent->hash) {
+				fprintf(stderr, "pack: %s: %s\n", ent->name,
+				    strcmp(other->name, ent->name) ?
+				    "hash collision" : "duplicate name");
+				return (-1);
+			}
+			slot = (slot + 1) & mask;
+		}
+		p->table[slot] = n + 1;
+	}
+
+	return (0);
+}
+
+static int
+pack_layout(struct pack *p)
+{
+	struct pack_entry *ent;
+	uint64_t off;
+	uint32_t n;
+
+	off = BJXA_BUNDLE_HEADER + (uint64_t)p->entries * BJXA_BUNDLE_ENTRY +
+	    (uint64_t)p->slots * BJXA_BUNDLE_SLOT;
+
+	for (n = 0; n < p->entries; n++) {
+		ent = &p->ent[n];
+		ent->name_off = (uint32_t)off;
+		off += strlen(ent->name) + 1;
+		if (off > UINT32_MAX)
+			break;
+	}
+
+	for (n = 0; off <= UINT32_MAX && n < p->entries; n++) {
+		ent = &p->ent[n];
+		ent->offset = (uint32_t)off;
+		off += ent->length;
+	}
+
+	/* offsets are 32 bits */
+	if (off > UINT32_MAX) {
+		fprintf(stderr, "pack: bundle too large\n");
+		return (-1);
+	}
+
+	return (0);
+}
+
+static int
+pack_copy(const struct pack_entry *ent, FILE *out, void *buf)
+{
+	FILE *in;
+	size_t len, rem;
+	int ret = 0;
+
+	in = fopen(ent->path, "r");
+	if (in == NULL) {
+		perror(ent->path);
+		return (-1);
+	}
+
+	for (rem = ent->length; ret == 0 && rem > 0; rem -= len) {
+		len = rem < BUNDLE_BUFFER ? rem : BUNDLE_BUFFER;
+		if (fread(buf, len, 1, in) != 1) {
+			fprintf(stderr, "pack: %s: read error\n", ent->path);
+			ret = -1;
+		}
+		else if (fwrite(buf, len, 1, out) != 1) {
+			perror("fwrite");
+			ret = -1;
+		}
+		if (ret < 0)
+			break;
+	}
+
+	(void)fclose(in);
+	return (ret);
+}
+
+static int
+pack_write(const struct pack *p, FILE *out)
+{
+	const struct pack_entry *ent;
+	uint8_t buf[BJXA_BUNDLE_ENTRY], *ptr;
+	void *copy;
+	uint32_t n;
+	int ret = 0;
+
+	ptr = buf;
+	memcpy(ptr, BJXA_BUNDLE_ID, 4);
+	ptr += 4;
+	pack_le(&ptr, BJXA_BUNDLE_VERSION, 4);
+	pack_le(&ptr, p->entries, 4);
+	pack_le(&ptr, p->slots, 4);
+	(void)fwrite(buf, BJXA_BUNDLE_HEADER, 1, out);
+
+	for (n = 0; n < p->entries; n++) {
+		ent = &p->ent[n];
+		ptr = buf;
+		pack_le(&ptr, ent->hash, 8);
+		pack_le(&ptr, ent->offset, 4);
+		pack_le(&ptr, ent->length, 4);
+		pack_le(&ptr, ent->name_off, 4);
+		pack_le(&ptr, ent->fmt.data_len_pcm, 4);
+		pack_le(&ptr, ent->fmt.blocks, 4);
+		pack_le(&ptr, ent->fmt.samples_rate, 2);
+		pack_le(&ptr, ent->bits, 1);
+		pack_le(&ptr, ent->fmt.channels, 1);
+		(void)fwrite(buf, BJXA_BUNDLE_ENTRY, 1, out);
+	}
+
+	for (n = 0; n < p->slots; n++) {
+		ptr = buf;
+		pack_le(&ptr, p->table[n], 4);
+		(void)fwrite(buf, BJXA_BUNDLE_SLOT, 1, out);
+	}
+
+	for (n = 0; n < p->entries; n++)
+		(void)fwrite(p->ent[n].name, strlen(p->ent[n].name) + 1, 1,
+		    out);
+
+	if (ferror(out)) {
+		perror("fwrite");
+		return (-1);
+	}
+
+	copy = malloc(BUNDLE_BUFFER);
+	if (copy == NULL) {
+		perror("malloc");
+		return (-1);
+	}
+
+	for (n = 0; ret == 0 && n < p->entries; n++)
+		ret = pack_copy(&p->ent[n], out, copy);
+
+	free(copy);
+	return (ret);
+}
+
+int
+pack(const char *path, int argc, char * const *argv)
+{
+	struct pack p;
+	bjxa_decoder_t *dec;
+	const char *name;
+	FILE *out;
+	uint32_t n;
+	int ret = 0;
+
+	memset(&p, 0, sizeof p);
+	p.entries = (uint32_t)argc;
+	p.ent = calloc(p.entries, sizeof *p.ent);
+	if (p.ent == NULL) {
+		perror("calloc");
+		return (-1);
+	}
+
+	dec = bjxa_decoder();
+	if (dec == NULL) {
+		perror("bjxa_decoder");
+		free(p.ent);
+		return (-1);
+	}
+
+	/* entries are named after their relative path */
+	for (n = 0; ret == 0 && n < p.entries; n++) {
+		name = argv[n];
+		while (*name == '/' || !strncmp(name, "./", 2))
+			name += *name == '/' ? 1 : 2;
+		p.ent[n].path = argv[n];
+		p.ent[n].name = name;
+		p.ent[n].hash = bjxa_bundle_hash(name);
+		ret = pack_header(dec, &p.ent[n]);
+	}
+
+	(void)bjxa_free_decoder(&dec);
+
+	if (ret == 0)
+		ret = pack_index(&p);
+	if (ret == 0)
+		ret = pack_layout(&p);
+
+	if (ret == 0) {
+		out = fopen(path, "w");
+		if (out == NULL) {
+			perror(path);
+			ret = -1;
+		}
+		else {
+			ret = pack_write(&p, out);
+			if (fclose(out) != 0 && ret == 0) {
+				perror(path);
+				ret = -1;
+			}
+			if (ret < 0)
+				(void)unlink(path);
+		}
+	}
+
+	free(p.table);
+	free(p.ent);
+	return (ret);
+}
+
+static int
+unpack_decode(bjxa_decoder_t *dec, const bjxa_entry_t *ent, FILE *out)
+{
+	const uint8_t *xa;
+	void *pcm;
+	int ret = 0;
+
+	/* the format comes from the index, not the XA header */
+	pcm = malloc(ent->fmt.data_len_pcm);
+	if (pcm == NULL) {
+		perror("malloc");
+		return (-1);
+	}
+
+	xa = ent->xa;
+	if (bjxa_parse_header(dec, xa, ent->xa_len) < 0 ||
+	    bjxa_fwrite_riff_header(dec, out) < 0 ||
+	    bjxa_decode(dec, pcm, ent->fmt.data_len_pcm,
+	    xa + BJXA_HEADER_SIZE_XA, ent->xa_len - BJXA_HEADER_SIZE_XA) !=
+	    (int)ent->fmt.blocks ||
+	    bjxa_fwrite_pcm(pcm, ent->fmt.data_len_pcm, out) < 0) {
+		perror(ent->name);
+		ret = -1;
+	}
+
+	free(pcm);
+	return (ret);
+}
+
+static char *
+unpack_path(const char *dir, const char *name, unsigned decode)
+{
+	size_t dir_len, name_len;
+	char *path;
+
+	dir_len = strlen(dir);
+	name_len = strlen(name);
+	if (decode && name_len > 3 &&
+	    !strcasecmp(name + name_len - 3, ".xa"))
+		name_len -= 3;
+
+	path = malloc(dir_len + name_len + 6);
+	if (path == NULL)
+		return (NULL);
+
+	memcpy(path, dir, dir_len);
+	path[dir_len] = '/';
+	memcpy(path + dir_len + 1, name, name_len);
+	strcpy(path + dir_len + 1 + name_len, decode ? ".wav" : "");
+	return (path);
+}
+
+static int
+unpack_entry(bjxa_decoder_t *dec, const bjxa_entry_t *ent, const char *dir,
+    unsigned decode)
+{
+	char *path;
+	FILE *out;
+	int ret = 0;
+
+	if (safe_path(ent->name) < 0) {
+		fprintf(stderr, "unpack: %s: unsafe name\n", ent->name);
+		return (-1);
+	}
+
+	path = unpack_path(dir, ent->name, decode);
+	if (path == NULL) {
+		perror("malloc");
+		return (-1);
+	}
+
+	out = NULL;
+	if (mkdirs(path) < 0 || (out = fopen(path, "w")) == NULL) {
+		perror(path);
+		free(path);
+		return (-1);
+	}
+
+	if (decode)
+		ret = unpack_decode(dec, ent, out);
+	else if (fwrite(ent->xa, ent->xa_len, 1, out) != 1) {
+		perror(path);
+		ret = -1;
+	}
+
+	if (fclose(out) != 0 && ret == 0) {
+		perror(path);
+		ret = -1;
+	}
+	if (ret < 0)
+		(void)unlink(path);
+
+	free(path);
+	return (ret);
+}
+
+int
+unpack(const char *path, const char *dir, unsigned decode)
+{
+	bjxa_bundle_t *bundle;
+	bjxa_decoder_t *dec;
+	bjxa_entry_t ent;
+	uint32_t n;
+	int ret = 0;
+
+	bundle = bjxa_bundle(path);
+	if (bundle == NULL) {
+		perror(path);
+		return (-1);
+	}
+
+	dec = bjxa_decoder();
+	if (dec == NULL) {
+		perror("bjxa_decoder");
+		(void)bjxa_free_bundle(&bundle);
+		return (-1);
+	}
+
+	for (n = 0; ret == 0 && bjxa_bundle_entry(bundle, n, &ent) == 0; n++)
+		ret = unpack_entry(dec, &ent, dir, decode);
+
+	(void)bjxa_free_decoder(&dec);
+	(void)bjxa_free_bundle(&bundle);
+	return (ret);
+}
@@ -0,0 +1,42 @@
+/*-
+ * Copyright (C) 2020  Dridi Boukelmoune
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Bundle format, shared by the libbjxa reader and the bjxa(1) writer and
+ * described in bjxa(5).
+ */
+
+#define BJXA_BUNDLE_ID		"BJXB"
+#define BJXA_BUNDLE_VERSION	1
+#define BJXA_BUNDLE_HEADER	16
+#define BJXA_BUNDLE_ENTRY	32
+#define BJXA_BUNDLE_SLOT	4
+
+/* 64 bits FNV-1a */
+static inline uint64_t
+bjxa_bundle_hash(const char *name)
+{
+	uint64_t hash = UINT64_C(0xcbf29ce484222325);
+
+	while (*name != '\0') {
+		hash ^= (uint8_t)*name;
+		hash *= UINT64_C(0x100000001b3);
+		name++;
+	}
+
+	return (hash);
+}
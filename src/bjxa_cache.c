@@ -0,0 +1,524 @@
+/*-
+ * Copyright (C) 2020  Dridi Boukelmoune
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Encode cache.
+ *
+ * XA files are stored in a flat directory, named after a 128 bits hash of
+ * the PCM samples, their format, the encoding options and the version of
+ * bjxa. On a hit the cached file is copied to the output and its
+ * modification time is updated, on a miss the WAV file is encoded in
+ * memory and stored with a rename, so concurrent batch jobs never see a
+ * partial file. Pruning removes the least recently used files until the
+ * cache fits in its size bound.
+ *
+ * Trimming leading and trailing silence needs the whole WAV file too, so
+ * the same path encodes files in memory with or without a cache.
+ *
+ * The hash is not cryptographic, the cache directory is trusted.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bjxa.h"
+#include "bjxa_priv.h"
+
+#define CACHE_KEY_LEN	32
+#define CACHE_EXT	".xa"
+
+struct cache_entry {
+	char	name[CACHE_KEY_LEN + sizeof CACHE_EXT];
+	time_t	mtime;
+	off_t	size;
+};
+
+/* hashing */
+
+static uint64_t
+cache_rotl(uint64_t val, unsigned bits)
+{
+
+	return ((val << bits) | (val >> (64 - bits)));
+}
+
+static uint64_t
+cache_mix(uint64_t val)
+{
+
+	/* splitmix64 finalizer */
+	val ^= val >> 30;
+	val *= 0xbf58476d1ce4e5b9;
+	val ^= val >> 27;
+	val *= 0x94d049bb133111eb;
+	val ^= val >> 31;
+	return (val);
+}
+
+static void
+cache_hash(uint64_t *hash, const uint8_t *buf, size_t len)
+{
+	uint64_t word;
+	unsigned n;
+
+	/* two independent lanes, fed with little endian words */
+	while (len > 0) {
+		word = 0;
+		for (n = 0; n < 8 && n < len; n++)
+			word |= (uint64_t)buf[n] << (n * 8);
+		hash[0] = cache_rotl((hash[0] ^ word) * 0x9e3779b97f4a7c15,
+		    29);
+		hash[1] = cache_rotl(hash[1] + word, 31) * 0xc2b2ae3d27d4eb4f;
+		hash[2] += n;
+		buf += n;
+		len -= n;
+	}
+}
+
+static void
+cache_key(char *key, const struct encode_options *opt,
+    const bjxa_format_t *fmt, const uint8_t *pcm)
+{
+	uint64_t hash[3] = { 0x736f6d6570736575, 0x646f72616e646f6d, 0 };
+	char meta[128];
+	int len;
+
+	len = snprintf(meta, sizeof meta, "bjxa %s bits=%u dither=%u "
+	    "rate=%u channels=%u sample_bits=%u\n", PACKAGE_VERSION,
+	    opt->bits, opt->dither, fmt->samples_rate,
+	    fmt->channels, fmt->sample_bits);
+	assert(len > 0 && (size_t)len < sizeof meta);
+
+	cache_hash(hash, (const uint8_t *)meta, (size_t)len);
+	cache_hash(hash, pcm, fmt->data_len_pcm);
+
+	(void)snprintf(key, CACHE_KEY_LEN + 1, "%016jx%016jx",
+	    (uintmax_t)cache_mix(hash[0] ^ hash[2]),
+	    (uintmax_t)cache_mix(hash[1] + hash[2]));
+}
+
+/* lookup and storage */
+
+static char *
+cache_path(const char *dir, const char *name)
+{
+	char *path;
+	size_t len;
+
+	len = strlen(dir) + strlen(name) + 2;
+	path = malloc(len);
+	if (path != NULL)
+		(void)snprintf(path, len, "%s/%s", dir, name);
+	return (path);
+}
+
+static int
+cache_lookup(const char *path, FILE *out)
+{
+	uint8_t *buf;
+	size_t len;
+	int fd, ret = 1;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0 && errno == ENOENT)
+		return (0);
+	if (fd < 0) {
+		perror(path);
+		return (-1);
+	}
+
+	/* the modification time tracks the last use */
+	buf = read_all(fd, &len);
+	if (buf == NULL || futimens(fd, NULL) < 0) {
+		perror(path);
+		ret = -1;
+	}
+
+	if (ret == 1 && fwrite(buf, len, 1, out) != 1) {
+		perror("fwrite");
+		ret = -1;
+	}
+
+	free(buf);
+	(void)close(fd);
+	return (ret);
+}
+
+static void
+cache_store(const char *dir, const char *path, const void *buf, size_t len)
+{
+	char *tmp;
+	int fd;
+
+	/* the cache is best effort, failures only leave a warning */
+	if (mkdir(dir, 0777) < 0 && errno != EEXIST) {
+		perror(dir);
+		return;
+	}
+
+	tmp = cache_path(dir, ".tmp.XXXXXX");
+	if (tmp == NULL) {
+		perror("malloc");
+		return;
+	}
+
+	fd = mkstemp(tmp);
+	if (fd < 0) {
+		perror(tmp);
+		free(tmp);
+		return;
+	}
+
+	if (write(fd, buf, len) != (ssize_t)len || fchmod(fd, 0644) < 0 ||
+	    close(fd) < 0 || rename(tmp, path) < 0) {
+		perror(tmp);
+		(void)unlink(tmp);
+	}
+
+	free(tmp);
+}
+
+/* encoding */
+
+static void *
+cache_encode(const struct encode_options *opt, bjxa_format_t *fmt,
+    const uint8_t *pcm, size_t pcm_len, size_t *lenp)
+{
+	bjxa_encoder_t *enc;
+	uint8_t *xa;
+	size_t len = 0;
+
+	enc = bjxa_encoder();
+	if (enc == NULL) {
+		perror("bjxa_encoder");
+		return (NULL);
+	}
+
+	xa = NULL;
+	if (bjxa_encode_init(enc, fmt, (uint8_t)opt->bits) < 0)
+		perror("bjxa_encode_init");
+	else if (opt->dither && bjxa_encode_dither(enc, 1) < 0)
+		perror("bjxa_encode_dither");
+	else {
+		len = BJXA_HEADER_SIZE_XA +
+		    (size_t)fmt->blocks * fmt->block_size_xa;
+		xa = malloc(len);
+		if (xa == NULL)
+			perror("malloc");
+	}
+
+	if (xa != NULL && (bjxa_dump_header(enc, xa, len) < 0 ||
+	    bjxa_encode(enc, xa + BJXA_HEADER_SIZE_XA,
+	    len - BJXA_HEADER_SIZE_XA, pcm, pcm_len) !=
+	    (int)fmt->blocks)) {
+		perror("bjxa_encode");
+		free(xa);
+		xa = NULL;
+	}
+
+	(void)bjxa_free_encoder(&enc);
+	if (xa != NULL)
+		*lenp = len;
+	return (xa);
+}
+
+static int
+cache_miss(const struct encode_options *opt, bjxa_format_t *fmt,
+    const uint8_t *pcm, size_t pcm_len, const char *path, FILE *out)
+{
+	uint8_t *xa;
+	size_t len;
+
+	xa = cache_encode(opt, fmt, pcm, pcm_len, &len);
+	if (xa == NULL)
+		return (-1);
+
+	if (fwrite(xa, len, 1, out) != 1) {
+		perror("fwrite");
+		free(xa);
+		return (-1);
+	}
+
+	if (path != NULL)
+		cache_store(opt->cache, path, xa, len);
+	free(xa);
+	return (0);
+}
+
+/* silence trimming */
+
+static int
+trim_frame(const uint8_t *pcm, size_t frame, uint8_t silence)
+{
+
+	while (frame > 0) {
+		if (*pcm != silence)
+			return (0);
+		pcm++;
+		frame--;
+	}
+	return (1);
+}
+
+static size_t
+trim_silence(bjxa_format_t *fmt, const uint8_t *pcm, size_t frame)
+{
+	size_t first, last;
+	uint8_t silence;
+
+	/* unsigned 8 bits samples are centered on 128 */
+	silence = fmt->sample_bits == 8 ? 0x80 : 0x00;
+
+	first = 0;
+	last = fmt->data_len_pcm;
+	while (first < last && trim_frame(pcm + first, frame, silence))
+		first += frame;
+	while (last > first && trim_frame(pcm + last - frame, frame, silence))
+		last -= frame;
+
+	/* keep a single frame of complete silence */
+	if (first == last) {
+		first = 0;
+		last = frame;
+	}
+
+	fmt->data_len_pcm = (uint32_t)(last - first);
+	return (first);
+}
+
+static int
+cache_wav(const struct encode_options *opt, uint8_t **wavp, size_t len,
+    FILE *out)
+{
+	bjxa_format_t fmt;
+	char key[CACHE_KEY_LEN + sizeof CACHE_EXT], *path;
+	const uint8_t *pcm;
+	uint8_t *wav;
+	ssize_t off;
+	size_t frame, pad;
+	int ret;
+
+	wav = *wavp;
+	off = bjxa_parse_riff_header(&fmt, wav, len);
+	if (off < 0) {
+		perror("bjxa_parse_riff_header");
+		return (-1);
+	}
+
+	/* a stream of unknown length ends with the last complete frame */
+	frame = (size_t)fmt.channels * fmt.sample_bits / 8;
+	if (fmt.data_len_pcm == 0) {
+		if (len - (size_t)off > UINT32_MAX) {
+			fprintf(stderr, "encode: stream too long\n");
+			return (-1);
+		}
+		fmt.data_len_pcm = (uint32_t)((len - (size_t)off) / frame *
+		    frame);
+	}
+
+	if (len - (size_t)off < fmt.data_len_pcm) {
+		fprintf(stderr, "fread: End of file\n");
+		return (-1);
+	}
+
+	/* the encoder expects at least one complete block of samples */
+	pad = BLOCK_SAMPLES * frame;
+	wav = realloc(wav, (size_t)off + fmt.data_len_pcm + pad);
+	if (wav == NULL) {
+		perror("realloc");
+		return (-1);
+	}
+	*wavp = wav;
+	memset(wav + off + fmt.data_len_pcm, 0, pad);
+
+	pcm = wav + off;
+	if (opt->trim)
+		pcm += trim_silence(&fmt, pcm, frame);
+
+	if (opt->cache == NULL)
+		return (cache_miss(opt, &fmt, pcm, fmt.data_len_pcm + pad,
+		    NULL, out));
+
+	/* trimmed samples share their entries with untrimmed ones */
+	cache_key(key, opt, &fmt, pcm);
+	(void)strcat(key, CACHE_EXT);
+	path = cache_path(opt->cache, key);
+	if (path == NULL) {
+		perror("malloc");
+		return (-1);
+	}
+
+	ret = cache_lookup(path, out);
+	if (ret == 0)
+		ret = cache_miss(opt, &fmt, pcm, fmt.data_len_pcm + pad, path,
+		    out);
+	else if (ret == 1)
+		ret = 0;
+
+	free(path);
+	return (ret);
+}
+
+int
+encode_cache(FILE *in, FILE *out, const struct encode_options *opt)
+{
+	uint8_t *wav;
+	size_t len;
+	int ret;
+
+	assert(opt->cache != NULL || opt->trim);
+
+	/* nothing was read from the input yet */
+	wav = read_all(fileno(in), &len);
+	if (wav == NULL) {
+		perror("read");
+		return (-1);
+	}
+
+	ret = cache_wav(opt, &wav, len, out);
+	free(wav);
+	return (ret);
+}
+
+/* pruning */
+
+static int
+cache_cmp(const void *a, const void *b)
+{
+	const struct cache_entry *ea = a, *eb = b;
+
+	if (ea->mtime != eb->mtime)
+		return (ea->mtime < eb->mtime ? -1 : 1);
+	return (strcmp(ea->name, eb->name));
+}
+
+static int
+cache_entry(const char *name)
+{
+	size_t len;
+
+	len = strlen(name);
+	return (len == CACHE_KEY_LEN + strlen(CACHE_EXT) &&
+	    strspn(name, "0123456789abcdef") == CACHE_KEY_LEN &&
+	    !strcmp(name + CACHE_KEY_LEN, CACHE_EXT));
+}
+
+static int
+cache_scan(const char *dir, struct cache_entry **entp, size_t *lenp,
+    uint64_t *sizep)
+{
+	struct cache_entry *ent, *tmp;
+	struct dirent *de;
+	struct stat st;
+	size_t len, size;
+	char *path;
+	DIR *d;
+
+	d = opendir(dir);
+	if (d == NULL)
+		return (errno == ENOENT ? 0 : -1);
+
+	ent = NULL;
+	len = 0;
+	size = 0;
+
+	while ((de = readdir(d)) != NULL) {
+		if (!cache_entry(de->d_name))
+			continue;
+
+		path = cache_path(dir, de->d_name);
+		if (path == NULL)
+			break;
+		/* another job may prune the same entries */
+		if (stat(path, &st) < 0 || !S_ISREG(st.st_mode)) {
+			free(path);
+			continue;
+		}
+		free(path);
+
+		if (len == size) {
+			size = size * 2 + 16;
+			tmp = realloc(ent, size * sizeof *ent);
+			if (tmp == NULL)
+				break;
+			ent = tmp;
+		}
+
+		(void)strcpy(ent[len].name, de->d_name);
+		ent[len].mtime = st.st_mtime;
+		ent[len].size = st.st_size;
+		*sizep += (uint64_t)st.st_size;
+		len++;
+	}
+
+	(void)closedir(d);
+	*entp = ent;
+	*lenp = len;
+	return (de == NULL ? 0 : -1);
+}
+
+int
+cache_prune(const char *dir, uint64_t max)
+{
+	struct cache_entry *ent;
+	uint64_t size;
+	size_t len, n;
+	char *path;
+	int ret;
+
+	ent = NULL;
+	len = 0;
+	size = 0;
+
+	ret = cache_scan(dir, &ent, &len, &size);
+	if (ret < 0)
+		perror(dir);
+
+	if (ret == 0 && size > max && len > 0)
+		qsort(ent, len, sizeof *ent, cache_cmp);
+
+	/* the least recently used entries go first */
+	for (n = 0; ret == 0 && size > max && n < len; n++) {
+		path = cache_path(dir, ent[n].name);
+		if (path == NULL) {
+			perror("malloc");
+			ret = -1;
+			break;
+		}
+		if (unlink(path) < 0 && errno != ENOENT) {
+			perror(path);
+			ret = -1;
+		}
+		size -= (uint64_t)ent[n].size;
+		free(path);
+	}
+
+	free(ent);
+	return (ret);
+}
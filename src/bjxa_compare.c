@@ -0,0 +1,352 @@
+/*-
+ * Copyright (C) 2020  Dridi Boukelmoune
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef HAVE_SSE2
+#  include <emmintrin.h>
+#endif
+
+#include "bjxa.h"
+#include "bjxa_priv.h"
+
+struct compare_block {
+	uint32_t	index;
+	uint32_t	error;
+};
+
+struct compare_state {
+	uint64_t		samples;
+	uint64_t		signal;
+	uint64_t		noise;
+	uint32_t		peak;
+	uint32_t		worst_len;
+	uint32_t		worst_max;
+	struct compare_block	*worst;
+};
+
+#ifdef HAVE_SSE2
+/* SSE2 is always available on x86_64, and x86 being little endian, the
+ * WAV samples can be loaded as-is. Squares are accumulated in 64 bits
+ * lanes to avoid overflows.
+ */
+
+static __m128i
+compare_abs_epi32(__m128i vec)
+{
+	__m128i sign;
+
+	sign = _mm_srai_epi32(vec, 31);
+	return (_mm_sub_epi32(_mm_xor_si128(vec, sign), sign));
+}
+
+static __m128i
+compare_square_epi64(__m128i vec)
+{
+	__m128i odd;
+
+	odd = _mm_srli_epi64(vec, 32);
+	return (_mm_add_epi64(_mm_mul_epu32(vec, vec),
+	    _mm_mul_epu32(odd, odd)));
+}
+
+static unsigned
+compare_samples_sse2(const int16_t *xa, const uint8_t *wav,
+    unsigned samples, uint64_t *signal, uint64_t *noise, uint32_t *peak)
+{
+	__m128i vec_xa, vec_wav, xa32[2], wav32[2], err, gt;
+	__m128i vec_signal, vec_noise, vec_peak;
+	uint64_t sums[2];
+	uint32_t peaks[4];
+	unsigned h, n;
+
+	vec_signal = _mm_setzero_si128();
+	vec_noise = _mm_setzero_si128();
+	vec_peak = _mm_setzero_si128();
+
+	for (n = 0; n + 8 <= samples; n += 8) {
+		vec_xa = _mm_loadu_si128((const void *)(xa + n));
+		vec_wav = _mm_loadu_si128((const void *)(wav + n * 2));
+
+		/* sign extension to 32 bits */
+		xa32[0] = _mm_srai_epi32(_mm_unpacklo_epi16(vec_xa, vec_xa),
+		    16);
+		xa32[1] = _mm_srai_epi32(_mm_unpackhi_epi16(vec_xa, vec_xa),
+		    16);
+		wav32[0] = _mm_srai_epi32(
+		    _mm_unpacklo_epi16(vec_wav, vec_wav), 16);
+		wav32[1] = _mm_srai_epi32(
+		    _mm_unpackhi_epi16(vec_wav, vec_wav), 16);
+
+		for (h = 0; h < 2; h++) {
+			err = compare_abs_epi32(
+			    _mm_sub_epi32(xa32[h], wav32[h]));
+			vec_signal = _mm_add_epi64(vec_signal,
+			    compare_square_epi64(
+			    compare_abs_epi32(wav32[h])));
+			vec_noise = _mm_add_epi64(vec_noise,
+			    compare_square_epi64(err));
+			gt = _mm_cmpgt_epi32(err, vec_peak);
+			vec_peak = _mm_or_si128(_mm_and_si128(gt, err),
+			    _mm_andnot_si128(gt, vec_peak));
+		}
+	}
+
+	_mm_storeu_si128((void *)sums, vec_signal);
+	*signal += sums[0] + sums[1];
+	_mm_storeu_si128((void *)sums, vec_noise);
+	*noise += sums[0] + sums[1];
+	_mm_storeu_si128((void *)peaks, vec_peak);
+	for (h = 0; h < 4; h++)
+		if (peaks[h] > *peak)
+			*peak = peaks[h];
+
+	return (n);
+}
+#endif
+
+static uint32_t
+compare_samples(struct compare_state *cs, const int16_t *xa,
+    const uint8_t *wav, unsigned samples)
+{
+	uint64_t signal, noise;
+	uint32_t err, peak;
+	int32_t ref, diff;
+	unsigned n;
+
+	signal = 0;
+	noise = 0;
+	peak = 0;
+	n = 0;
+
+#ifdef HAVE_SSE2
+	n = compare_samples_sse2(xa, wav, samples, &signal, &noise, &peak);
+#endif
+
+	for (; n < samples; n++) {
+		ref = (int16_t)(wav[n * 2] | wav[n * 2 + 1] << 8);
+		diff = xa[n] - ref;
+		signal += (uint64_t)(ref * ref);
+		noise += (uint64_t)((int64_t)diff * diff);
+		err = (uint32_t)(diff < 0 ? -diff : diff);
+		if (err > peak)
+			peak = err;
+	}
+
+	cs->samples += samples;
+	cs->signal += signal;
+	cs->noise += noise;
+	if (peak > cs->peak)
+		cs->peak = peak;
+	return (peak);
+}
+
+static void
+compare_worst(struct compare_state *cs, uint32_t index, uint32_t error)
+{
+	uint32_t n;
+
+	if (cs->worst_max == 0 || error == 0)
+		return;
+	if (cs->worst_len == cs->worst_max &&
+	    error <= cs->worst[cs->worst_len - 1].error)
+		return;
+
+	/* keep the list sorted, with the earliest block first on ties */
+	n = cs->worst_len;
+	if (n < cs->worst_max)
+		cs->worst_len++;
+	else
+		n--;
+
+	while (n > 0 && cs->worst[n - 1].error < error) {
+		cs->worst[n] = cs->worst[n - 1];
+		n--;
+	}
+
+	cs->worst[n].index = index;
+	cs->worst[n].error = error;
+}
+
+static int
+compare_header(bjxa_decoder_t *dec, FILE *xa, FILE *wav,
+    bjxa_format_t *xa_fmt)
+{
+	bjxa_format_t wav_fmt;
+
+	if (bjxa_fread_header(dec, xa) < 0) {
+		perror("bjxa_fread_header");
+		return (-1);
+	}
+
+	if (bjxa_decode_format(dec, xa_fmt) < 0) {
+		perror("bjxa_decode_format");
+		return (-1);
+	}
+
+	if (bjxa_fread_riff_header(&wav_fmt, wav) < 0) {
+		perror("bjxa_fread_riff_header");
+		return (-1);
+	}
+
+	if (wav_fmt.sample_bits != 16) {
+		fprintf(stderr, "compare: WAV samples are not 16 bits\n");
+		return (-1);
+	}
+
+	if (wav_fmt.channels != xa_fmt->channels ||
+	    wav_fmt.samples_rate != xa_fmt->samples_rate) {
+		fprintf(stderr, "compare: format mismatch\n");
+		return (-1);
+	}
+
+	/* a WAV stream of unknown length only needs enough samples */
+	if (wav_fmt.data_len_pcm != 0 &&
+	    wav_fmt.data_len_pcm != xa_fmt->data_len_pcm) {
+		fprintf(stderr, "compare: length mismatch\n");
+		return (-1);
+	}
+
+	return (0);
+}
+
+static int
+compare_loop(bjxa_decoder_t *dec, FILE *xa, FILE *wav,
+    struct compare_state *cs)
+{
+	bjxa_format_t fmt;
+	int16_t buf_pcm[2 * BLOCK_SAMPLES];
+	uint8_t buf_xa[BLOCK_SIZE_XA], buf_wav[sizeof buf_pcm];
+	uint32_t pcm_block, index, error;
+
+	if (compare_header(dec, xa, wav, &fmt) < 0)
+		return (-1);
+
+	assert(fmt.block_size_xa <= sizeof buf_xa);
+	assert(fmt.block_size_pcm <= sizeof buf_pcm);
+
+	for (index = 0; fmt.blocks > 0; index++) {
+		if (fread(buf_xa, fmt.block_size_xa, 1, xa) != 1) {
+			if (feof(xa))
+				fprintf(stderr, "fread: End of file\n");
+			else
+				perror("fread");
+			return (-1);
+		}
+
+		if (bjxa_decode(dec, buf_pcm, fmt.block_size_pcm, buf_xa,
+		    fmt.block_size_xa) != 1) {
+			perror("bjxa_decode");
+			return (-1);
+		}
+
+		pcm_block = fmt.block_size_pcm;
+		assert(fmt.data_len_pcm > 0);
+		if (pcm_block > fmt.data_len_pcm)
+			pcm_block = fmt.data_len_pcm;
+
+		if (fread(buf_wav, pcm_block, 1, wav) != 1) {
+			if (feof(wav))
+				fprintf(stderr, "compare: WAV too short\n");
+			else
+				perror("fread");
+			return (-1);
+		}
+
+		error = compare_samples(cs, buf_pcm, buf_wav,
+		    pcm_block / sizeof *buf_pcm);
+		compare_worst(cs, index, error);
+
+		fmt.data_len_pcm -= pcm_block;
+		fmt.blocks--;
+	}
+
+	return (0);
+}
+
+static void
+compare_report(const struct compare_state *cs, FILE *out)
+{
+	double signal, noise, peak;
+	uint32_t n;
+
+	signal = (double)cs->signal;
+	noise = (double)cs->noise;
+	peak = (double)INT16_MAX * INT16_MAX * (double)cs->samples;
+
+	fprintf(out, "samples: %ju\n", (uintmax_t)cs->samples);
+	if (cs->noise == 0) {
+		fprintf(out, "snr: inf\n");
+		fprintf(out, "psnr: inf\n");
+	}
+	else {
+		fprintf(out, "snr: %.2f\n", cs->signal == 0 ? -INFINITY :
+		    10 * log10(signal / noise));
+		fprintf(out, "psnr: %.2f\n", 10 * log10(peak / noise));
+	}
+	fprintf(out, "peak_error: %u\n", cs->peak);
+
+	for (n = 0; n < cs->worst_len; n++)
+		fprintf(out, "worst[%u]: block %u error %u\n", n,
+		    cs->worst[n].index, cs->worst[n].error);
+}
+
+int
+compare(FILE *xa, FILE *wav, FILE *out, const struct compare_options *opt)
+{
+	struct compare_state cs;
+	bjxa_decoder_t *dec;
+	int status = 0;
+
+	memset(&cs, 0, sizeof cs);
+	cs.worst_max = opt->worst;
+	if (cs.worst_max > 0) {
+		cs.worst = calloc(cs.worst_max, sizeof *cs.worst);
+		if (cs.worst == NULL) {
+			perror("calloc");
+			return (-1);
+		}
+	}
+
+	dec = bjxa_decoder();
+	if (dec == NULL) {
+		perror("bjxa_decoder");
+		free(cs.worst);
+		return (-1);
+	}
+
+	if (compare_loop(dec, xa, wav, &cs) < 0)
+		status = -1;
+	else
+		compare_report(&cs, out);
+
+	if (bjxa_free_decoder(&dec) < 0) {
+		perror("bjxa_free_decoder");
+		status = -1;
+	}
+
+	free(cs.worst);
+	return (status);
+}
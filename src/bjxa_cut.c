@@ -0,0 +1,229 @@
+/*-
+ * Copyright (C) 2020  Dridi Boukelmoune
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Block-level editing.
+ *
+ * Inputs are read in memory and the library copies whole XA blocks, so
+ * the output decodes to the exact same samples as the input.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bjxa.h"
+#include "bjxa_priv.h"
+
+static int
+cut_write(const void *buf, size_t len, FILE *out)
+{
+
+	if (fwrite(buf, len, 1, out) != 1 || fflush(out) != 0) {
+		perror("fwrite");
+		return (-1);
+	}
+	return (0);
+}
+
+static int
+cut_range(bjxa_decoder_t *dec, const void *src, size_t src_len, FILE *out,
+    const struct cut_options *opt)
+{
+	bjxa_format_t fmt;
+	uint32_t to;
+	size_t len;
+	ssize_t res;
+	void *dst;
+	int status;
+
+	if (bjxa_parse_header(dec, src, src_len) < 0 ||
+	    bjxa_decode_format(dec, &fmt) < 0) {
+		perror("bjxa_parse_header");
+		return (-1);
+	}
+
+	to = opt->to;
+	if (to == UINT32_MAX)
+		to = fmt.blocks;
+	if (opt->from >= to || to > fmt.blocks) {
+		fprintf(stderr, "cut: invalid range, the XA stream has %u "
+		    "blocks\n", fmt.blocks);
+		return (-1);
+	}
+
+	len = BJXA_HEADER_SIZE_XA + (size_t)(to - opt->from) *
+	    fmt.block_size_xa;
+	dst = malloc(len);
+	if (dst == NULL) {
+		perror("malloc");
+		return (-1);
+	}
+
+	res = bjxa_cut(dec, dst, len, src, src_len, opt->from, to);
+	if (res < 0) {
+		perror("bjxa_cut");
+		status = -1;
+	}
+	else
+		status = cut_write(dst, (size_t)res, out);
+
+	free(dst);
+	return (status);
+}
+
+int
+cut(FILE *in, FILE *out, const struct cut_options *opt)
+{
+	bjxa_decoder_t *dec;
+	size_t src_len;
+	void *src;
+	int status;
+
+	src = read_all(fileno(in), &src_len);
+	if (src == NULL) {
+		perror("read");
+		return (-1);
+	}
+
+	dec = bjxa_decoder();
+	if (dec == NULL) {
+		perror("bjxa_decoder");
+		free(src);
+		return (-1);
+	}
+
+	status = cut_range(dec, src, src_len, out, opt);
+
+	if (bjxa_free_decoder(&dec) < 0) {
+		perror("bjxa_free_decoder");
+		status = -1;
+	}
+
+	free(src);
+	return (status);
+}
+
+static int
+concat_load(const char *path, const void **srcp, size_t *lenp)
+{
+	FILE *file;
+
+	file = fopen(path, "r");
+	if (file == NULL) {
+		perror(path);
+		return (-1);
+	}
+
+	*srcp = read_all(fileno(file), lenp);
+	if (*srcp == NULL)
+		perror(path);
+	(void)fclose(file);
+	return (*srcp == NULL ? -1 : 0);
+}
+
+static int
+concat_join(bjxa_decoder_t *dec, const char *path, const void * const *src,
+    const size_t *src_len, unsigned n)
+{
+	size_t len;
+	ssize_t res;
+	unsigned i;
+	void *dst;
+	FILE *out;
+	int status;
+
+	/* the input headers make room for the output header */
+	len = 0;
+	for (i = 0; i < n; i++)
+		len += src_len[i];
+
+	dst = malloc(len);
+	if (dst == NULL) {
+		perror("malloc");
+		return (-1);
+	}
+
+	res = bjxa_concat(dec, dst, len, src, src_len, n);
+	if (res < 0) {
+		if (errno == EINVAL)
+			fprintf(stderr, "concat: XA streams can't be joined "
+			    "without decoding\n");
+		else
+			perror("bjxa_concat");
+		free(dst);
+		return (-1);
+	}
+
+	if (!strcmp("-", path))
+		out = stdout;
+	else
+		out = fopen(path, "w");
+
+	if (out == NULL) {
+		perror(path);
+		status = -1;
+	}
+	else
+		status = cut_write(dst, (size_t)res, out);
+
+	if (out != NULL && out != stdout && fclose(out) != 0) {
+		perror(path);
+		status = -1;
+	}
+
+	free(dst);
+	return (status);
+}
+
+int
+concat(const char *path, int argc, char * const *argv)
+{
+	bjxa_decoder_t *dec;
+	const void **src;
+	size_t *src_len;
+	int n, status = 0;
+
+	src = calloc((size_t)argc, sizeof *src);
+	src_len = calloc((size_t)argc, sizeof *src_len);
+	dec = bjxa_decoder();
+
+	if (src == NULL || src_len == NULL || dec == NULL) {
+		perror("concat");
+		status = -1;
+	}
+
+	for (n = 0; status == 0 && n < argc; n++)
+		status = concat_load(argv[n], src + n, src_len + n);
+
+	if (status == 0)
+		status = concat_join(dec, path, src, src_len,
+		    (unsigned)argc);
+
+	if (dec != NULL)
+		(void)bjxa_free_decoder(&dec);
+	for (n = 0; src != NULL && n < argc; n++)
+		free((void *)(uintptr_t)src[n]);
+	free(src_len);
+	free(src);
+	return (status);
+}
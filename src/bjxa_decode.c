@@ -32,7 +32,8 @@
 /* end strip */
 
 static int
-decode_header(bjxa_decoder_t *dec, FILE *in, FILE *out, bjxa_format_t *fmt)
+decode_header(bjxa_decoder_t *dec, FILE *in, FILE *out, bjxa_format_t *fmt,
+    unsigned mix)
 {
 
 	if (bjxa_fread_header(dec, in) < 0) {
@@ -40,6 +41,11 @@ decode_header(bjxa_decoder_t *dec, FILE *in, FILE *out, bjxa_format_t *fmt)
 		return (-1);
 	}
 
+	if (mix != BJXA_MIX_NONE && bjxa_decode_mix(dec, mix) < 0) {
+		perror("bjxa_decode_mix");
+		return (-1);
+	}
+
 	if (bjxa_decode_format(dec, fmt) < 0) {
 		perror("bjxa_decode_format");
 		return (-1);
@@ -55,27 +61,34 @@ decode_header(bjxa_decoder_t *dec, FILE *in, FILE *out, bjxa_format_t *fmt)
 
 #ifdef BJXA_SINGLE_PASS
 static int
-decode_loop(bjxa_decoder_t *dec, FILE *in, FILE *out)
+decode_loop(bjxa_decoder_t *dec, FILE *in, FILE *out, unsigned mix)
 {
 	bjxa_format_t fmt;
-	void *buf_pcm, *buf_xa;
-	uint32_t xa_len;
+	uint8_t *buf, *buf_xa;
+	size_t len, off, xa_len;
 	int ret = 0;
 
-	if (decode_header(dec, in, out, &fmt) < 0)
+	if (decode_header(dec, in, out, &fmt, mix) < 0)
 		return (-1);
 
-	/* allocate space for the whole stream */
-	xa_len = fmt.block_size_xa * fmt.blocks;
-	buf_pcm = malloc(fmt.data_len_pcm);
-	buf_xa = malloc(xa_len);
-
-	if (buf_pcm == NULL || buf_xa == NULL) {
+	/* decode in place, XA blocks are read at the end of the buffer */
+	xa_len = (size_t)fmt.block_size_xa * fmt.blocks;
+	off = 0;
+	if (fmt.block_size_pcm > fmt.block_size_xa)
+		off = (size_t)(fmt.block_size_pcm - fmt.block_size_xa) *
+		    (fmt.blocks - 1);
+	len = off + xa_len;
+	if (len < fmt.data_len_pcm)
+		len = fmt.data_len_pcm;
+
+	buf = malloc(len);
+	if (buf == NULL) {
 		perror("malloc");
-		ret = -1;
+		return (-1);
 	}
+	buf_xa = buf + len - xa_len;
 
-	if (ret == 0 && fread(buf_xa, xa_len, 1, in) != 1) {
+	if (fread(buf_xa, xa_len, 1, in) != 1) {
 		if (feof(in))
 			fprintf(stderr, "fread: End of file\n");
 		else
@@ -83,31 +96,31 @@ decode_loop(bjxa_decoder_t *dec, FILE *in, FILE *out)
 		ret = -1;
 	}
 
-	if (ret == 0 && bjxa_decode(dec, buf_pcm, fmt.data_len_pcm, buf_xa,
+	if (ret == 0 && bjxa_decode(dec, buf, fmt.data_len_pcm, buf_xa,
 	    xa_len) != (int)fmt.blocks) {
 		perror("bjxa_decode");
 		ret = -1;
 	}
 
-	if (ret == 0 && bjxa_fwrite_pcm(buf_pcm, fmt.data_len_pcm, out) < 0) {
+	if (ret == 0 && bjxa_fwrite_pcm((int16_t *)buf, fmt.data_len_pcm,
+	    out) < 0) {
 		perror("bjxa_fwrite_pcm");
 		ret = -1;
 	}
 
-	free(buf_pcm);
-	free(buf_xa);
+	free(buf);
 	return (ret);
 }
 #else /* BJXA_SINGLE_PASS */
 static int
-decode_loop(bjxa_decoder_t *dec, FILE *in, FILE *out)
+decode_loop(bjxa_decoder_t *dec, FILE *in, FILE *out, unsigned mix)
 {
 	bjxa_format_t fmt;
 	void *buf_pcm, *buf_xa;
 	uint32_t pcm_block;
 	int ret = 0;
 
-	if (decode_header(dec, in, out, &fmt) < 0)
+	if (decode_header(dec, in, out, &fmt, mix) < 0)
 		return (-1);
 
 	/* allocate space for exactly one block */
@@ -160,8 +173,34 @@ decode_loop(bjxa_decoder_t *dec, FILE *in, FILE *out)
 }
 #endif /* BJXA_SINGLE_PASS */
 
+static int
+decode_stats(bjxa_decoder_t *dec, FILE *file)
+{
+	bjxa_stats_t stats;
+	unsigned n;
+
+	if (bjxa_decoder_stats(dec, &stats) < 0) {
+		perror("bjxa_decoder_stats");
+		return (-1);
+	}
+
+	fprintf(file, "blocks: %ju\n", (uintmax_t)stats.blocks);
+	fprintf(file, "samples: %ju\n", (uintmax_t)stats.samples);
+	fprintf(file, "clamps: %ju\n", (uintmax_t)stats.clamps);
+	fprintf(file, "silent: %ju\n", (uintmax_t)stats.silent);
+	for (n = 0; n < 5; n++)
+		fprintf(file, "factor[%u]: %ju\n", n,
+		    (uintmax_t)stats.factors[n]);
+	for (n = 0; n < 16; n++)
+		fprintf(file, "range[%u]: %ju\n", n,
+		    (uintmax_t)stats.ranges[n]);
+	fprintf(file, "inflate_ns: %ju\n", (uintmax_t)stats.ns_inflate);
+	fprintf(file, "filter_ns: %ju\n", (uintmax_t)stats.ns_filter);
+	return (0);
+}
+
 int
-decode(FILE *in, FILE *out)
+decode(FILE *in, FILE *out, const struct decode_options *opt)
 {
 	bjxa_decoder_t *dec;
 	int status = 0;
@@ -172,7 +211,10 @@ decode(FILE *in, FILE *out)
 		return (-1);
 	}
 
-	if (decode_loop(dec, in, out) < 0)
+	if (decode_loop(dec, in, out, opt->mix) < 0)
+		status = -1;
+
+	if (status == 0 && opt->stats && decode_stats(dec, stderr) < 0)
 		status = -1;
 
 	if (bjxa_free_decoder(&dec) < 0) {
@@ -182,3 +224,12 @@ decode(FILE *in, FILE *out)
 
 	return (status);
 }
+/* begin strip */
+
+int
+decode_batch(bjxa_decoder_t *dec, FILE *in, FILE *out)
+{
+
+	return (decode_loop(dec, in, out, BJXA_MIX_NONE));
+}
+/* end strip */
@@ -23,6 +23,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/types.h>
 #include <unistd.h>
 
 #include "bjxa.h"
@@ -33,7 +34,7 @@
 
 static int
 encode_header(bjxa_encoder_t *enc, FILE *in, FILE *out, bjxa_format_t *fmt,
-    unsigned bits)
+    const struct encode_options *opt)
 {
 
 	if (bjxa_fread_riff_header(fmt, in) < 0) {
@@ -41,16 +42,20 @@ encode_header(bjxa_encoder_t *enc, FILE *in, FILE *out, bjxa_format_t *fmt,
 		return (-1);
 	}
 
-	if (bjxa_encode_init(enc, fmt, bits) < 0) {
+	if (bjxa_encode_init(enc, fmt, opt->bits) < 0) {
 		perror("bjxa_encode_init");
 		return (-1);
 	}
 
-	if (bjxa_encode_format(enc, fmt) < 0) {
-		perror("bjxa_encode_format");
+	if (opt->dither && bjxa_encode_dither(enc, 1) < 0) {
+		perror("bjxa_encode_dither");
 		return (-1);
 	}
 
+	/* unknown length, the header is written last */
+	if (fmt->data_len_pcm == 0)
+		return (0);
+
 	if (bjxa_fwrite_header(enc, out) < 0) {
 		perror("bjxa_fwrite_header");
 		return (-1);
@@ -59,29 +64,133 @@ encode_header(bjxa_encoder_t *enc, FILE *in, FILE *out, bjxa_format_t *fmt,
 	return (0);
 }
 
-#ifdef BJXA_SINGLE_PASS
 static int
-encode_loop(bjxa_encoder_t *enc, FILE *in, FILE *out, unsigned bits)
+encode_stream(bjxa_encoder_t *enc, FILE *in, FILE *out, bjxa_format_t *fmt)
 {
-	bjxa_format_t fmt;
-	void *buf_pcm, *buf_xa;
-	uint32_t xa_len;
+	uint8_t hdr[BJXA_HEADER_SIZE_XA] = {0};
+	void *buf_pcm, *buf_xa, *ptr;
+	size_t len, pcm_block, xa_len, xa_size, blocks;
+	off_t pos;
 	int ret = 0;
 
-	if (encode_header(enc, in, out, &fmt, bits) < 0)
-		return (-1);
+	/* a seekable output gets a header placeholder, rewritten last */
+	pos = ftello(out);
 
-	/* allocate space for the whole stream */
-	xa_len = fmt.block_size_xa * fmt.blocks;
-	buf_pcm = malloc(fmt.data_len_pcm);
-	buf_xa = malloc(xa_len);
+	blocks = 0;
+	xa_len = 0;
+	xa_size = fmt->block_size_xa;
+	pcm_block = fmt->block_size_pcm * fmt->sample_bits / 16;
+	buf_pcm = malloc(pcm_block);
+	buf_xa = malloc(xa_size);
 
 	if (buf_pcm == NULL || buf_xa == NULL) {
 		perror("malloc");
 		ret = -1;
 	}
 
-	if (ret == 0 && fread(buf_pcm, fmt.data_len_pcm, 1, in) != 1) {
+	while (ret == 0) {
+		len = fread(buf_pcm, 1, pcm_block, in);
+		if (len == 0) {
+			if (ferror(in)) {
+				perror("fread");
+				ret = -1;
+			}
+			break;
+		}
+
+		if (pos < 0 && xa_len == xa_size) {
+			ptr = realloc(buf_xa, xa_size * 2);
+			if (ptr == NULL) {
+				perror("realloc");
+				ret = -1;
+				break;
+			}
+			buf_xa = ptr;
+			xa_size *= 2;
+		}
+
+		ptr = (uint8_t *)buf_xa + xa_len;
+		if (bjxa_encode(enc, ptr, fmt->block_size_xa, buf_pcm,
+		    len) != 1) {
+			perror("bjxa_encode");
+			ret = -1;
+			break;
+		}
+
+		if (pos >= 0 && blocks == 0 &&
+		    fwrite(hdr, sizeof hdr, 1, out) != 1) {
+			perror("fwrite");
+			ret = -1;
+			break;
+		}
+		blocks++;
+
+		if (pos < 0)
+			xa_len += fmt->block_size_xa;
+		else if (fwrite(buf_xa, fmt->block_size_xa, 1, out) != 1) {
+			perror("fwrite");
+			ret = -1;
+		}
+
+		if (len < pcm_block)
+			break;
+	}
+
+	if (ret == 0 && blocks > 0 && pos >= 0 &&
+	    fseeko(out, pos, SEEK_SET) < 0) {
+		perror("fseeko");
+		ret = -1;
+	}
+
+	if (ret == 0 && bjxa_fwrite_header(enc, out) < 0) {
+		perror("bjxa_fwrite_header");
+		ret = -1;
+	}
+
+	if (ret == 0 && xa_len > 0 && fwrite(buf_xa, xa_len, 1, out) != 1) {
+		perror("fwrite");
+		ret = -1;
+	}
+
+	free(buf_pcm);
+	free(buf_xa);
+	return (ret);
+}
+
+#ifdef BJXA_SINGLE_PASS
+static int
+encode_loop(bjxa_encoder_t *enc, FILE *in, FILE *out,
+    const struct encode_options *opt)
+{
+	bjxa_format_t fmt;
+	uint8_t *buf, *buf_pcm;
+	size_t len, off, xa_len, src_block;
+	int ret = 0;
+
+	if (encode_header(enc, in, out, &fmt, opt) < 0)
+		return (-1);
+
+	if (fmt.data_len_pcm == 0)
+		return (encode_stream(enc, in, out, &fmt));
+
+	/* encode in place, WAV samples are read ahead of the XA blocks */
+	xa_len = (size_t)fmt.block_size_xa * fmt.blocks;
+	src_block = (size_t)fmt.block_size_pcm * fmt.sample_bits / 16;
+	off = fmt.block_size_xa;
+	if (fmt.block_size_xa > src_block)
+		off += (fmt.block_size_xa - src_block) * (fmt.blocks - 1);
+	len = off + fmt.data_len_pcm;
+	if (len < xa_len)
+		len = xa_len;
+
+	buf = malloc(len);
+	if (buf == NULL) {
+		perror("malloc");
+		return (-1);
+	}
+	buf_pcm = buf + off;
+
+	if (fread(buf_pcm, fmt.data_len_pcm, 1, in) != 1) {
 		if (feof(in))
 			fprintf(stderr, "fread: End of file\n");
 		else
@@ -89,35 +198,40 @@ encode_loop(bjxa_encoder_t *enc, FILE *in, FILE *out, unsigned bits)
 		ret = -1;
 	}
 
-	if (ret == 0 && bjxa_encode(enc, buf_xa, xa_len, buf_pcm,
+	if (ret == 0 && bjxa_encode(enc, buf, xa_len, buf_pcm,
 	    fmt.data_len_pcm) != (int)fmt.blocks) {
 		perror("bjxa_encode");
 		ret = -1;
 	}
 
-	if (ret == 0 && fwrite(buf_xa, xa_len, 1, out) != 1) {
+	if (ret == 0 && fwrite(buf, xa_len, 1, out) != 1) {
 		perror("fwrite");
 		ret = -1;
 	}
 
-	free(buf_pcm);
-	free(buf_xa);
+	free(buf);
 	return (ret);
 }
 #else /* BJXA_SINGLE_PASS */
 static int
-encode_loop(bjxa_encoder_t *enc, FILE *in, FILE *out, unsigned bits)
+encode_loop(bjxa_encoder_t *enc, FILE *in, FILE *out,
+    const struct encode_options *opt)
 {
 	bjxa_format_t fmt;
 	void *buf_pcm, *buf_xa;
 	uint32_t pcm_block;
+	uint32_t src_block;
 	int ret = 0;
 
-	if (encode_header(enc, in, out, &fmt, bits) < 0)
+	if (encode_header(enc, in, out, &fmt, opt) < 0)
 		return (-1);
 
-	/* allocate space for exactly one block */
-	buf_pcm = malloc(fmt.block_size_pcm);
+	if (fmt.data_len_pcm == 0)
+		return (encode_stream(enc, in, out, &fmt));
+
+	/* allocate space for exactly one block of source samples */
+	src_block = fmt.block_size_pcm * fmt.sample_bits / 16;
+	buf_pcm = malloc(src_block);
 	buf_xa = malloc(fmt.block_size_xa);
 
 	if (buf_pcm == NULL || buf_xa == NULL) {
@@ -125,7 +239,7 @@ encode_loop(bjxa_encoder_t *enc, FILE *in, FILE *out, unsigned bits)
 		ret = -1;
 	}
 
-	pcm_block = fmt.block_size_pcm;
+	pcm_block = src_block;
 	assert(fmt.data_len_pcm > 0);
 
 	while (fmt.blocks > 0 && ret == 0) {
@@ -142,7 +256,7 @@ encode_loop(bjxa_encoder_t *enc, FILE *in, FILE *out, unsigned bits)
 		}
 
 		if (bjxa_encode(enc, buf_xa, fmt.block_size_xa, buf_pcm,
-		    fmt.block_size_pcm) != 1) {
+		    src_block) != 1) {
 			perror("bjxa_encode");
 			ret = -1;
 			break;
@@ -168,18 +282,28 @@ encode_loop(bjxa_encoder_t *enc, FILE *in, FILE *out, unsigned bits)
 #endif /* BJXA_SINGLE_PASS */
 
 int
-encode(FILE *in, FILE *out, unsigned bits)
+encode(FILE *in, FILE *out, const struct encode_options *opt)
 {
 	bjxa_encoder_t *enc;
 	int status = 0;
 
+/* begin strip */
+	if (opt->cache != NULL || opt->trim) {
+		if (encode_cache(in, out, opt) < 0)
+			return (-1);
+		if (opt->cache == NULL)
+			return (0);
+		return (cache_prune(opt->cache, opt->cache_size));
+	}
+/* end strip */
+
 	enc = bjxa_encoder();
 	if (enc == NULL) {
 		perror("bjxa_encoder");
 		return (-1);
 	}
 
-	if (encode_loop(enc, in, out, bits) < 0)
+	if (encode_loop(enc, in, out, opt) < 0)
 		status = -1;
 
 	if (bjxa_free_encoder(&enc) < 0) {
@@ -189,3 +313,15 @@ encode(FILE *in, FILE *out, unsigned bits)
 
 	return (status);
 }
+/* begin strip */
+
+int
+encode_batch(bjxa_encoder_t *enc, FILE *in, FILE *out,
+    const struct encode_options *opt)
+{
+
+	if (opt->cache != NULL || opt->trim)
+		return (encode_cache(in, out, opt));
+	return (encode_loop(enc, in, out, opt));
+}
+/* end strip */
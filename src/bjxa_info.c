@@ -0,0 +1,639 @@
+/*-
+ * Copyright (C) 2020  Dridi Boukelmoune
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Corpus index.
+ *
+ * Headers are parsed in parallel, workers taking the next file from a
+ * shared counter. Profile bytes are optionally scanned without decoding
+ * any sample. Results are kept in memory and printed in path order once
+ * all the workers are done.
+ *
+ * Fingerprints need a full decode of every file instead, and files are
+ * clustered once all of them are known: files with the same hash decode
+ * to the same samples, files with close prints sound alike.
+ */
+
+#include "config.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "bjxa.h"
+#include "bjxa_priv.h"
+
+#define INFO_BUFFER	(64 * 1024)
+
+struct info_file {
+	char		*path;
+	int		error;
+	bjxa_format_t	fmt;
+	uint32_t	samples;
+	uint32_t	loop;
+	int16_t		bef[4];
+	uint8_t		bits;
+	uint64_t	factors[5];
+	uint64_t	bad;
+	int64_t		first_bad;
+	bjxa_fingerprint_t	print;
+	size_t		cluster;
+};
+
+struct info {
+	const struct info_options	*opt;
+	struct info_file		*files;
+	size_t				files_len;
+	size_t				files_size;
+	size_t				next;
+	pthread_mutex_t			mtx;
+};
+
+/* file collection */
+
+static int
+info_add(struct info *inf, const char *path)
+{
+	void *ptr;
+
+	if (inf->files_len == inf->files_size) {
+		inf->files_size = inf->files_size > 0 ?
+		    inf->files_size * 2 : 64;
+		ptr = realloc(inf->files, inf->files_size * sizeof *inf->files);
+		if (ptr == NULL) {
+			perror("realloc");
+			return (-1);
+		}
+		inf->files = ptr;
+	}
+
+	memset(&inf->files[inf->files_len], 0, sizeof *inf->files);
+	inf->files[inf->files_len].path = strdup(path);
+	if (inf->files[inf->files_len].path == NULL) {
+		perror("strdup");
+		return (-1);
+	}
+
+	inf->files_len++;
+	return (0);
+}
+
+static int
+info_walk(struct info *inf, const char *dir)
+{
+	struct dirent *ent;
+	struct stat st;
+	size_t len;
+	char *path;
+	DIR *d;
+	int ret = 0;
+
+	d = opendir(dir);
+	if (d == NULL) {
+		perror(dir);
+		return (-1);
+	}
+
+	while (ret == 0 && (errno = 0, ent = readdir(d)) != NULL) {
+		if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, ".."))
+			continue;
+
+		len = strlen(dir) + strlen(ent->d_name) + 2;
+		path = malloc(len);
+		if (path == NULL) {
+			perror("malloc");
+			ret = -1;
+			break;
+		}
+		(void)snprintf(path, len, "%s%s%s", dir,
+		    dir[strlen(dir) - 1] == '/' ? "" : "/", ent->d_name);
+
+		/* symbolic links to directories are not followed */
+		len = strlen(path);
+		if (lstat(path, &st) < 0) {
+			perror(path);
+			ret = -1;
+		}
+		else if (S_ISDIR(st.st_mode))
+			ret = info_walk(inf, path);
+		else if (len > 3 && !strcasecmp(path + len - 3, ".xa"))
+			ret = info_add(inf, path);
+
+		free(path);
+	}
+
+	if (ret == 0 && errno != 0) {
+		perror(dir);
+		ret = -1;
+	}
+
+	(void)closedir(d);
+	return (ret);
+}
+
+static int
+info_list(struct info *inf, FILE *list)
+{
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+	int ret = 0;
+
+	while (ret == 0 && (len = getline(&line, &size, list)) >= 0) {
+		if (len > 0 && line[len - 1] == '\n')
+			line[--len] = '\0';
+		if (len > 0)
+			ret = info_add(inf, line);
+	}
+
+	if (ret == 0 && ferror(list)) {
+		perror("getline");
+		ret = -1;
+	}
+
+	free(line);
+	return (ret);
+}
+
+static int
+info_cmp(const void *a, const void *b)
+{
+	const struct info_file *fa = a, *fb = b;
+
+	return (strcmp(fa->path, fb->path));
+}
+
+/* scanning */
+
+static int16_t
+info_le16(const uint8_t *buf)
+{
+
+	return ((int16_t)(buf[0] | buf[1] << 8));
+}
+
+static uint32_t
+info_le32(const uint8_t *buf)
+{
+
+	return ((uint32_t)buf[0] | (uint32_t)buf[1] << 8 |
+	    (uint32_t)buf[2] << 16 | (uint32_t)buf[3] << 24);
+}
+
+static int
+info_profiles(struct info_file *inf, FILE *file, uint8_t *buf)
+{
+	const uint8_t *ptr;
+	uint32_t block, blocks, chunk, n;
+	unsigned block_size, c, factor;
+
+	/* only the first byte of every block is inspected */
+	block_size = inf->fmt.block_size_xa / inf->fmt.channels;
+	chunk = INFO_BUFFER / inf->fmt.block_size_xa;
+	inf->first_bad = -1;
+
+	for (block = 0; block < inf->fmt.blocks; block += blocks) {
+		blocks = inf->fmt.blocks - block;
+		if (blocks > chunk)
+			blocks = chunk;
+		if (fread(buf, inf->fmt.block_size_xa, blocks, file) !=
+		    blocks) {
+			errno = ferror(file) ? EIO : EPROTO;
+			return (-1);
+		}
+
+		for (n = 0, ptr = buf; n < blocks; n++) {
+			for (c = 0; c < inf->fmt.channels; c++) {
+				factor = *ptr >> 4;
+				if (factor < 5)
+					inf->factors[factor]++;
+				else if (inf->bad++ == 0)
+					inf->first_bad = block + n;
+				ptr += block_size;
+			}
+		}
+	}
+
+	return (0);
+}
+
+static int
+info_fingerprint(struct info_file *inf, FILE *file, bjxa_decoder_t *dec,
+    uint8_t *buf)
+{
+	uint32_t block, blocks, chunk;
+
+	chunk = INFO_BUFFER / inf->fmt.block_size_xa;
+
+	for (block = 0; block < inf->fmt.blocks; block += blocks) {
+		blocks = inf->fmt.blocks - block;
+		if (blocks > chunk)
+			blocks = chunk;
+		if (fread(buf, inf->fmt.block_size_xa, blocks, file) !=
+		    blocks) {
+			errno = ferror(file) ? EIO : EPROTO;
+			return (-1);
+		}
+		if (bjxa_decode_fingerprint(dec, buf,
+		    blocks * inf->fmt.block_size_xa) != (int)blocks)
+			return (-1);
+	}
+
+	return (bjxa_decoder_fingerprint(dec, &inf->print));
+}
+
+static int
+info_scan(struct info *inf, struct info_file *file, bjxa_decoder_t *dec,
+    uint8_t *buf)
+{
+	uint8_t hdr[BJXA_HEADER_SIZE_XA];
+	FILE *in;
+	int ret = 0;
+
+	in = fopen(file->path, "r");
+	if (in == NULL)
+		return (-1);
+
+	if (fread(hdr, sizeof hdr, 1, in) != 1) {
+		errno = ferror(in) ? EIO : EPROTO;
+		ret = -1;
+	}
+
+	if (ret == 0 && (bjxa_parse_header(dec, hdr, sizeof hdr) < 0 ||
+	    bjxa_decode_format(dec, &file->fmt) < 0))
+		ret = -1;
+
+	/* fields ignored by the decoder are read from the raw header */
+	if (ret == 0) {
+		file->samples = info_le32(hdr + 8);
+		file->bits = hdr[14];
+		file->loop = info_le32(hdr + 16);
+		file->bef[0] = info_le16(hdr + 20);
+		file->bef[1] = info_le16(hdr + 22);
+		file->bef[2] = info_le16(hdr + 24);
+		file->bef[3] = info_le16(hdr + 26);
+	}
+
+	if (ret == 0 && inf->opt->profiles)
+		ret = info_profiles(file, in, buf);
+
+	if (ret == 0 && inf->opt->fingerprint)
+		ret = info_fingerprint(file, in, dec, buf);
+
+	(void)fclose(in);
+	return (ret);
+}
+
+static void *
+info_work(void *priv)
+{
+	struct info *inf;
+	struct info_file *file;
+	bjxa_decoder_t *dec;
+	uint8_t *buf;
+
+	inf = priv;
+	dec = bjxa_decoder();
+	buf = malloc(INFO_BUFFER);
+
+	while (1) {
+		(void)pthread_mutex_lock(&inf->mtx);
+		file = inf->next < inf->files_len ?
+		    &inf->files[inf->next++] : NULL;
+		(void)pthread_mutex_unlock(&inf->mtx);
+
+		if (file == NULL)
+			break;
+
+		if (dec == NULL || buf == NULL)
+			file->error = ENOMEM;
+		else if (info_scan(inf, file, dec, buf) < 0)
+			file->error = errno != 0 ? errno : EIO;
+	}
+
+	if (dec != NULL)
+		(void)bjxa_free_decoder(&dec);
+	free(buf);
+	return (NULL);
+}
+
+/* output */
+
+static void
+info_csv_path(const char *path, FILE *out)
+{
+
+	if (strpbrk(path, ",\"\n") == NULL) {
+		fputs(path, out);
+		return;
+	}
+
+	fputc('"', out);
+	for (; *path != '\0'; path++) {
+		if (*path == '"')
+			fputc('"', out);
+		fputc(*path, out);
+	}
+	fputc('"', out);
+}
+
+static void
+info_csv(const struct info *inf, const struct info_file *file, FILE *out)
+{
+	unsigned n;
+
+	info_csv_path(file->path, out);
+	if (file->error != 0) {
+		fprintf(out, ",%s,,,,,,,,,,,%s\n", strerror(file->error),
+		    inf->opt->profiles ? ",,,,,,," : "");
+		return;
+	}
+
+	fprintf(out, ",,%u,%u,%u,%u,%u,%.3f,%u,%d,%d,%d,%d", file->bits,
+	    file->fmt.channels, file->fmt.samples_rate, file->samples,
+	    file->fmt.blocks, (double)file->samples / file->fmt.samples_rate,
+	    file->loop, file->bef[0], file->bef[1], file->bef[2],
+	    file->bef[3]);
+
+	if (inf->opt->profiles) {
+		for (n = 0; n < 5; n++)
+			fprintf(out, ",%ju", (uintmax_t)file->factors[n]);
+		fprintf(out, ",%ju,", (uintmax_t)file->bad);
+		if (file->first_bad >= 0)
+			fprintf(out, "%jd", (intmax_t)file->first_bad);
+	}
+
+	fputc('\n', out);
+}
+
+static void
+info_json_string(const char *str, FILE *out)
+{
+
+	fputc('"', out);
+	for (; *str != '\0'; str++) {
+		if (*str == '"' || *str == '\\')
+			fprintf(out, "\\%c", *str);
+		else if ((unsigned char)*str < 0x20)
+			fprintf(out, "\\u%04x", (unsigned char)*str);
+		else
+			fputc(*str, out);
+	}
+	fputc('"', out);
+}
+
+static void
+info_json(const struct info *inf, const struct info_file *file, FILE *out)
+{
+	unsigned n;
+
+	fputs("  {\"path\": ", out);
+	info_json_string(file->path, out);
+	if (file->error != 0) {
+		fputs(", \"error\": ", out);
+		info_json_string(strerror(file->error), out);
+		fputs("}", out);
+		return;
+	}
+
+	fprintf(out, ", \"bits\": %u, \"channels\": %u, \"samples_rate\": %u"
+	    ", \"samples\": %u, \"blocks\": %u, \"duration\": %.3f"
+	    ", \"loop\": %u, \"befL\": [%d, %d], \"befR\": [%d, %d]",
+	    file->bits, file->fmt.channels, file->fmt.samples_rate,
+	    file->samples, file->fmt.blocks,
+	    (double)file->samples / file->fmt.samples_rate, file->loop,
+	    file->bef[0], file->bef[1], file->bef[2], file->bef[3]);
+
+	if (inf->opt->profiles) {
+		fputs(", \"factors\": [", out);
+		for (n = 0; n < 5; n++)
+			fprintf(out, "%s%ju", n > 0 ? ", " : "",
+			    (uintmax_t)file->factors[n]);
+		fprintf(out, "], \"bad_profiles\": %ju",
+		    (uintmax_t)file->bad);
+		if (file->first_bad >= 0)
+			fprintf(out, ", \"first_bad_block\": %jd",
+			    (intmax_t)file->first_bad);
+	}
+
+	fputs("}", out);
+}
+
+static unsigned
+info_distance(uint64_t a, uint64_t b)
+{
+	uint64_t bits;
+	unsigned n;
+
+	for (n = 0, bits = a ^ b; bits != 0; n++)
+		bits &= bits - 1;
+	return (n);
+}
+
+static int
+info_same(const struct info *inf, const struct info_file *a,
+    const struct info_file *b)
+{
+
+	if (a->error != 0 || b->error != 0)
+		return (0);
+	if (a->print.hash == b->print.hash &&
+	    a->print.samples == b->print.samples)
+		return (1);
+
+	/* silence and files shorter than a window have no usable print */
+	return (a->print.windows > 0 && b->print.windows > 0 &&
+	    info_distance(a->print.print, b->print.print) <=
+	    inf->opt->distance);
+}
+
+static size_t
+info_root(struct info *inf, size_t n)
+{
+
+	while (inf->files[n].cluster != n)
+		n = inf->files[n].cluster;
+	return (n);
+}
+
+static int
+info_clusters(struct info *inf, FILE *out)
+{
+	const struct info_file *file;
+	size_t a, b, ra, rb;
+	int ret = 0;
+
+	/* clusters are named after their first file in path order */
+	for (a = 0; a < inf->files_len; a++)
+		inf->files[a].cluster = a;
+	for (a = 0; a < inf->files_len; a++) {
+		for (b = a + 1; b < inf->files_len; b++) {
+			if (!info_same(inf, &inf->files[a], &inf->files[b]))
+				continue;
+			ra = info_root(inf, a);
+			rb = info_root(inf, b);
+			if (ra < rb)
+				inf->files[rb].cluster = ra;
+			else
+				inf->files[ra].cluster = rb;
+		}
+	}
+
+	fputs("path,error,samples,hash,fingerprint,duplicate\n", out);
+	for (a = 0; a < inf->files_len; a++) {
+		file = &inf->files[a];
+		info_csv_path(file->path, out);
+		if (file->error != 0) {
+			fprintf(out, ",%s,,,,\n", strerror(file->error));
+			ret = -1;
+			continue;
+		}
+		fprintf(out, ",,%ju,%016jx,%016jx,",
+		    (uintmax_t)file->print.samples,
+		    (uintmax_t)file->print.hash,
+		    (uintmax_t)file->print.print);
+		ra = info_root(inf, a);
+		if (ra != a)
+			info_csv_path(inf->files[ra].path, out);
+		fputc('\n', out);
+	}
+
+	return (ret);
+}
+
+static int
+info_print(const struct info *inf, FILE *out)
+{
+	const struct info_file *file;
+	size_t n;
+	int ret = 0;
+
+	if (inf->opt->json)
+		fputs("[\n", out);
+	else {
+		fputs("path,error,bits,channels,samples_rate,samples,blocks,"
+		    "duration,loop,befL0,befL1,befR0,befR1", out);
+		if (inf->opt->profiles)
+			fputs(",factor0,factor1,factor2,factor3,factor4,"
+			    "bad_profiles,first_bad_block", out);
+		fputc('\n', out);
+	}
+
+	for (n = 0; n < inf->files_len; n++) {
+		file = &inf->files[n];
+		if (inf->opt->json) {
+			info_json(inf, file, out);
+			fputs(n + 1 < inf->files_len ? ",\n" : "\n", out);
+		}
+		else
+			info_csv(inf, file, out);
+		if (file->error != 0 || file->bad > 0)
+			ret = -1;
+	}
+
+	if (inf->opt->json)
+		fputs("]\n", out);
+
+	return (ret);
+}
+
+static int
+info_run(struct info *inf, FILE *out)
+{
+	pthread_t *threads;
+	unsigned n, workers, started;
+
+	workers = inf->opt->jobs;
+	if (workers > inf->files_len)
+		workers = (unsigned)inf->files_len;
+	if (workers == 0)
+		workers = 1;
+
+	threads = calloc(workers, sizeof *threads);
+	if (threads == NULL) {
+		perror("calloc");
+		return (-1);
+	}
+
+	started = 0;
+	for (n = 0; n < workers; n++) {
+		errno = pthread_create(&threads[n], NULL, info_work, inf);
+		if (errno != 0) {
+			perror("pthread_create");
+			break;
+		}
+		started++;
+	}
+
+	/* without any thread, the files are scanned here */
+	if (started == 0)
+		(void)info_work(inf);
+	for (n = 0; n < started; n++)
+		(void)pthread_join(threads[n], NULL);
+	free(threads);
+
+	if (inf->opt->fingerprint)
+		return (info_clusters(inf, out));
+	return (info_print(inf, out));
+}
+
+int
+info(int argc, char * const *argv, FILE *out, const struct info_options *opt)
+{
+	struct info inf;
+	struct stat st;
+	size_t n;
+	int ret = 0;
+
+	memset(&inf, 0, sizeof inf);
+	inf.opt = opt;
+
+	for (; ret == 0 && argc > 0; argc--, argv++) {
+		if (!strcmp(*argv, "-"))
+			ret = info_list(&inf, stdin);
+		else if (stat(*argv, &st) == 0 && S_ISDIR(st.st_mode))
+			ret = info_walk(&inf, *argv);
+		else
+			ret = info_add(&inf, *argv);
+	}
+
+	if (ret == 0 && inf.files_len > 0)
+		qsort(inf.files, inf.files_len, sizeof *inf.files, info_cmp);
+
+	if (ret == 0 && pthread_mutex_init(&inf.mtx, NULL) != 0) {
+		perror("pthread_mutex_init");
+		ret = -1;
+	}
+
+	if (ret == 0) {
+		ret = info_run(&inf, out);
+		(void)pthread_mutex_destroy(&inf.mtx);
+	}
+
+	for (n = 0; n < inf.files_len; n++)
+		free(inf.files[n].path);
+	free(inf.files);
+	return (ret);
+}
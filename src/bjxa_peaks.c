@@ -0,0 +1,200 @@
+/*-
+ * Copyright (C) 2020  Dridi Boukelmoune
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Waveform overview.
+ *
+ * The XA stream is decoded a few blocks at a time straight into per-window
+ * summaries, so peaks files are produced in constant memory. The number of
+ * windows is known from the XA header and written first.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bjxa.h"
+#include "bjxa_priv.h"
+
+#define PEAKS_BLOCKS		64
+#define PEAKS_HEADER		20
+#define PEAKS_ENTRY		6
+
+static void
+peaks_le16(uint8_t **bufp, uint16_t val)
+{
+	uint8_t *buf;
+
+	buf = *bufp;
+	buf[0] = (uint8_t)val;
+	buf[1] = (uint8_t)(val >> 8);
+	*bufp = buf + 2;
+}
+
+static void
+peaks_le32(uint8_t **bufp, uint32_t val)
+{
+
+	peaks_le16(bufp, (uint16_t)val);
+	peaks_le16(bufp, (uint16_t)(val >> 16));
+}
+
+static int
+peaks_header(bjxa_decoder_t *dec, FILE *in, FILE *out, bjxa_format_t *fmt,
+    uint32_t window)
+{
+	uint8_t hdr[PEAKS_HEADER], *buf;
+	uint32_t samples;
+
+	if (bjxa_fread_header(dec, in) < 0) {
+		perror("bjxa_fread_header");
+		return (-1);
+	}
+
+	if (bjxa_decode_format(dec, fmt) < 0) {
+		perror("bjxa_decode_format");
+		return (-1);
+	}
+
+	if (bjxa_decode_window(dec, window) < 0) {
+		perror("bjxa_decode_window");
+		return (-1);
+	}
+
+	samples = fmt->data_len_pcm / (fmt->channels * sizeof(int16_t));
+
+	buf = hdr;
+	peaks_le32(&buf, 0x50584a42); /* BJXP */
+	peaks_le32(&buf, 1);
+	peaks_le32(&buf, samples / window + (samples % window != 0));
+	peaks_le32(&buf, window);
+	peaks_le16(&buf, fmt->samples_rate);
+	*buf++ = fmt->channels;
+	*buf++ = 0;
+
+	if (fwrite(hdr, sizeof hdr, 1, out) != 1) {
+		perror("fwrite");
+		return (-1);
+	}
+
+	return (0);
+}
+
+static int
+peaks_write(const bjxa_peak_t *peaks, size_t len, uint8_t *buf, FILE *out)
+{
+	uint8_t *ptr;
+	size_t n;
+
+	ptr = buf;
+	for (n = 0; n < len; n++) {
+		peaks_le16(&ptr, (uint16_t)peaks[n].min);
+		peaks_le16(&ptr, (uint16_t)peaks[n].max);
+		peaks_le16(&ptr, peaks[n].rms);
+	}
+
+	if (len > 0 && fwrite(buf, len * PEAKS_ENTRY, 1, out) != 1) {
+		perror("fwrite");
+		return (-1);
+	}
+
+	return (0);
+}
+
+static int
+peaks_loop(bjxa_decoder_t *dec, FILE *in, FILE *out, const bjxa_format_t *fmt,
+    bjxa_peak_t *peaks, size_t peaks_len, uint8_t *buf)
+{
+	uint8_t buf_xa[PEAKS_BLOCKS * BLOCK_SIZE_XA];
+	uint32_t blocks, count;
+	ssize_t len;
+
+	blocks = fmt->blocks;
+	while (blocks > 0) {
+		count = blocks < PEAKS_BLOCKS ? blocks : PEAKS_BLOCKS;
+		if (fread(buf_xa, fmt->block_size_xa, count, in) != count) {
+			if (feof(in))
+				fprintf(stderr, "fread: End of file\n");
+			else
+				perror("fread");
+			return (-1);
+		}
+
+		len = bjxa_decode_peaks(dec, peaks, peaks_len, buf_xa,
+		    (size_t)fmt->block_size_xa * count);
+		if (len < 0) {
+			perror("bjxa_decode_peaks");
+			return (-1);
+		}
+
+		if (peaks_write(peaks, (size_t)len, buf, out) < 0)
+			return (-1);
+		blocks -= count;
+	}
+
+	return (0);
+}
+
+int
+peaks(FILE *in, FILE *out, const struct peaks_options *opt)
+{
+	bjxa_decoder_t *dec;
+	bjxa_format_t fmt;
+	bjxa_peak_t *buf_peaks;
+	uint8_t *buf;
+	size_t len;
+	int status = 0;
+
+	dec = bjxa_decoder();
+	if (dec == NULL) {
+		perror("bjxa_decoder");
+		return (-1);
+	}
+
+	if (peaks_header(dec, in, out, &fmt, opt->window) < 0) {
+		(void)bjxa_free_decoder(&dec);
+		return (-1);
+	}
+
+	/* enough room for the windows completed by one batch of blocks */
+	len = fmt.channels *
+	    (PEAKS_BLOCKS * BLOCK_SAMPLES / opt->window + 2);
+	buf_peaks = calloc(len, sizeof *buf_peaks);
+	buf = malloc(len * PEAKS_ENTRY);
+
+	if (buf_peaks == NULL || buf == NULL) {
+		perror("malloc");
+		status = -1;
+	}
+
+	if (status == 0 &&
+	    peaks_loop(dec, in, out, &fmt, buf_peaks, len, buf) < 0)
+		status = -1;
+
+	free(buf_peaks);
+	free(buf);
+
+	if (bjxa_free_decoder(&dec) < 0) {
+		perror("bjxa_free_decoder");
+		status = -1;
+	}
+
+	return (status);
+}
@@ -19,5 +19,77 @@
 #  define noreturn __attribute__((__noreturn__))
 #endif
 
-int decode(FILE *, FILE *);
-int encode(FILE *, FILE *, unsigned);
+/* XA block geometry, the largest blocks being 8 bits stereo */
+#define BLOCK_SAMPLES	32
+#define BLOCK_SIZE_XA	(2 * 33)
+
+struct decode_options {
+	unsigned	stats;
+	unsigned	mix;
+};
+
+struct encode_options {
+	unsigned	bits;
+	unsigned	dither;
+	const char	*cache;
+	uint64_t	cache_size;
+	unsigned	trim;
+};
+
+struct compare_options {
+	uint32_t	worst;
+};
+
+struct batch_options {
+	unsigned		encode;
+	unsigned		jobs;
+	unsigned		uring;
+	const char		*output;
+	struct encode_options	enc;
+};
+
+struct info_options {
+	unsigned	jobs;
+	unsigned	profiles;
+	unsigned	json;
+	unsigned	fingerprint;
+	uint32_t	distance;
+};
+
+struct cut_options {
+	uint32_t	from;
+	uint32_t	to;
+};
+
+struct transcode_options {
+	unsigned		jobs;
+	struct encode_options	enc;
+};
+
+struct peaks_options {
+	uint32_t	window;
+};
+
+int decode(FILE *, FILE *, const struct decode_options *);
+int encode(FILE *, FILE *, const struct encode_options *);
+int compare(FILE *, FILE *, FILE *, const struct compare_options *);
+int batch(const char *, FILE *, const struct batch_options *);
+int pack(const char *, int, char * const *);
+int unpack(const char *, const char *, unsigned);
+int info(int, char * const *, FILE *, const struct info_options *);
+int verify(int, char * const *, FILE *);
+int cut(FILE *, FILE *, const struct cut_options *);
+int concat(const char *, int, char * const *);
+int transcode(FILE *, FILE *, const struct transcode_options *);
+int update(FILE *, FILE *, FILE *, FILE *);
+int peaks(FILE *, FILE *, const struct peaks_options *);
+
+int safe_path(const char *);
+int mkdirs(const char *);
+void *read_all(int, size_t *);
+
+int decode_batch(bjxa_decoder_t *, FILE *, FILE *);
+int encode_batch(bjxa_encoder_t *, FILE *, FILE *,
+    const struct encode_options *);
+int encode_cache(FILE *, FILE *, const struct encode_options *);
+int cache_prune(const char *, uint64_t);
@@ -0,0 +1,373 @@
+/*-
+ * Copyright (C) 2020  Dridi Boukelmoune
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * XA to XA transcoding.
+ *
+ * A single job streams the XA blocks through fixed-size buffers, decoded
+ * and encoded again without a complete PCM stream. With more jobs the XA
+ * stream is read in memory and split at sync blocks, each segment being
+ * transcoded by its own thread with a decoder and an encoder. Segments
+ * start with a sync block in the output too, so they don't depend on the
+ * encoder state at the end of the previous segment.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bjxa.h"
+#include "bjxa_priv.h"
+
+#define TRANSCODE_BLOCKS	64
+
+struct transcode_segment {
+	const struct transcode_options	*opt;
+	const uint8_t			*src;
+	size_t				src_len;
+	uint8_t				*dst;
+	uint32_t			first;
+	uint32_t			blocks;
+	pthread_t			thread;
+	int				status;
+};
+
+static int
+transcode_init(bjxa_encoder_t *enc, bjxa_format_t *fmt,
+    const struct encode_options *opt)
+{
+
+	if (bjxa_encode_init(enc, fmt, (uint8_t)opt->bits) < 0) {
+		perror("bjxa_encode_init");
+		return (-1);
+	}
+
+	return (0);
+}
+
+static int
+transcode_loop(bjxa_decoder_t *dec, bjxa_encoder_t *enc, FILE *in, FILE *out,
+    const struct transcode_options *opt)
+{
+	bjxa_format_t fmt_in, fmt_out;
+	uint8_t *buf_in, *buf_out;
+	uint32_t blocks;
+	int ret = 0;
+
+	if (bjxa_fread_header(dec, in) < 0) {
+		perror("bjxa_fread_header");
+		return (-1);
+	}
+
+	if (bjxa_decode_format(dec, &fmt_in) < 0) {
+		perror("bjxa_decode_format");
+		return (-1);
+	}
+
+	fmt_out = fmt_in;
+	if (transcode_init(enc, &fmt_out, &opt->enc) < 0)
+		return (-1);
+
+	if (bjxa_fwrite_header(enc, out) < 0) {
+		perror("bjxa_fwrite_header");
+		return (-1);
+	}
+
+	/* allocate space for a fixed number of blocks */
+	buf_in = malloc((size_t)TRANSCODE_BLOCKS * fmt_in.block_size_xa);
+	buf_out = malloc((size_t)TRANSCODE_BLOCKS * fmt_out.block_size_xa);
+
+	if (buf_in == NULL || buf_out == NULL) {
+		perror("malloc");
+		ret = -1;
+	}
+
+	while (fmt_in.blocks > 0 && ret == 0) {
+		blocks = fmt_in.blocks;
+		if (blocks > TRANSCODE_BLOCKS)
+			blocks = TRANSCODE_BLOCKS;
+
+		if (fread(buf_in, fmt_in.block_size_xa, blocks, in) != blocks) {
+			if (feof(in))
+				fprintf(stderr, "fread: End of file\n");
+			else
+				perror("fread");
+			ret = -1;
+			break;
+		}
+
+		if (bjxa_transcode(dec, enc, buf_out,
+		    (size_t)blocks * fmt_out.block_size_xa, buf_in,
+		    (size_t)blocks * fmt_in.block_size_xa) != (int)blocks) {
+			perror("bjxa_transcode");
+			ret = -1;
+			break;
+		}
+
+		if (fwrite(buf_out, fmt_out.block_size_xa, blocks, out) !=
+		    blocks) {
+			perror("fwrite");
+			ret = -1;
+			break;
+		}
+
+		fmt_in.blocks -= blocks;
+	}
+
+	free(buf_in);
+	free(buf_out);
+	return (ret);
+}
+
+static int
+transcode_segment(struct transcode_segment *seg, bjxa_decoder_t *dec,
+    bjxa_encoder_t *enc)
+{
+	struct encode_options opt;
+	bjxa_format_t fmt, seg_fmt;
+	uint32_t last, data_len_pcm;
+
+	if (bjxa_parse_header(dec, seg->src, seg->src_len) < 0 ||
+	    bjxa_decode_format(dec, &fmt) < 0 ||
+	    bjxa_decode_seek(dec, seg->first) < 0) {
+		perror("bjxa_decode_seek");
+		return (-1);
+	}
+
+	/* the last segment may end with a truncated block */
+	last = seg->first + seg->blocks;
+	data_len_pcm = seg->blocks * fmt.block_size_pcm;
+	if (last == fmt.blocks)
+		data_len_pcm = fmt.data_len_pcm -
+		    seg->first * fmt.block_size_pcm;
+
+	seg_fmt = fmt;
+	seg_fmt.data_len_pcm = data_len_pcm;
+
+	opt = seg->opt->enc;
+	if (transcode_init(enc, &seg_fmt, &opt) < 0)
+		return (-1);
+
+	if (bjxa_transcode(dec, enc, seg->dst + BJXA_HEADER_SIZE_XA +
+	    (size_t)seg->first * seg_fmt.block_size_xa,
+	    (size_t)seg->blocks * seg_fmt.block_size_xa,
+	    seg->src + BJXA_HEADER_SIZE_XA +
+	    (size_t)seg->first * fmt.block_size_xa,
+	    (size_t)seg->blocks * fmt.block_size_xa) != (int)seg->blocks) {
+		perror("bjxa_transcode");
+		return (-1);
+	}
+
+	return (0);
+}
+
+static void *
+transcode_work(void *priv)
+{
+	struct transcode_segment *seg;
+	bjxa_decoder_t *dec;
+	bjxa_encoder_t *enc;
+
+	seg = priv;
+	dec = bjxa_decoder();
+	enc = bjxa_encoder();
+
+	if (dec == NULL || enc == NULL) {
+		perror("transcode");
+		seg->status = -1;
+	}
+	else
+		seg->status = transcode_segment(seg, dec, enc);
+
+	if (dec != NULL)
+		(void)bjxa_free_decoder(&dec);
+	if (enc != NULL)
+		(void)bjxa_free_encoder(&enc);
+	return (NULL);
+}
+
+static unsigned
+transcode_split(bjxa_decoder_t *dec, const uint8_t *xa,
+    const bjxa_format_t *fmt, struct transcode_segment *seg, unsigned jobs)
+{
+	uint32_t block, prev;
+	unsigned n, segs;
+	int skip;
+
+	/* segments start with a sync block from the input stream, as the
+	 * decoder state is irrelevant there.
+	 */
+	segs = 0;
+	prev = 0;
+	for (n = 1; n <= jobs; n++) {
+		block = fmt->blocks;
+		if (n < jobs) {
+			block = (uint32_t)((uint64_t)fmt->blocks * n / jobs);
+			if (block < prev)
+				block = prev;
+			skip = 0;
+			if (block < fmt->blocks)
+				skip = bjxa_decode_sync(dec, xa +
+				    (size_t)block * fmt->block_size_xa,
+				    (size_t)(fmt->blocks - block) *
+				    fmt->block_size_xa);
+			if (skip > 0)
+				block += (uint32_t)skip;
+		}
+		if (block == prev)
+			continue;
+		seg[segs].first = prev;
+		seg[segs].blocks = block - prev;
+		segs++;
+		prev = block;
+	}
+
+	return (segs);
+}
+
+static int
+transcode_parallel(bjxa_decoder_t *dec, bjxa_encoder_t *enc, FILE *in,
+    FILE *out, const struct transcode_options *opt)
+{
+	struct transcode_segment *seg;
+	bjxa_format_t fmt, fmt_out;
+	uint8_t *src, *dst;
+	size_t src_len, dst_len;
+	unsigned n, segs;
+	int ret = 0;
+
+	src = read_all(fileno(in), &src_len);
+	if (src == NULL) {
+		perror("read");
+		return (-1);
+	}
+
+	if (bjxa_parse_header(dec, src, src_len) < 0 ||
+	    bjxa_decode_format(dec, &fmt) < 0) {
+		perror("bjxa_parse_header");
+		free(src);
+		return (-1);
+	}
+
+	if (src_len - BJXA_HEADER_SIZE_XA <
+	    (size_t)fmt.blocks * fmt.block_size_xa) {
+		fprintf(stderr, "transcode: truncated XA stream\n");
+		free(src);
+		return (-1);
+	}
+
+	fmt_out = fmt;
+	if (transcode_init(enc, &fmt_out, &opt->enc) < 0) {
+		free(src);
+		return (-1);
+	}
+
+	dst_len = BJXA_HEADER_SIZE_XA +
+	    (size_t)fmt_out.blocks * fmt_out.block_size_xa;
+	dst = malloc(dst_len);
+	seg = calloc(opt->jobs, sizeof *seg);
+
+	if (dst == NULL || seg == NULL) {
+		perror("malloc");
+		ret = -1;
+	}
+
+	if (ret == 0 && bjxa_dump_header(enc, dst, dst_len) < 0) {
+		perror("bjxa_dump_header");
+		ret = -1;
+	}
+
+	segs = 0;
+	if (ret == 0)
+		segs = transcode_split(dec, src + BJXA_HEADER_SIZE_XA, &fmt,
+		    seg, opt->jobs);
+
+	for (n = 0; n < segs; n++) {
+		seg[n].opt = opt;
+		seg[n].src = src;
+		seg[n].src_len = src_len;
+		seg[n].dst = dst;
+		errno = pthread_create(&seg[n].thread, NULL, transcode_work,
+		    seg + n);
+		if (errno != 0) {
+			perror("pthread_create");
+			ret = -1;
+			segs = n;
+		}
+	}
+
+	for (n = 0; n < segs; n++) {
+		(void)pthread_join(seg[n].thread, NULL);
+		if (seg[n].status < 0)
+			ret = -1;
+	}
+
+	if (ret == 0 && (fwrite(dst, dst_len, 1, out) != 1 ||
+	    fflush(out) != 0)) {
+		perror("fwrite");
+		ret = -1;
+	}
+
+	free(seg);
+	free(dst);
+	free(src);
+	return (ret);
+}
+
+int
+transcode(FILE *in, FILE *out, const struct transcode_options *opt)
+{
+	bjxa_decoder_t *dec;
+	bjxa_encoder_t *enc;
+	int status;
+
+	dec = bjxa_decoder();
+	if (dec == NULL) {
+		perror("bjxa_decoder");
+		return (-1);
+	}
+
+	enc = bjxa_encoder();
+	if (enc == NULL) {
+		perror("bjxa_encoder");
+		(void)bjxa_free_decoder(&dec);
+		return (-1);
+	}
+
+	if (opt->jobs > 1)
+		status = transcode_parallel(dec, enc, in, out, opt);
+	else
+		status = transcode_loop(dec, enc, in, out, opt);
+
+	if (bjxa_free_decoder(&dec) < 0) {
+		perror("bjxa_free_decoder");
+		status = -1;
+	}
+
+	if (bjxa_free_encoder(&enc) < 0) {
+		perror("bjxa_free_encoder");
+		status = -1;
+	}
+
+	return (status);
+}
@@ -0,0 +1,283 @@
+/*-
+ * Copyright (C) 2020  Dridi Boukelmoune
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Incremental encoding.
+ *
+ * The previous WAV file, the previous XA file and the new WAV file are
+ * read in lockstep one block at a time. Blocks with the same samples in
+ * both WAV files are copied from the previous XA file, the others are
+ * encoded again. After a change, blocks keep being encoded until one of
+ * them is identical to the previous XA block and doesn't depend on the
+ * predictor state, so the copied blocks decode to the same samples.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bjxa.h"
+#include "bjxa_priv.h"
+
+struct update_state {
+	bjxa_format_t	old_wav;
+	bjxa_format_t	old_xa;
+	bjxa_format_t	new_wav;
+	bjxa_format_t	new_xa;
+	uint8_t		*old_pcm;
+	uint8_t		*new_pcm;
+	uint8_t		*old_block;
+	uint8_t		*new_block;
+	uint32_t	src_block;
+};
+
+static int
+update_read(void *buf, size_t len, FILE *file)
+{
+
+	if (fread(buf, len, 1, file) == 1)
+		return (0);
+	if (feof(file))
+		fprintf(stderr, "fread: End of file\n");
+	else
+		perror("fread");
+	return (-1);
+}
+
+static int
+update_header(bjxa_decoder_t *dec, bjxa_encoder_t *enc, FILE *old_wav,
+    FILE *old_xa, FILE *in, struct update_state *us)
+{
+	uint32_t samples;
+	unsigned bits;
+
+	if (bjxa_fread_riff_header(&us->old_wav, old_wav) < 0 ||
+	    bjxa_fread_riff_header(&us->new_wav, in) < 0) {
+		perror("bjxa_fread_riff_header");
+		return (-1);
+	}
+
+	if (bjxa_fread_header(dec, old_xa) < 0) {
+		perror("bjxa_fread_header");
+		return (-1);
+	}
+
+	if (bjxa_decode_format(dec, &us->old_xa) < 0) {
+		perror("bjxa_decode_format");
+		return (-1);
+	}
+
+	if (us->old_wav.data_len_pcm == 0 || us->new_wav.data_len_pcm == 0) {
+		fprintf(stderr, "update: WAV length unknown\n");
+		return (-1);
+	}
+
+	if (us->old_wav.sample_bits != us->new_wav.sample_bits ||
+	    us->old_wav.channels != us->new_wav.channels ||
+	    us->old_wav.samples_rate != us->new_wav.samples_rate) {
+		fprintf(stderr, "update: format mismatch\n");
+		return (-1);
+	}
+
+	/* the previous XA file must have been encoded from the previous
+	 * WAV file, at least it must have the same samples count.
+	 */
+	samples = us->old_wav.data_len_pcm / (us->old_wav.sample_bits / 8);
+	if (us->old_xa.channels != us->old_wav.channels ||
+	    us->old_xa.samples_rate != us->old_wav.samples_rate ||
+	    us->old_xa.data_len_pcm / sizeof(int16_t) != samples) {
+		fprintf(stderr, "update: previous files mismatch\n");
+		return (-1);
+	}
+
+	bits = (us->old_xa.block_size_xa / us->old_xa.channels - 1) / 4;
+	us->new_xa = us->new_wav;
+	if (bjxa_encode_init(enc, &us->new_xa, (uint8_t)bits) < 0) {
+		perror("bjxa_encode_init");
+		return (-1);
+	}
+
+	us->src_block = us->new_xa.block_size_pcm * us->new_wav.sample_bits /
+	    16;
+	return (0);
+}
+
+static int
+update_block(bjxa_decoder_t *dec, bjxa_encoder_t *enc,
+    struct update_state *us, uint32_t index, unsigned *dirty, unsigned seek)
+{
+	unsigned block_size;
+
+	block_size = us->new_xa.block_size_xa;
+
+	/* the encoder only moves to the first block of a changed run, the
+	 * following blocks continue its predictor state. A seek resets the
+	 * state to zero and not to the state of the previous XA file at
+	 * that point, the two only match after a sync block.
+	 */
+	if (seek && bjxa_encode_seek(enc, index) < 0) {
+		perror("bjxa_encode_seek");
+		return (-1);
+	}
+
+	if (bjxa_encode(enc, us->new_block, block_size, us->new_pcm,
+	    us->src_block) != 1) {
+		perror("bjxa_encode");
+		return (-1);
+	}
+
+	/* a sync block identical to the previous one resets the predictor
+	 * state to what it was in the previous XA file.
+	 */
+	*dirty = 1;
+	if (index < us->old_xa.blocks &&
+	    !memcmp(us->old_block, us->new_block, block_size) &&
+	    bjxa_decode_sync(dec, us->old_block, block_size) == 0)
+		*dirty = 0;
+
+	return (0);
+}
+
+static int
+update_loop(bjxa_decoder_t *dec, bjxa_encoder_t *enc, FILE *old_wav,
+    FILE *old_xa, FILE *in, FILE *out, struct update_state *us)
+{
+	uint32_t index, old_len, new_len, old_left, new_left;
+	unsigned dirty, same, copied;
+	uint8_t *block;
+
+	old_left = us->old_wav.data_len_pcm;
+	new_left = us->new_wav.data_len_pcm;
+	dirty = 0;
+	copied = 1;
+
+	for (index = 0; index < us->new_xa.blocks; index++) {
+		new_len = us->src_block;
+		if (new_len > new_left)
+			new_len = new_left;
+		if (update_read(us->new_pcm, new_len, in) < 0)
+			return (-1);
+		new_left -= new_len;
+
+		same = 0;
+		if (index < us->old_xa.blocks) {
+			old_len = us->src_block;
+			if (old_len > old_left)
+				old_len = old_left;
+			if (update_read(us->old_pcm, old_len, old_wav) < 0 ||
+			    update_read(us->old_block,
+			    us->old_xa.block_size_xa, old_xa) < 0)
+				return (-1);
+			old_left -= old_len;
+			same = (old_len == new_len &&
+			    !memcmp(us->old_pcm, us->new_pcm, new_len));
+		}
+
+		block = us->old_block;
+		if (!same || dirty) {
+			if (update_block(dec, enc, us, index, &dirty,
+			    copied) < 0)
+				return (-1);
+			block = us->new_block;
+		}
+		copied = (block == us->old_block);
+
+		if (fwrite(block, us->new_xa.block_size_xa, 1, out) != 1) {
+			perror("fwrite");
+			return (-1);
+		}
+	}
+
+	return (0);
+}
+
+static int
+update_files(bjxa_decoder_t *dec, bjxa_encoder_t *enc, FILE *old_wav,
+    FILE *old_xa, FILE *in, FILE *out)
+{
+	struct update_state us;
+	int ret = 0;
+
+	memset(&us, 0, sizeof us);
+	if (update_header(dec, enc, old_wav, old_xa, in, &us) < 0)
+		return (-1);
+
+	if (bjxa_fwrite_header(enc, out) < 0) {
+		perror("bjxa_fwrite_header");
+		return (-1);
+	}
+
+	/* allocate space for exactly one block of each file */
+	us.old_pcm = malloc(us.src_block);
+	us.new_pcm = malloc(us.src_block);
+	us.old_block = malloc(us.new_xa.block_size_xa);
+	us.new_block = malloc(us.new_xa.block_size_xa);
+
+	if (us.old_pcm == NULL || us.new_pcm == NULL ||
+	    us.old_block == NULL || us.new_block == NULL) {
+		perror("malloc");
+		ret = -1;
+	}
+
+	if (ret == 0)
+		ret = update_loop(dec, enc, old_wav, old_xa, in, out, &us);
+
+	free(us.old_pcm);
+	free(us.new_pcm);
+	free(us.old_block);
+	free(us.new_block);
+	return (ret);
+}
+
+int
+update(FILE *old_wav, FILE *old_xa, FILE *in, FILE *out)
+{
+	bjxa_decoder_t *dec;
+	bjxa_encoder_t *enc;
+	int status = 0;
+
+	dec = bjxa_decoder();
+	if (dec == NULL) {
+		perror("bjxa_decoder");
+		return (-1);
+	}
+
+	enc = bjxa_encoder();
+	if (enc == NULL) {
+		perror("bjxa_encoder");
+		(void)bjxa_free_decoder(&dec);
+		return (-1);
+	}
+
+	if (update_files(dec, enc, old_wav, old_xa, in, out) < 0)
+		status = -1;
+
+	if (bjxa_free_decoder(&dec) < 0) {
+		perror("bjxa_free_decoder");
+		status = -1;
+	}
+
+	if (bjxa_free_encoder(&enc) < 0) {
+		perror("bjxa_free_encoder");
+		status = -1;
+	}
+
+	return (status);
+}
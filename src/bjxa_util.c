@@ -0,0 +1,116 @@
+/*-
+ * Copyright (C) 2020  Dridi Boukelmoune
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Shared helpers.
+ *
+ * File system and I/O helpers used by more than one action.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "bjxa.h"
+#include "bjxa_priv.h"
+
+#define UTIL_BUFFER	(64 * 1024)
+
+int
+safe_path(const char *name)
+{
+	const char *sep;
+
+	/* never write outside of the target directory */
+	if (*name == '\0' || *name == '/')
+		return (-1);
+
+	while (name != NULL) {
+		if (!strncmp(name, "..", 2) && (name[2] == '/' ||
+		    name[2] == '\0'))
+			return (-1);
+		sep = strchr(name, '/');
+		name = sep != NULL ? sep + 1 : NULL;
+	}
+
+	return (0);
+}
+
+int
+mkdirs(const char *path)
+{
+	char *dir, *sep;
+	int ret = 0;
+
+	dir = strdup(path);
+	if (dir == NULL)
+		return (-1);
+
+	/* create every parent, another worker may have created them */
+	for (sep = strchr(dir + 1, '/'); ret == 0 && sep != NULL;
+	    sep = strchr(sep + 1, '/')) {
+		*sep = '\0';
+		if (mkdir(dir, 0777) < 0 && errno != EEXIST)
+			ret = -1;
+		*sep = '/';
+	}
+
+	free(dir);
+	return (ret);
+}
+
+void *
+read_all(int fd, size_t *lenp)
+{
+	uint8_t *buf, *tmp;
+	size_t len, size;
+	ssize_t res;
+
+	buf = NULL;
+	len = 0;
+	size = 0;
+
+	do {
+		if (len == size) {
+			size += UTIL_BUFFER;
+			tmp = realloc(buf, size);
+			if (tmp == NULL) {
+				free(buf);
+				return (NULL);
+			}
+			buf = tmp;
+		}
+		res = read(fd, buf + len, size - len);
+		if (res < 0 && errno == EINTR)
+			continue;
+		if (res < 0) {
+			free(buf);
+			return (NULL);
+		}
+		len += (size_t)res;
+	} while (res > 0);
+
+	*lenp = len;
+	return (buf);
+}
@@ -0,0 +1,136 @@
+/*-
+ * Copyright (C) 2020  Dridi Boukelmoune
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Stream validation.
+ *
+ * Regular files are mapped in memory and checked in place by the library,
+ * without any PCM output. Other files, like the standard input, are read
+ * in memory first.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "bjxa.h"
+#include "bjxa_priv.h"
+
+static void
+verify_report(bjxa_decoder_t *dec, const char *path, size_t off, int err,
+    FILE *out)
+{
+	bjxa_format_t fmt;
+
+	if (err == 0) {
+		fprintf(out, "%s: ok\n", path);
+		return;
+	}
+
+	if (off == 0 || bjxa_decode_format(dec, &fmt) < 0) {
+		fprintf(out, "%s: %s\n", path, strerror(err));
+		return;
+	}
+
+	fprintf(out, "%s: %s at offset %zu (block %zu)\n", path,
+	    strerror(err), off,
+	    (off - BJXA_HEADER_SIZE_XA) / fmt.block_size_xa);
+}
+
+static int
+verify_file(bjxa_decoder_t *dec, const char *path, FILE *out)
+{
+	struct stat st;
+	void *buf;
+	size_t len, off = 0;
+	int fd, err, map;
+
+	if (!strcmp("-", path))
+		fd = STDIN_FILENO;
+	else
+		fd = open(path, O_RDONLY);
+
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		perror(path);
+		if (fd > STDIN_FILENO)
+			(void)close(fd);
+		return (-1);
+	}
+
+	map = S_ISREG(st.st_mode) && st.st_size > 0;
+	if (map) {
+		len = (size_t)st.st_size;
+		buf = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (buf == MAP_FAILED)
+			buf = NULL;
+	}
+	else
+		buf = read_all(fd, &len);
+
+	if (buf == NULL) {
+		perror(path);
+		if (fd > STDIN_FILENO)
+			(void)close(fd);
+		return (-1);
+	}
+
+	err = 0;
+	if (bjxa_validate(dec, buf, len, &off) < 0)
+		err = errno;
+	verify_report(dec, path, off, err, out);
+
+	if (map)
+		(void)munmap(buf, len);
+	else
+		free(buf);
+	if (fd > STDIN_FILENO)
+		(void)close(fd);
+	return (err == 0 ? 0 : -1);
+}
+
+int
+verify(int argc, char * const *argv, FILE *out)
+{
+	bjxa_decoder_t *dec;
+	int status = 0;
+
+	dec = bjxa_decoder();
+	if (dec == NULL) {
+		perror("bjxa_decoder");
+		return (-1);
+	}
+
+	for (; argc > 0; argc--, argv++)
+		if (verify_file(dec, *argv, out) < 0)
+			status = -1;
+
+	if (bjxa_free_decoder(&dec) < 0) {
+		perror("bjxa_free_decoder");
+		status = -1;
+	}
+
+	return (status);
+}
@@ -19,13 +19,29 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
+#ifdef HAVE_SSSE3
+#  include <tmmintrin.h>
+#endif
+
+#ifdef BJXA_PROBES
+#  include <sys/sdt.h>
+#endif
+
 #include "bjxa.h"
+#include "bjxa_bundle.h"
 
 /* miniobj.h-inspired macros */
 
@@ -77,6 +93,16 @@
 
 #define VALID_OBJ(o, m) ((o) != NULL && (o)->magic == (m))
 
+/* static probes */
+
+#ifdef BJXA_PROBES
+#  define BJXA_PROBE3(name, a, b, c) STAP_PROBE3(bjxa, name, a, b, c)
+#  define BJXA_PROBE4(name, a, b, c, d) STAP_PROBE4(bjxa, name, a, b, c, d)
+#else
+#  define BJXA_PROBE3(name, a, b, c) do { } while (0)
+#  define BJXA_PROBE4(name, a, b, c, d) do { } while (0)
+#endif
+
 /* error handling */
 
 #define BJXA_TRY(res) \
@@ -88,6 +114,7 @@
 #define BJXA_COND_CHECK(cond, err) \
 	do { \
 		if (!(cond)) { \
+			BJXA_PROBE3(error, (err), __func__, __LINE__); \
 			errno = (err); \
 			return (-1); \
 		} \
@@ -202,6 +229,41 @@ mputs(uint8_t **buf, const char *str)
 	*buf += len;
 }
 
+/* statistics */
+
+#ifdef BJXA_STATS
+static uint64_t
+bjxa_stats_now(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+		return (0);
+	return ((uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec);
+}
+
+#  define BJXA_STATS_TIME(stats, field, stmt) \
+	do { \
+		uint64_t t0 = bjxa_stats_now(); \
+		stmt; \
+		(stats)->field += bjxa_stats_now() - t0; \
+	} while (0)
+#else
+#  define BJXA_STATS_TIME(stats, field, stmt) \
+	do { \
+		stmt; \
+	} while (0)
+#endif
+
+static void
+bjxa_stats_profile(bjxa_stats_t *stats, uint8_t profile)
+{
+
+	assert(profile >> 4 < 5);
+	stats->factors[profile >> 4]++;
+	stats->ranges[profile & 0x0f]++;
+}
+
 /* data structures */
 
 #define BJXA_BLOCK_SAMPLES	32
@@ -214,6 +276,29 @@ typedef struct {
 	int16_t			prev[2];
 } bjxa_channel_t;
 
+typedef struct {
+	int16_t			min;
+	int16_t			max;
+	uint64_t		squares;
+} bjxa_window_t;
+
+#define BJXA_PRINT_LEVELS	8
+#define BJXA_PRINT_WINDOW	4096
+#define BJXA_PRINT_BASIS	UINT64_C(0xcbf29ce484222325)
+#define BJXA_PRINT_PRIME	UINT64_C(0x100000001b3)
+
+typedef struct {
+	uint64_t		hash;
+	uint64_t		samples;
+	uint32_t		windows;
+	uint32_t		len;
+	uint32_t		pending;
+	int32_t			level[BJXA_PRINT_LEVELS];
+	uint64_t		energy[BJXA_PRINT_LEVELS];
+	uint64_t		prev[BJXA_PRINT_LEVELS];
+	int32_t			votes[64];
+} bjxa_print_t;
+
 struct bjxa_decoder {
 	uint32_t		magic;
 #define BJXA_DECODER_MAGIC	0x234ec0c2
@@ -222,9 +307,16 @@ struct bjxa_decoder {
 	uint16_t		samples_rate;
 	uint8_t			block_size;
 	uint8_t			channels;
+	uint8_t			mix;
 	bjxa_channel_t		channel_state[2];
+	bjxa_channel_t		channel_init[2];
+	bjxa_window_t		window_state[2];
+	uint32_t		window;
+	uint32_t		window_len;
+	bjxa_print_t		print[1];
 	bjxa_inflate_f		*inflate_cb;
 	bjxa_format_t		fmt[1];
+	bjxa_stats_t		stats[1];
 };
 
 struct bjxa_encoder {
@@ -236,9 +328,13 @@ struct bjxa_encoder {
 	uint8_t			block_size;
 	uint8_t			bits;
 	uint8_t			channels;
+	uint8_t			stream;
+	uint8_t			sample_size;
+	uint32_t		dither;
 	bjxa_channel_t		channel_state[2];
 	bjxa_deflate_f		*deflate_cb;
 	bjxa_format_t		fmt[1];
+	bjxa_stats_t		stats[1];
 };
 
 /* memory management */
@@ -390,8 +486,124 @@ bjxa_deflate_8bits(uint8_t *dst, const int16_t *src)
 	}
 }
 
+#ifdef HAVE_SSSE3
+/* The SSSE3 kernels pack a complete block at once, and produce the same
+ * output as their scalar counterparts. Loads and stores are unaligned.
+ */
+
+#define BJXA_SSSE3 __attribute__((target("ssse3")))
+
+BJXA_SSSE3 static void
+bjxa_deflate_4bits_ssse3(uint8_t *dst, const int16_t *src)
+{
+	const __m128i *vec_src;
+	__m128i *vec_dst, lo, hi, mask;
+
+	vec_src = (const void *)src;
+	vec_dst = (void *)dst;
+	mask = _mm_set1_epi16(0xff);
+
+	/* one nibble per byte, then two nibbles per byte */
+	lo = _mm_packus_epi16(
+	    _mm_srli_epi16(_mm_loadu_si128(vec_src + 0), 12),
+	    _mm_srli_epi16(_mm_loadu_si128(vec_src + 1), 12));
+	hi = _mm_packus_epi16(
+	    _mm_srli_epi16(_mm_loadu_si128(vec_src + 2), 12),
+	    _mm_srli_epi16(_mm_loadu_si128(vec_src + 3), 12));
+
+	lo = _mm_and_si128(mask,
+	    _mm_or_si128(_mm_slli_epi16(lo, 4), _mm_srli_epi16(lo, 8)));
+	hi = _mm_and_si128(mask,
+	    _mm_or_si128(_mm_slli_epi16(hi, 4), _mm_srli_epi16(hi, 8)));
+
+	_mm_storeu_si128(vec_dst, _mm_packus_epi16(lo, hi));
+}
+
+BJXA_SSSE3 static __m128i
+bjxa_pack_6bits_ssse3(const __m128i *vec_src)
+{
+	__m128i vec;
+
+	/* one sample per byte, then two per 16 bits word, then four per
+	 * 32 bits word, and finally three big endian bytes per word.
+	 */
+	vec = _mm_packus_epi16(
+	    _mm_srli_epi16(_mm_loadu_si128(vec_src + 0), 10),
+	    _mm_srli_epi16(_mm_loadu_si128(vec_src + 1), 10));
+	vec = _mm_maddubs_epi16(vec, _mm_set1_epi16(0x0140));
+	vec = _mm_madd_epi16(vec, _mm_set1_epi32(0x00011000));
+	return (_mm_shuffle_epi8(vec, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9,
+	    8, 14, 13, 12, -1, -1, -1, -1)));
+}
+
+BJXA_SSSE3 static void
+bjxa_deflate_6bits_ssse3(uint8_t *dst, const int16_t *src)
+{
+	const __m128i *vec_src;
+	__m128i vec;
+	int32_t tail;
+
+	vec_src = (const void *)src;
+
+	/* the second half must not overflow the 24 bytes of the block */
+	_mm_storeu_si128((void *)dst, bjxa_pack_6bits_ssse3(vec_src));
+	vec = bjxa_pack_6bits_ssse3(vec_src + 2);
+	_mm_storel_epi64((void *)(dst + 12), vec);
+	tail = _mm_cvtsi128_si32(_mm_srli_si128(vec, 8));
+	memcpy(dst + 20, &tail, 4);
+}
+
+BJXA_SSSE3 static void
+bjxa_deflate_8bits_ssse3(uint8_t *dst, const int16_t *src)
+{
+	const __m128i *vec_src;
+	__m128i *vec_dst;
+
+	vec_src = (const void *)src;
+	vec_dst = (void *)dst;
+
+	_mm_storeu_si128(vec_dst, _mm_packus_epi16(
+	    _mm_srli_epi16(_mm_loadu_si128(vec_src + 0), 8),
+	    _mm_srli_epi16(_mm_loadu_si128(vec_src + 1), 8)));
+	_mm_storeu_si128(vec_dst + 1, _mm_packus_epi16(
+	    _mm_srli_epi16(_mm_loadu_si128(vec_src + 2), 8),
+	    _mm_srli_epi16(_mm_loadu_si128(vec_src + 3), 8)));
+}
+#endif /* HAVE_SSSE3 */
+
+static bjxa_deflate_f *
+bjxa_deflate_select(uint8_t bits)
+{
+
+	assert(bits == 4 || bits == 6 || bits == 8);
+
+#ifdef HAVE_SSSE3
+	if (__builtin_cpu_supports("ssse3")) {
+		if (bits == 4)
+			return (bjxa_deflate_4bits_ssse3);
+		if (bits == 6)
+			return (bjxa_deflate_6bits_ssse3);
+		return (bjxa_deflate_8bits_ssse3);
+	}
+#endif
+
+	if (bits == 4)
+		return (bjxa_deflate_4bits);
+	if (bits == 6)
+		return (bjxa_deflate_6bits);
+	return (bjxa_deflate_8bits);
+}
+
 /* XA header */
 
+static void
+bjxa_print_reset(bjxa_print_t *prt)
+{
+
+	(void)memset(prt, 0, sizeof *prt);
+	prt->hash = BJXA_PRINT_BASIS;
+}
+
 ssize_t
 bjxa_parse_header(bjxa_decoder_t *dec, const void *src, size_t len)
 {
@@ -447,8 +659,12 @@ bjxa_parse_header(bjxa_decoder_t *dec, const void *src, size_t len)
 	(void)pad;
 
 	BJXA_PROTO_CHECK(bjxa_decode_format(&tmp, tmp.fmt) == 0);
+	(void)memcpy(tmp.channel_init, tmp.channel_state,
+	    sizeof tmp.channel_init);
+	bjxa_print_reset(tmp.print);
 
 	(void)memcpy(dec, &tmp, sizeof tmp);
+	BJXA_PROBE4(parse__header, dec, bits, tmp.channels, tmp.fmt->blocks);
 	return (BJXA_HEADER_SIZE_XA);
 }
 
@@ -548,6 +764,7 @@ bjxa_decode_inflated(bjxa_decoder_t *dec, int16_t *dst, uint8_t profile,
 	range = profile & 0x0f;
 
 	BJXA_PROTO_CHECK(factor < 5);
+	bjxa_stats_profile(dec->stats, profile);
 
 	state = &dec->channel_state[chan];
 	k0 = gain_factor[factor][0];
@@ -560,10 +777,14 @@ bjxa_decode_inflated(bjxa_decoder_t *dec, int16_t *dst, uint8_t profile,
 		sample = ranged + gain / 256;
 
 		/* clamp sample */
-		if (sample < INT16_MIN)
+		if (sample < INT16_MIN) {
 			sample = INT16_MIN;
-		if (sample > INT16_MAX)
+			dec->stats->clamps++;
+		}
+		if (sample > INT16_MAX) {
 			sample = INT16_MAX;
+			dec->stats->clamps++;
+		}
 
 		/* propagate sample */
 		*dst = (int16_t)sample;
@@ -577,20 +798,93 @@ bjxa_decode_inflated(bjxa_decoder_t *dec, int16_t *dst, uint8_t profile,
 	return (0);
 }
 
+static int
+bjxa_decode_silent(const bjxa_decoder_t *dec, const uint8_t *src,
+    unsigned chan)
+{
+	const bjxa_channel_t *state;
+	unsigned n;
+
+	/* zero samples only decode to silence without a gain factor, or
+	 * with a predictor state that is already silent.
+	 */
+	state = &dec->channel_state[chan];
+	if (src[0] >> 4 != 0 && (state->prev[0] != 0 || state->prev[1] != 0))
+		return (0);
+
+	for (n = 1; n < dec->block_size; n++)
+		if (src[n] != 0)
+			return (0);
+
+	return (1);
+}
+
+static int
+bjxa_decode_channel(bjxa_decoder_t *dec, int16_t *dst, const uint8_t *src,
+    unsigned chan)
+{
+	bjxa_channel_t *state;
+	unsigned n;
+	uint8_t profile;
+
+	if (!bjxa_decode_silent(dec, src, chan)) {
+		BJXA_STATS_TIME(dec->stats, ns_inflate, profile =
+		    dec->inflate_cb(dst, src, dec->channels));
+		BJXA_STATS_TIME(dec->stats, ns_filter, BJXA_TRY(
+		    bjxa_decode_inflated(dec, dst, profile, chan)));
+		return (0);
+	}
+
+	profile = *src;
+	BJXA_PROTO_CHECK(profile >> 4 < 5);
+	bjxa_stats_profile(dec->stats, profile);
+	dec->stats->silent++;
+
+	if (dec->channels == 1)
+		(void)memset(dst, 0, BJXA_BLOCK_SAMPLES * sizeof *dst);
+	else
+		for (n = 0; n < BJXA_BLOCK_SAMPLES; n++)
+			dst[n * 2] = 0;
+
+	state = &dec->channel_state[chan];
+	state->prev[0] = 0;
+	state->prev[1] = 0;
+	return (0);
+}
+
+static void
+bjxa_decode_downmix(const bjxa_decoder_t *dec, int16_t *buf)
+{
+	unsigned n;
+
+	/* stereo samples are packed in place, front to back */
+	if (dec->mix == BJXA_MIX_LEFT)
+		for (n = 0; n < BJXA_BLOCK_SAMPLES; n++)
+			buf[n] = buf[n * 2];
+	else if (dec->mix == BJXA_MIX_RIGHT)
+		for (n = 0; n < BJXA_BLOCK_SAMPLES; n++)
+			buf[n] = buf[n * 2 + 1];
+	else
+		for (n = 0; n < BJXA_BLOCK_SAMPLES; n++)
+			buf[n] = (int16_t)((buf[n * 2] + buf[n * 2 + 1]) / 2);
+}
+
 int
 bjxa_decode_format(bjxa_decoder_t *dec, bjxa_format_t *fmt)
 {
+	uint8_t channels;
 
 	CHECK_OBJ(dec, BJXA_DECODER_MAGIC);
 	CHECK_PTR(fmt);
 	BJXA_COND_CHECK(dec->block_size != 0, EINVAL);
 
-	fmt->data_len_pcm = dec->samples * dec->channels * sizeof(int16_t);
+	channels = dec->mix == BJXA_MIX_NONE ? dec->channels : 1;
+	fmt->data_len_pcm = dec->samples * channels * sizeof(int16_t);
 	fmt->samples_rate = dec->samples_rate;
 	fmt->sample_bits = 16;
-	fmt->channels = dec->channels;
+	fmt->channels = channels;
 	fmt->block_size_xa = dec->block_size * dec->channels;
-	fmt->block_size_pcm = BJXA_BLOCK_SAMPLES * dec->channels *
+	fmt->block_size_pcm = BJXA_BLOCK_SAMPLES * channels *
 	    sizeof(int16_t);
 	fmt->blocks = dec->data_len / fmt->block_size_xa;
 
@@ -599,6 +893,30 @@ bjxa_decode_format(bjxa_decoder_t *dec, bjxa_format_t *fmt)
 	return (0);
 }
 
+static int
+bjxa_decode_block(bjxa_decoder_t *dec, int16_t *dst, const uint8_t *src,
+    uint8_t pcm_block)
+{
+	bjxa_format_t *fmt;
+
+	fmt = dec->fmt;
+	assert(pcm_block > 0);
+	if (dec->mix != BJXA_MIX_RIGHT)
+		BJXA_TRY(bjxa_decode_channel(dec, dst, src, 0));
+	if (dec->channels == 2 && dec->mix != BJXA_MIX_LEFT)
+		BJXA_TRY(bjxa_decode_channel(dec, dst + 1,
+		    src + dec->block_size, 1));
+	if (dec->mix != BJXA_MIX_NONE)
+		bjxa_decode_downmix(dec, dst);
+
+	dec->stats->blocks++;
+	dec->stats->samples += pcm_block / sizeof *dst;
+
+	fmt->data_len_pcm -= pcm_block;
+	fmt->blocks--;
+	return (0);
+}
+
 int
 bjxa_decode(bjxa_decoder_t *dec, void *dst, size_t dst_len, const void *src,
     size_t src_len)
@@ -606,7 +924,7 @@ bjxa_decode(bjxa_decoder_t *dec, void *dst, size_t dst_len, const void *src,
 	bjxa_format_t *fmt;
 	const uint8_t *src_ptr;
 	int16_t *dst_ptr, dst_buf[BJXA_BLOCK_STEREO];
-	uint8_t profile, pcm_block;
+	uint8_t pcm_block;
 	int blocks = 0;
 
 	CHECK_OBJ(dec, BJXA_DECODER_MAGIC);
@@ -618,6 +936,7 @@ bjxa_decode(bjxa_decoder_t *dec, void *dst, size_t dst_len, const void *src,
 
 	BJXA_BUFFER_CHECK(dst_len >= fmt->block_size_pcm);
 	BJXA_BUFFER_CHECK(src_len >= fmt->block_size_xa);
+	BJXA_PROBE3(decode__start, dec, src_len, dst_len);
 
 	pcm_block = fmt->block_size_pcm;
 	if (pcm_block > fmt->data_len_pcm)
@@ -629,21 +948,9 @@ bjxa_decode(bjxa_decoder_t *dec, void *dst, size_t dst_len, const void *src,
 	while (fmt->blocks > 0 && dst_len >= pcm_block &&
 	    src_len >= fmt->block_size_xa) {
 
-		assert(pcm_block > 0);
-		profile = dec->inflate_cb(dst_buf, src_ptr, dec->channels);
-		BJXA_TRY(bjxa_decode_inflated(dec, dst_buf, profile, 0));
-
-		src_ptr += dec->block_size;
-		src_len -= dec->block_size;
-
-		if (dec->channels == 2) {
-			profile = dec->inflate_cb(dst_buf + 1, src_ptr,
-			    dec->channels);
-			BJXA_TRY(bjxa_decode_inflated(dec, dst_buf + 1,
-			    profile, 1));
-			src_ptr += dec->block_size;
-			src_len -= dec->block_size;
-		}
+		BJXA_TRY(bjxa_decode_block(dec, dst_buf, src_ptr, pcm_block));
+		src_ptr += fmt->block_size_xa;
+		src_len -= fmt->block_size_xa;
 
 		memcpy(dst_ptr, dst_buf, pcm_block);
 
@@ -651,248 +958,1375 @@ bjxa_decode(bjxa_decoder_t *dec, void *dst, size_t dst_len, const void *src,
 		dst_len -= pcm_block;
 		blocks++;
 
-		fmt->data_len_pcm -= pcm_block;
-		fmt->blocks--;
 		if (pcm_block > fmt->data_len_pcm)
 			pcm_block = (uint8_t)fmt->data_len_pcm;
 	}
 
+	BJXA_PROBE4(decode__done, dec, blocks,
+	    (uintptr_t)src_ptr - (uintptr_t)src,
+	    (uintptr_t)dst_ptr - (uintptr_t)dst);
 	return (blocks);
 }
 
-/* encode XA blocks */
-
-static void
-bjxa_encode_inflated(bjxa_encoder_t *enc, int16_t *dst, const int16_t *src,
-    uint8_t *profile, unsigned chan, unsigned pcm_block)
+static int
+bjxa_sync_block(const uint8_t *src, unsigned block_size, unsigned channels)
 {
-	unsigned n, samples, step;
-
-	assert(chan == 0 || chan == 1);
-	assert(pcm_block > 0);
 
-	step = enc->channels;
-	samples = pcm_block / (step * sizeof *src);
-	assert(pcm_block % samples == 0);
-	assert(samples <= BJXA_BLOCK_SAMPLES);
-
-	*profile = 0;
-	for (n = 0; n < samples; n++) {
-		*dst = *src;
-		src += step;
-		dst++;
-	}
+	assert(channels == 1 || channels == 2);
 
-	while (samples < BJXA_BLOCK_SAMPLES) {
-		*dst = 0;
-		dst++;
-		samples++;
-	}
+	/* a block with a gain factor of zero does not depend on previous
+	 * samples, the decoder state is irrelevant for such blocks.
+	 */
+	if (src[0] >> 4 != 0)
+		return (0);
+	if (channels == 2 && src[block_size] >> 4 != 0)
+		return (0);
+	return (1);
 }
 
 int
-bjxa_encode_init(bjxa_encoder_t *enc, bjxa_format_t *fmt, uint8_t bits)
+bjxa_decode_sync(bjxa_decoder_t *dec, const void *src, size_t len)
 {
-	bjxa_encoder_t tmp;
-
-	CHECK_OBJ(enc, BJXA_ENCODER_MAGIC);
-	CHECK_PTR(fmt);
-	BJXA_COND_CHECK(fmt->sample_bits == 16, EINVAL);
-	BJXA_COND_CHECK(bits == 4 || bits == 6 || bits == 8, EINVAL);
+	const uint8_t *src_ptr;
+	unsigned xa_block;
+	int blocks = 0;
 
-	INIT_OBJ(&tmp, BJXA_ENCODER_MAGIC);
-	tmp.bits = bits;
-	tmp.channels = fmt->channels;
-	BJXA_PROTO_CHECK(tmp.channels == 1 || tmp.channels == 2);
+	CHECK_OBJ(dec, BJXA_DECODER_MAGIC);
+	CHECK_PTR(src);
+	BJXA_COND_CHECK(dec->block_size != 0, EINVAL);
 
-	tmp.samples = fmt->data_len_pcm / (tmp.channels * sizeof(int16_t));
-	tmp.samples_rate = fmt->samples_rate;
-	BJXA_PROTO_CHECK(tmp.samples > 0);
-	BJXA_PROTO_CHECK(tmp.samples_rate > 0);
-	BJXA_PROTO_CHECK(fmt->data_len_pcm % tmp.samples == 0);
+	xa_block = dec->block_size * dec->channels;
+	BJXA_BUFFER_CHECK(len >= xa_block);
 
-	if (bits == 4)
-		tmp.deflate_cb = bjxa_deflate_4bits;
-	else if (bits == 6)
-		tmp.deflate_cb = bjxa_deflate_6bits;
-	else
-		tmp.deflate_cb = bjxa_deflate_8bits;
+	src_ptr = src;
 
-	tmp.block_size = bits * 4 + 1;
-	fmt->block_size_xa = tmp.block_size * tmp.channels;
-	fmt->block_size_pcm = BJXA_BLOCK_SAMPLES * tmp.channels *
-	    sizeof(int16_t);
-	fmt->blocks = tmp.samples / BJXA_BLOCK_SAMPLES;
-	tmp.data_len = fmt->blocks * tmp.block_size * tmp.channels;
-	if (tmp.samples % BJXA_BLOCK_SAMPLES != 0) {
-		tmp.data_len += tmp.block_size * tmp.channels;
-		fmt->blocks++;
+	while (len >= xa_block &&
+	    !bjxa_sync_block(src_ptr, dec->block_size, dec->channels)) {
+		src_ptr += xa_block;
+		len -= xa_block;
+		blocks++;
 	}
 
-	memcpy(tmp.fmt, fmt, sizeof *fmt);
-	memcpy(enc, &tmp, sizeof tmp);
-	return (0);
+	return (blocks);
 }
 
 int
-bjxa_encode_format(bjxa_encoder_t *enc, bjxa_format_t *fmt)
+bjxa_decode_seek(bjxa_decoder_t *dec, uint32_t block)
 {
+	bjxa_format_t fmt;
 
-	CHECK_OBJ(enc, BJXA_ENCODER_MAGIC);
-	CHECK_PTR(fmt);
-	BJXA_COND_CHECK(enc->block_size != 0, EINVAL);
+	CHECK_OBJ(dec, BJXA_DECODER_MAGIC);
+	BJXA_TRY(bjxa_decode_format(dec, &fmt));
+	BJXA_COND_CHECK(block < fmt.blocks, EINVAL);
 
-	fmt->data_len_pcm = enc->samples * enc->channels * sizeof(int16_t);
-	fmt->samples_rate = enc->samples_rate;
-	fmt->sample_bits = enc->bits;
-	fmt->channels = enc->channels;
-	fmt->block_size_xa = enc->block_size * enc->channels;
-	fmt->block_size_pcm = BJXA_BLOCK_SAMPLES * enc->channels *
-	    sizeof(int16_t);
-	fmt->blocks = enc->data_len / fmt->block_size_xa;
+	fmt.blocks -= block;
+	fmt.data_len_pcm -= block * fmt.block_size_pcm;
 
-	assert(fmt->blocks * fmt->block_size_xa == enc->data_len);
+	if (block == 0)
+		(void)memcpy(dec->channel_state, dec->channel_init,
+		    sizeof dec->channel_state);
+	else
+		(void)memset(dec->channel_state, 0,
+		    sizeof dec->channel_state);
 
+	dec->window_len = 0;
+	bjxa_print_reset(dec->print);
+	(void)memcpy(dec->fmt, &fmt, sizeof fmt);
 	return (0);
 }
 
 int
-bjxa_encode(bjxa_encoder_t *enc, void *dst, size_t dst_len, const void *src,
-    size_t src_len)
+bjxa_decode_mix(bjxa_decoder_t *dec, unsigned mix)
 {
 	bjxa_format_t *fmt;
-	const int16_t *src_ptr;
-	uint8_t *dst_ptr;
-	int16_t enc_buf[BJXA_BLOCK_SAMPLES];
-	uint8_t profile, pcm_block;
-	int blocks = 0;
-
-	CHECK_OBJ(enc, BJXA_ENCODER_MAGIC);
-	CHECK_PTR(dst);
-	CHECK_PTR(src);
-	fmt = enc->fmt;
-	BJXA_COND_CHECK(fmt->sample_bits == 16, EINVAL);
-	BJXA_PROTO_CHECK(fmt->blocks > 0);
+	uint8_t channels;
 
-	BJXA_BUFFER_CHECK(dst_len >= fmt->block_size_xa);
-	BJXA_BUFFER_CHECK(src_len >= fmt->block_size_pcm);
+	CHECK_OBJ(dec, BJXA_DECODER_MAGIC);
+	BJXA_COND_CHECK(dec->block_size != 0, EINVAL);
+	BJXA_COND_CHECK(mix <= BJXA_MIX_MONO, EINVAL);
+	BJXA_COND_CHECK(mix == BJXA_MIX_NONE || dec->channels == 2, EINVAL);
 
-	pcm_block = fmt->block_size_pcm;
-	if (pcm_block > fmt->data_len_pcm)
-		pcm_block = (uint8_t)fmt->data_len_pcm;
+	/* the remaining samples are counted in output channels */
+	fmt = dec->fmt;
+	channels = mix == BJXA_MIX_NONE ? dec->channels : 1;
+	fmt->data_len_pcm = fmt->data_len_pcm / fmt->channels * channels;
+	fmt->channels = channels;
+	fmt->block_size_pcm = BJXA_BLOCK_SAMPLES * channels * sizeof(int16_t);
+
+	dec->mix = (uint8_t)mix;
+	dec->window_len = 0;
+	bjxa_print_reset(dec->print);
+	return (0);
+}
 
-	dst_ptr = dst;
-	src_ptr = src;
+int
+bjxa_decoder_stats(bjxa_decoder_t *dec, bjxa_stats_t *stats)
+{
 
-	while (fmt->blocks > 0 && dst_len >= fmt->block_size_xa &&
-	    src_len >= pcm_block) {
+	CHECK_OBJ(dec, BJXA_DECODER_MAGIC);
+	CHECK_PTR(stats);
 
-		assert(pcm_block > 0);
-		bjxa_encode_inflated(enc, enc_buf, src_ptr, &profile,
-		    0, pcm_block);
-		*dst_ptr = profile;
-		enc->deflate_cb(dst_ptr + 1, enc_buf);
+	(void)memcpy(stats, dec->stats, sizeof *stats);
+	return (0);
+}
 
-		dst_ptr += enc->block_size;
-		dst_len -= enc->block_size;
+/* waveform overview */
 
-		if (enc->channels == 2) {
-			bjxa_encode_inflated(enc, enc_buf, src_ptr + 1,
-			    &profile, 1, pcm_block);
-			*dst_ptr = profile;
-			enc->deflate_cb(dst_ptr + 1, enc_buf);
-			dst_ptr += enc->block_size;
-			dst_len -= enc->block_size;
-		}
+static uint16_t
+bjxa_isqrt(uint64_t val)
+{
+	uint64_t res, bit;
 
-		src_ptr += pcm_block / sizeof *src_ptr;
-		src_len -= pcm_block;
-		blocks++;
+	res = 0;
+	bit = (uint64_t)1 << 62;
+	while (bit > val)
+		bit >>= 2;
 
-		fmt->data_len_pcm -= pcm_block;
-		fmt->blocks--;
-		if (pcm_block > fmt->data_len_pcm)
-			pcm_block = (uint8_t)fmt->data_len_pcm;
+	while (bit != 0) {
+		if (val >= res + bit) {
+			val -= res + bit;
+			res = (res >> 1) + bit;
+		}
+		else {
+			res >>= 1;
+		}
+		bit >>= 2;
 	}
 
-	return (blocks);
+	assert(res <= UINT16_MAX);
+	return ((uint16_t)res);
 }
 
-/* WAVE file format */
+static bjxa_peak_t *
+bjxa_window_flush(bjxa_decoder_t *dec, bjxa_peak_t *dst)
+{
+	bjxa_window_t *win;
+	unsigned chan;
+
+	assert(dec->window_len > 0);
+	for (chan = 0; chan < dec->fmt->channels; chan++, dst++) {
+		win = &dec->window_state[chan];
+		dst->min = win->min;
+		dst->max = win->max;
+		dst->rms = bjxa_isqrt(win->squares / dec->window_len);
+	}
 
-#define WAVE_HEADER_LEN	16
-#define WAVE_FORMAT_PCM	1
+	dec->window_len = 0;
+	return (dst);
+}
 
-ssize_t
-bjxa_parse_riff_header(bjxa_format_t *fmt, const void *src, size_t len)
+static bjxa_peak_t *
+bjxa_window_samples(bjxa_decoder_t *dec, bjxa_peak_t *dst,
+    const int16_t *src, unsigned samples)
 {
-	bjxa_format_t tmp;
-	uint32_t riff_data, wave_hdr, wave_rate, wave_bytes, wave_data;
-	uint16_t wave_fmt, wave_chan, wave_block, wave_bits;
-	const uint8_t *buf;
+	bjxa_window_t *win;
+	unsigned chan, n;
+	int16_t smp;
 
-	CHECK_PTR(fmt);
-	CHECK_PTR(src);
-	BJXA_BUFFER_CHECK(len >= BJXA_HEADER_SIZE_RIFF);
+	for (n = 0; n < samples; n++) {
+		for (chan = 0; chan < dec->fmt->channels; chan++) {
+			win = &dec->window_state[chan];
+			smp = *src++;
+			if (dec->window_len == 0) {
+				win->min = smp;
+				win->max = smp;
+				win->squares = 0;
+			}
+			if (smp < win->min)
+				win->min = smp;
+			if (smp > win->max)
+				win->max = smp;
+			win->squares += (uint64_t)((int32_t)smp * smp);
+		}
+		if (++dec->window_len == dec->window)
+			dst = bjxa_window_flush(dec, dst);
+	}
 
-	buf = src;
+	return (dst);
+}
+
+int
+bjxa_decode_window(bjxa_decoder_t *dec, uint32_t window)
+{
+
+	CHECK_OBJ(dec, BJXA_DECODER_MAGIC);
+	BJXA_COND_CHECK(dec->block_size != 0, EINVAL);
+	BJXA_COND_CHECK(window > 0, EINVAL);
+
+	dec->window = window;
+	dec->window_len = 0;
+	return (0);
+}
+
+ssize_t
+bjxa_decode_peaks(bjxa_decoder_t *dec, bjxa_peak_t *dst, size_t dst_len,
+    const void *src, size_t src_len)
+{
+	bjxa_format_t *fmt;
+	bjxa_peak_t *dst_ptr;
+	const uint8_t *src_ptr;
+	int16_t dst_buf[BJXA_BLOCK_STEREO];
+	uint64_t samples, peaks;
+	uint32_t blocks, frame;
+	uint8_t pcm_block;
+
+	CHECK_OBJ(dec, BJXA_DECODER_MAGIC);
+	CHECK_PTR(dst);
+	CHECK_PTR(src);
+	fmt = dec->fmt;
+	BJXA_COND_CHECK(dec->window > 0, EINVAL);
+	BJXA_PROTO_CHECK(fmt->blocks > 0);
+	BJXA_BUFFER_CHECK(src_len >= fmt->block_size_xa);
+
+	/* all the blocks from src are decoded, so dst must be able to hold
+	 * all the windows they complete, plus the last incomplete window at
+	 * the end of the stream.
+	 */
+	blocks = (uint32_t)(src_len / fmt->block_size_xa);
+	if (blocks > fmt->blocks)
+		blocks = fmt->blocks;
+	frame = fmt->channels * sizeof(int16_t);
+	samples = (uint64_t)blocks * BJXA_BLOCK_SAMPLES;
+	if (samples > fmt->data_len_pcm / frame)
+		samples = fmt->data_len_pcm / frame;
+	samples += dec->window_len;
+	peaks = samples / dec->window;
+	if (blocks == fmt->blocks && samples % dec->window != 0)
+		peaks++;
+	BJXA_BUFFER_CHECK(dst_len >= peaks * fmt->channels);
+
+	pcm_block = fmt->block_size_pcm;
+	if (pcm_block > fmt->data_len_pcm)
+		pcm_block = (uint8_t)fmt->data_len_pcm;
+
+	dst_ptr = dst;
+	src_ptr = src;
+
+	while (blocks > 0) {
+		BJXA_TRY(bjxa_decode_block(dec, dst_buf, src_ptr, pcm_block));
+		dst_ptr = bjxa_window_samples(dec, dst_ptr, dst_buf,
+		    pcm_block / frame);
+		src_ptr += fmt->block_size_xa;
+		blocks--;
+
+		if (pcm_block > fmt->data_len_pcm)
+			pcm_block = (uint8_t)fmt->data_len_pcm;
+	}
+
+	if (fmt->blocks == 0 && dec->window_len > 0)
+		dst_ptr = bjxa_window_flush(dec, dst_ptr);
+
+	assert((size_t)(dst_ptr - dst) == peaks * fmt->channels);
+	return (dst_ptr - dst);
+}
+
+/* fingerprint */
+
+static uint64_t
+bjxa_print_mix(uint64_t val)
+{
+
+	/* splitmix64 */
+	val += UINT64_C(0x9e3779b97f4a7c15);
+	val = (val ^ (val >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+	val = (val ^ (val >> 27)) * UINT64_C(0x94d049bb133111eb);
+	return (val ^ (val >> 31));
+}
+
+static void
+bjxa_print_window(bjxa_print_t *prt)
+{
+	uint64_t band[BJXA_PRINT_LEVELS], feature, hash, energy;
+	unsigned b;
+
+	/* every level has half as many coefficients as the previous one,
+	 * so energies are scaled to compare average coefficients.
+	 */
+	energy = 0;
+	for (b = 0; b < BJXA_PRINT_LEVELS; b++) {
+		band[b] = prt->energy[b] << (b + 1);
+		energy |= band[b];
+	}
+
+	/* each window votes for the bits of its feature hash, the feature
+	 * being the shape of the spectrum and how it moved since the last
+	 * window. A margin avoids flipping bits over the quantization noise
+	 * of different encodings of the same audio.
+	 */
+	if (energy != 0) {
+		feature = 0;
+		for (b = 0; b + 1 < BJXA_PRINT_LEVELS; b++)
+			if (band[b] * 8 > band[b + 1] * 9)
+				feature |= 1U << b;
+		for (b = 0; b < BJXA_PRINT_LEVELS; b++)
+			if (band[b] * 8 > prt->prev[b] * 9)
+				feature |= 1U << (b + BJXA_PRINT_LEVELS - 1);
+
+		hash = bjxa_print_mix(feature);
+		for (b = 0; b < 64; b++)
+			prt->votes[b] += (hash >> b) & 1 ? 1 : -1;
+		prt->windows++;
+	}
+
+	(void)memcpy(prt->prev, band, sizeof prt->prev);
+	(void)memset(prt->energy, 0, sizeof prt->energy);
+	prt->len = 0;
+}
+
+static void
+bjxa_print_samples(bjxa_print_t *prt, const int16_t *src, unsigned samples,
+    unsigned channels)
+{
+	uint16_t smp;
+	int32_t val, diff;
+	unsigned n, lvl;
+
+	for (n = 0; n < samples * channels; n++) {
+		smp = (uint16_t)src[n];
+		prt->hash = (prt->hash ^ (smp & 0xff)) * BJXA_PRINT_PRIME;
+		prt->hash = (prt->hash ^ (smp >> 8)) * BJXA_PRINT_PRIME;
+	}
+	prt->samples += samples;
+
+	/* streaming Haar transform of the mono signal, each level keeping
+	 * a pending average until its next sample arrives.
+	 */
+	for (n = 0; n < samples; n++, src += channels) {
+		val = src[0];
+		if (channels == 2)
+			val = (val + src[1]) / 2;
+		for (lvl = 0; lvl < BJXA_PRINT_LEVELS; lvl++) {
+			if ((prt->pending & (1U << lvl)) == 0) {
+				prt->level[lvl] = val;
+				prt->pending |= 1U << lvl;
+				break;
+			}
+			diff = prt->level[lvl] - val;
+			prt->energy[lvl] += (uint64_t)((int64_t)diff * diff);
+			val = (prt->level[lvl] + val) / 2;
+			prt->pending &= ~(1U << lvl);
+		}
+		if (++prt->len == BJXA_PRINT_WINDOW)
+			bjxa_print_window(prt);
+	}
+}
+
+int
+bjxa_decode_fingerprint(bjxa_decoder_t *dec, const void *src, size_t src_len)
+{
+	bjxa_format_t *fmt;
+	const uint8_t *src_ptr;
+	int16_t dst_buf[BJXA_BLOCK_STEREO];
+	uint8_t pcm_block;
+	int blocks = 0;
+
+	CHECK_OBJ(dec, BJXA_DECODER_MAGIC);
+	CHECK_PTR(src);
+	fmt = dec->fmt;
+	BJXA_PROTO_CHECK(fmt->blocks > 0);
+	BJXA_BUFFER_CHECK(src_len >= fmt->block_size_xa);
+
+	pcm_block = fmt->block_size_pcm;
+	if (pcm_block > fmt->data_len_pcm)
+		pcm_block = (uint8_t)fmt->data_len_pcm;
+
+	src_ptr = src;
+
+	while (fmt->blocks > 0 && src_len >= fmt->block_size_xa) {
+		BJXA_TRY(bjxa_decode_block(dec, dst_buf, src_ptr, pcm_block));
+		bjxa_print_samples(dec->print, dst_buf,
+		    pcm_block / (fmt->channels * sizeof *dst_buf),
+		    fmt->channels);
+		src_ptr += fmt->block_size_xa;
+		src_len -= fmt->block_size_xa;
+		blocks++;
+
+		if (pcm_block > fmt->data_len_pcm)
+			pcm_block = (uint8_t)fmt->data_len_pcm;
+	}
+
+	return (blocks);
+}
+
+int
+bjxa_decoder_fingerprint(bjxa_decoder_t *dec, bjxa_fingerprint_t *fp)
+{
+	bjxa_print_t *prt;
+	unsigned b;
+
+	CHECK_OBJ(dec, BJXA_DECODER_MAGIC);
+	CHECK_PTR(fp);
+	BJXA_COND_CHECK(dec->block_size != 0, EINVAL);
+
+	prt = dec->print;
+	(void)memset(fp, 0, sizeof *fp);
+	fp->hash = prt->hash;
+	fp->samples = prt->samples;
+	fp->windows = prt->windows;
+
+	/* the last incomplete window is left out */
+	for (b = 0; b < 64; b++)
+		if (prt->votes[b] > 0)
+			fp->print |= UINT64_C(1) << b;
+	return (0);
+}
+
+/* validate XA streams */
+
+#ifdef HAVE_SSSE3
+/* Profile bytes sit every block_size bytes, so the pattern of profiles in
+ * 16 bytes vectors repeats every block_size vectors. A whole period is
+ * compared at once against a table of masks, and the scalar loop finds
+ * the exact block once a period contains an invalid profile.
+ */
+
+BJXA_SSSE3 static size_t
+bjxa_validate_ssse3(const uint8_t *src, size_t len, unsigned block_size)
+{
+	uint8_t masks[16 * (BJXA_BLOCK_SAMPLES + 1)];
+	__m128i limit, vec, bad;
+	size_t off, period;
+	unsigned n;
+
+	assert(block_size <= BJXA_BLOCK_SAMPLES + 1);
+	period = block_size * 16;
+	for (n = 0; n < period; n++)
+		masks[n] = n % block_size == 0 ? 0xff : 0x00;
+
+	/* unsigned comparison: max(x, limit) == x when x >= limit */
+	limit = _mm_set1_epi8(5 << 4);
+	for (off = 0; off + period <= len; off += period) {
+		bad = _mm_setzero_si128();
+		for (n = 0; n < block_size; n++) {
+			vec = _mm_loadu_si128(
+			    (const void *)(src + off + n * 16));
+			vec = _mm_cmpeq_epi8(_mm_max_epu8(vec, limit), vec);
+			bad = _mm_or_si128(bad, _mm_and_si128(vec,
+			    _mm_loadu_si128((const void *)(masks + n * 16))));
+		}
+		if (_mm_movemask_epi8(bad) != 0)
+			break;
+	}
+
+	return (off);
+}
+#endif
+
+int
+bjxa_validate(bjxa_decoder_t *dec, const void *src, size_t len, size_t *offp)
+{
+	const uint8_t *buf;
+	size_t off, data_len;
+
+	CHECK_OBJ(dec, BJXA_DECODER_MAGIC);
+	CHECK_PTR(src);
+
+	if (offp != NULL)
+		*offp = 0;
+
+	BJXA_TRY(bjxa_parse_header(dec, src, len));
+
+	buf = (const uint8_t *)src + BJXA_HEADER_SIZE_XA;
+	len -= BJXA_HEADER_SIZE_XA;
+	data_len = dec->data_len;
+
+	/* a truncated stream fails on its first incomplete block */
+	if (offp != NULL && len < data_len)
+		*offp = BJXA_HEADER_SIZE_XA + len - len % dec->block_size;
+	BJXA_PROTO_CHECK(len >= data_len);
+
+	off = 0;
+#ifdef HAVE_SSSE3
+	if (__builtin_cpu_supports("ssse3"))
+		off = bjxa_validate_ssse3(buf, data_len, dec->block_size);
+#endif
+
+	while (off < data_len && buf[off] >> 4 < 5)
+		off += dec->block_size;
+
+	if (offp != NULL && off < data_len)
+		*offp = BJXA_HEADER_SIZE_XA + off;
+	BJXA_PROTO_CHECK(off >= data_len);
+	return (0);
+}
+
+/* edit XA streams */
+
+#define BJXA_STATE_BLOCKS	16
+
+static int
+bjxa_decode_state(bjxa_decoder_t *dec, const uint8_t *xa, uint32_t block)
+{
+	int16_t pcm[BJXA_BLOCK_STEREO * BJXA_STATE_BLOCKS];
+	uint32_t sync, blocks;
+	unsigned xa_block;
+
+	/* the predictor state before a block only depends on the blocks
+	 * following the last sync block, decode from there.
+	 */
+	xa_block = dec->block_size * dec->channels;
+	sync = block;
+	while (sync > 0 && !bjxa_sync_block(xa + (sync - 1) * xa_block,
+	    dec->block_size, dec->channels))
+		sync--;
+	if (sync > 0)
+		sync--;
+
+	BJXA_TRY(bjxa_decode_seek(dec, sync));
+
+	while (sync < block) {
+		blocks = block - sync;
+		if (blocks > BJXA_STATE_BLOCKS)
+			blocks = BJXA_STATE_BLOCKS;
+		BJXA_PROTO_CHECK(bjxa_decode(dec, pcm, sizeof pcm,
+		    xa + sync * xa_block, blocks * xa_block) == (int)blocks);
+		sync += blocks;
+	}
+
+	return (0);
+}
+
+ssize_t
+bjxa_cut(bjxa_decoder_t *dec, void *dst, size_t dst_len, const void *src,
+    size_t src_len, uint32_t from, uint32_t to)
+{
+	const uint8_t *xa;
+	uint32_t first, last, data_len, loop;
+	uint8_t *hdr;
+	unsigned chan;
+
+	CHECK_OBJ(dec, BJXA_DECODER_MAGIC);
+	CHECK_PTR(dst);
+	CHECK_PTR(src);
+	BJXA_TRY(bjxa_parse_header(dec, src, src_len));
+	xa = (const uint8_t *)src + 16;
+	loop = mread_le32(&xa);
+	BJXA_PROTO_CHECK(src_len - BJXA_HEADER_SIZE_XA >= dec->data_len);
+	BJXA_COND_CHECK(from < to && to <= dec->fmt->blocks, EINVAL);
+
+	data_len = (to - from) * dec->block_size * dec->channels;
+	BJXA_BUFFER_CHECK(dst_len >= BJXA_HEADER_SIZE_XA);
+	BJXA_BUFFER_CHECK(dst_len - BJXA_HEADER_SIZE_XA >= data_len);
+
+	xa = (const uint8_t *)src + BJXA_HEADER_SIZE_XA;
+	first = from * BJXA_BLOCK_SAMPLES;
+	last = to * BJXA_BLOCK_SAMPLES;
+	if (last > dec->samples)
+		last = dec->samples;
+
+	BJXA_TRY(bjxa_decode_state(dec, xa, from));
+
+	/* a loop point outside of the range is dropped */
+	if (loop >= first && loop < last)
+		loop -= first;
+	else
+		loop = 0;
+
+	(void)memcpy(dst, src, BJXA_HEADER_SIZE_XA);
+	hdr = (uint8_t *)dst + 4;
+	mwrite_le(&hdr, data_len, 32);
+	mwrite_le(&hdr, last - first, 32);
+	hdr += 4; /* samples rate, bits, channels */
+	mwrite_le(&hdr, loop, 32);
+	for (chan = 0; chan < 2; chan++) {
+		mwrite_le(&hdr, (uint16_t)dec->channel_state[chan].prev[0],
+		    16);
+		mwrite_le(&hdr, (uint16_t)dec->channel_state[chan].prev[1],
+		    16);
+	}
+
+	(void)memcpy((uint8_t *)dst + BJXA_HEADER_SIZE_XA,
+	    xa + from * dec->block_size * dec->channels, data_len);
+	return (BJXA_HEADER_SIZE_XA + data_len);
+}
+
+ssize_t
+bjxa_concat(bjxa_decoder_t *dec, void *dst, size_t dst_len,
+    const void * const *src, const size_t *src_len, unsigned n)
+{
+	bjxa_channel_t state[2];
+	uint64_t data_len, samples;
+	uint32_t blocks;
+	uint16_t samples_rate;
+	uint8_t block_size, channels, *ptr;
+	const uint8_t *xa;
+	unsigned i;
+
+	CHECK_OBJ(dec, BJXA_DECODER_MAGIC);
+	CHECK_PTR(dst);
+	CHECK_PTR(src);
+	CHECK_PTR(src_len);
+	BJXA_COND_CHECK(n > 0, EINVAL);
+
+	data_len = 0;
+	samples = 0;
+	samples_rate = 0;
+	block_size = 0;
+	channels = 0;
+
+	/* all streams but the last must end on a complete block */
+	for (i = 0; i < n; i++) {
+		CHECK_PTR(src[i]);
+		BJXA_TRY(bjxa_parse_header(dec, src[i], src_len[i]));
+		BJXA_PROTO_CHECK(src_len[i] - BJXA_HEADER_SIZE_XA >=
+		    dec->data_len);
+		if (i == 0) {
+			samples_rate = dec->samples_rate;
+			block_size = dec->block_size;
+			channels = dec->channels;
+		}
+		BJXA_COND_CHECK(dec->samples_rate == samples_rate &&
+		    dec->block_size == block_size &&
+		    dec->channels == channels, EINVAL);
+		BJXA_COND_CHECK(i == n - 1 || dec->samples ==
+		    dec->fmt->blocks * BJXA_BLOCK_SAMPLES, EINVAL);
+		data_len += dec->data_len;
+		samples += dec->samples;
+	}
+
+	BJXA_PROTO_CHECK(data_len <= UINT32_MAX);
+	BJXA_BUFFER_CHECK(dst_len >= BJXA_HEADER_SIZE_XA);
+	BJXA_BUFFER_CHECK(dst_len - BJXA_HEADER_SIZE_XA >= data_len);
+
+	/* a stream must start with a sync block, or with the predictor
+	 * state of the end of the previous stream.
+	 */
+	for (i = 1; i < n; i++) {
+		xa = (const uint8_t *)src[i] + BJXA_HEADER_SIZE_XA;
+		if (bjxa_sync_block(xa, block_size, channels))
+			continue;
+		BJXA_TRY(bjxa_parse_header(dec, src[i - 1], src_len[i - 1]));
+		blocks = dec->fmt->blocks;
+		BJXA_TRY(bjxa_decode_state(dec, (const uint8_t *)src[i - 1] +
+		    BJXA_HEADER_SIZE_XA, blocks));
+		(void)memcpy(state, dec->channel_state, sizeof state);
+		BJXA_TRY(bjxa_parse_header(dec, src[i], src_len[i]));
+		BJXA_COND_CHECK(!memcmp(state, dec->channel_init,
+		    sizeof state), EINVAL);
+	}
+
+	ptr = dst;
+	(void)memcpy(ptr, src[0], BJXA_HEADER_SIZE_XA);
+	ptr += 4;
+	mwrite_le(&ptr, (uint32_t)data_len, 32);
+	mwrite_le(&ptr, (uint32_t)samples, 32);
+	ptr = (uint8_t *)dst + BJXA_HEADER_SIZE_XA;
+
+	for (i = 0; i < n; i++) {
+		BJXA_TRY(bjxa_parse_header(dec, src[i], src_len[i]));
+		(void)memcpy(ptr, (const uint8_t *)src[i] +
+		    BJXA_HEADER_SIZE_XA, dec->data_len);
+		ptr += dec->data_len;
+	}
+
+	return ((ssize_t)(BJXA_HEADER_SIZE_XA + data_len));
+}
+
+/* convert PCM samples */
+
+#define BJXA_DITHER_SEED	0x2545f491
+
+static uint32_t
+bjxa_dither_next(bjxa_encoder_t *enc)
+{
+	uint32_t rnd;
+
+	/* xorshift32, good enough for triangular noise */
+	rnd = enc->dither;
+	assert(rnd != 0);
+	rnd ^= rnd << 13;
+	rnd ^= rnd >> 17;
+	rnd ^= rnd << 5;
+	enc->dither = rnd;
+	return (rnd);
+}
+
+static int16_t
+bjxa_clamp16(bjxa_encoder_t *enc, int32_t val)
+{
+
+	if (val > INT16_MAX) {
+		enc->stats->clamps++;
+		return (INT16_MAX);
+	}
+	if (val < INT16_MIN) {
+		enc->stats->clamps++;
+		return (INT16_MIN);
+	}
+	return ((int16_t)val);
+}
+
+static int16_t
+bjxa_convert_8bits(const uint8_t **src)
+{
+
+	return ((int16_t)((mread_le8(src) - 128) * 256));
+}
+
+static int16_t
+bjxa_convert_24bits(bjxa_encoder_t *enc, const uint8_t **src)
+{
+	uint32_t rnd;
+	int32_t val;
+
+	val = (int32_t)mread_le(src, 24);
+	if (val & 0x800000)
+		val -= 0x1000000;
+
+	/* round to nearest, after adding triangular noise spanning one
+	 * 16 bits step on each side.
+	 */
+	val += 128;
+	if (enc->dither != 0) {
+		rnd = bjxa_dither_next(enc);
+		val += (int32_t)(rnd & 0xff) + (int32_t)((rnd >> 8) & 0xff);
+		val -= 255;
+	}
+
+	/* floor division, regardless of the sign */
+	val = (val + 0x1000000) / 256 - 0x10000;
+	return (bjxa_clamp16(enc, val));
+}
+
+static int16_t
+bjxa_convert_float(bjxa_encoder_t *enc, const uint8_t **src)
+{
+	uint32_t raw, rnd;
+	float val;
+
+	assert(sizeof val == sizeof raw);
+	raw = mread_le32(src);
+	memcpy(&val, &raw, sizeof val);
+	if (isnan(val))
+		return (0);
+
+	val *= 32768.0f;
+	if (enc->dither != 0) {
+		rnd = bjxa_dither_next(enc);
+		val += (float)((rnd & 0xffff) + (rnd >> 16)) / 65536.0f;
+		val -= 1.0f;
+	}
+
+	if (val < (float)INT16_MIN || val > (float)INT16_MAX)
+		return (bjxa_clamp16(enc, val < 0.0f ? INT32_MIN : INT32_MAX));
+
+	/* round to nearest, with a positive value to truncate */
+	return (bjxa_clamp16(enc, (int32_t)(val + 32768.5f) - 32768));
+}
+
+static void
+bjxa_encode_convert(bjxa_encoder_t *enc, int16_t *dst, const uint8_t *src,
+    unsigned samples)
+{
+
+	assert(samples <= BJXA_BLOCK_STEREO);
+	assert(enc->sample_size != sizeof *dst);
+
+	while (samples > 0) {
+		if (enc->sample_size == 1)
+			*dst = bjxa_convert_8bits(&src);
+		else if (enc->sample_size == 3)
+			*dst = bjxa_convert_24bits(enc, &src);
+		else {
+			assert(enc->sample_size == 4);
+			*dst = bjxa_convert_float(enc, &src);
+		}
+		dst++;
+		samples--;
+	}
+}
+
+/* encode XA blocks */
+
+static void
+bjxa_encode_inflated(bjxa_encoder_t *enc, int16_t *dst, const int16_t *src,
+    uint8_t *profile, unsigned chan, unsigned pcm_block)
+{
+	unsigned n, samples, step;
+
+	assert(chan == 0 || chan == 1);
+	assert(pcm_block > 0);
+
+	step = enc->channels;
+	samples = pcm_block / (step * sizeof *src);
+	assert(pcm_block % samples == 0);
+	assert(samples <= BJXA_BLOCK_SAMPLES);
+
+	/* the first gain factor is always used, so every block is a sync
+	 * block.
+	 */
+	*profile = 0;
+	for (n = 0; n < samples; n++) {
+		*dst = *src;
+		src += step;
+		dst++;
+	}
+
+	while (samples < BJXA_BLOCK_SAMPLES) {
+		*dst = 0;
+		dst++;
+		samples++;
+	}
+}
+
+static int
+bjxa_encode_silent(const bjxa_encoder_t *enc, const int16_t *src,
+    unsigned pcm_block)
+{
+	unsigned n, samples;
+
+	samples = pcm_block / (enc->channels * sizeof *src);
+	for (n = 0; n < samples; n++) {
+		if (*src != 0)
+			return (0);
+		src += enc->channels;
+	}
+
+	return (1);
+}
+
+static void
+bjxa_encode_channel(bjxa_encoder_t *enc, uint8_t *dst, const int16_t *src,
+    unsigned chan, unsigned pcm_block)
+{
+	int16_t enc_buf[BJXA_BLOCK_SAMPLES];
+	uint8_t profile;
+
+	/* digital silence needs neither a profile search nor packing */
+	if (bjxa_encode_silent(enc, src, pcm_block)) {
+		(void)memset(dst, 0, enc->block_size);
+		bjxa_stats_profile(enc->stats, 0);
+		enc->stats->silent++;
+		return;
+	}
+
+	BJXA_STATS_TIME(enc->stats, ns_filter, bjxa_encode_inflated(enc,
+	    enc_buf, src, &profile, chan, pcm_block));
+	bjxa_stats_profile(enc->stats, profile);
+	*dst = profile;
+	BJXA_STATS_TIME(enc->stats, ns_deflate,
+	    enc->deflate_cb(dst + 1, enc_buf));
+}
+
+int
+bjxa_encode_init(bjxa_encoder_t *enc, bjxa_format_t *fmt, uint8_t bits)
+{
+	bjxa_encoder_t tmp;
+
+	CHECK_OBJ(enc, BJXA_ENCODER_MAGIC);
+	CHECK_PTR(fmt);
+	BJXA_COND_CHECK(fmt->sample_bits == 8 || fmt->sample_bits == 16 ||
+	    fmt->sample_bits == 24 || fmt->sample_bits == 32, EINVAL);
+	BJXA_COND_CHECK(bits == 4 || bits == 6 || bits == 8, EINVAL);
+
+	INIT_OBJ(&tmp, BJXA_ENCODER_MAGIC);
+	tmp.bits = bits;
+	tmp.sample_size = fmt->sample_bits / 8;
+	tmp.channels = fmt->channels;
+	BJXA_PROTO_CHECK(tmp.channels == 1 || tmp.channels == 2);
+
+	tmp.samples_rate = fmt->samples_rate;
+	BJXA_PROTO_CHECK(tmp.samples_rate > 0);
+
+	/* an unknown PCM data length means that samples are counted as
+	 * they are encoded.
+	 */
+	tmp.stream = (fmt->data_len_pcm == 0);
+	if (!tmp.stream) {
+		tmp.samples = fmt->data_len_pcm /
+		    (tmp.channels * tmp.sample_size);
+		BJXA_PROTO_CHECK(tmp.samples > 0);
+		BJXA_PROTO_CHECK(fmt->data_len_pcm % tmp.samples == 0);
+	}
+
+	tmp.deflate_cb = bjxa_deflate_select(bits);
+
+	/* the PCM block size is always expressed in 16 bits samples, and
+	 * scaled to the actual sample size when encoding.
+	 */
+	tmp.block_size = bits * 4 + 1;
+	fmt->block_size_xa = tmp.block_size * tmp.channels;
+	fmt->block_size_pcm = BJXA_BLOCK_SAMPLES * tmp.channels *
+	    sizeof(int16_t);
+	fmt->blocks = tmp.samples / BJXA_BLOCK_SAMPLES;
+	tmp.data_len = fmt->blocks * tmp.block_size * tmp.channels;
+	if (tmp.samples % BJXA_BLOCK_SAMPLES != 0) {
+		tmp.data_len += tmp.block_size * tmp.channels;
+		fmt->blocks++;
+	}
+
+	memcpy(tmp.fmt, fmt, sizeof *fmt);
+	if (tmp.stream) {
+		tmp.fmt->data_len_pcm = UINT32_MAX;
+		tmp.fmt->blocks = UINT32_MAX;
+	}
+	memcpy(enc, &tmp, sizeof tmp);
+	BJXA_PROBE4(encode__init, enc, bits, tmp.channels, fmt->blocks);
+	return (0);
+}
+
+int
+bjxa_encode_format(bjxa_encoder_t *enc, bjxa_format_t *fmt)
+{
+
+	CHECK_OBJ(enc, BJXA_ENCODER_MAGIC);
+	CHECK_PTR(fmt);
+	BJXA_COND_CHECK(enc->block_size != 0, EINVAL);
+
+	fmt->data_len_pcm = enc->samples * enc->channels * sizeof(int16_t);
+	fmt->samples_rate = enc->samples_rate;
+	fmt->sample_bits = enc->bits;
+	fmt->channels = enc->channels;
+	fmt->block_size_xa = enc->block_size * enc->channels;
+	fmt->block_size_pcm = BJXA_BLOCK_SAMPLES * enc->channels *
+	    sizeof(int16_t);
+	fmt->blocks = enc->data_len / fmt->block_size_xa;
+
+	assert(fmt->blocks * fmt->block_size_xa == enc->data_len);
+
+	return (0);
+}
+
+int
+bjxa_encode_seek(bjxa_encoder_t *enc, uint32_t block)
+{
+	bjxa_format_t *fmt;
+	uint32_t blocks;
+
+	CHECK_OBJ(enc, BJXA_ENCODER_MAGIC);
+	BJXA_COND_CHECK(enc->block_size != 0, EINVAL);
+	BJXA_COND_CHECK(!enc->stream, EINVAL);
+
+	fmt = enc->fmt;
+	blocks = enc->data_len / fmt->block_size_xa;
+	BJXA_COND_CHECK(block < blocks, EINVAL);
+
+	/* the PCM length is expressed in source samples */
+	fmt->blocks = blocks - block;
+	fmt->data_len_pcm = (enc->samples - block * BJXA_BLOCK_SAMPLES) *
+	    enc->channels * enc->sample_size;
+
+	(void)memset(enc->channel_state, 0, sizeof enc->channel_state);
+	return (0);
+}
+
+int
+bjxa_encoder_stats(bjxa_encoder_t *enc, bjxa_stats_t *stats)
+{
+
+	CHECK_OBJ(enc, BJXA_ENCODER_MAGIC);
+	CHECK_PTR(stats);
+
+	(void)memcpy(stats, enc->stats, sizeof *stats);
+	return (0);
+}
+
+int
+bjxa_encode_dither(bjxa_encoder_t *enc, unsigned dither)
+{
+
+	CHECK_OBJ(enc, BJXA_ENCODER_MAGIC);
+	BJXA_COND_CHECK(enc->block_size != 0, EINVAL);
+
+	/* the same seed for every stream keeps the output reproducible */
+	enc->dither = dither ? BJXA_DITHER_SEED : 0;
+	return (0);
+}
+
+static int
+bjxa_encode_full(const bjxa_encoder_t *enc)
+{
+
+	assert(enc->stream);
+	return (enc->data_len > UINT32_MAX - enc->fmt->block_size_xa ||
+	    enc->samples > UINT32_MAX - BJXA_BLOCK_SAMPLES);
+}
+
+int
+bjxa_encode(bjxa_encoder_t *enc, void *dst, size_t dst_len, const void *src,
+    size_t src_len)
+{
+	bjxa_format_t *fmt;
+	const uint8_t *src_ptr;
+	const int16_t *pcm_ptr;
+	uint8_t *dst_ptr;
+	int16_t pcm_buf[BJXA_BLOCK_STEREO];
+	unsigned frame, src_block, pcm_block, pcm_len;
+	int blocks = 0;
+
+	CHECK_OBJ(enc, BJXA_ENCODER_MAGIC);
+	CHECK_PTR(dst);
+	CHECK_PTR(src);
+	fmt = enc->fmt;
+	BJXA_COND_CHECK(enc->sample_size > 0, EINVAL);
+	BJXA_PROTO_CHECK(fmt->blocks > 0);
+
+	frame = enc->channels * enc->sample_size;
+	src_block = BJXA_BLOCK_SAMPLES * frame;
+
+	BJXA_BUFFER_CHECK(dst_len >= fmt->block_size_xa);
+	if (enc->stream) {
+		BJXA_PROTO_CHECK(!bjxa_encode_full(enc));
+		BJXA_BUFFER_CHECK(src_len > 0);
+		BJXA_BUFFER_CHECK(src_len % frame == 0);
+	}
+	else
+		BJXA_BUFFER_CHECK(src_len >= src_block);
+	BJXA_PROBE3(encode__start, enc, src_len, dst_len);
+
+	pcm_block = src_block;
+	if (pcm_block > fmt->data_len_pcm)
+		pcm_block = fmt->data_len_pcm;
+	if (enc->stream && pcm_block > src_len)
+		pcm_block = (unsigned)src_len;
+
+	dst_ptr = dst;
+	src_ptr = src;
+
+	while (fmt->blocks > 0 && dst_len >= fmt->block_size_xa &&
+	    src_len >= pcm_block && pcm_block > 0) {
+
+		/* convert other sample sizes to 16 bits in the same pass */
+		if (enc->sample_size == sizeof *pcm_ptr)
+			pcm_ptr = (const int16_t *)src_ptr;
+		else {
+			BJXA_STATS_TIME(enc->stats, ns_convert,
+			    bjxa_encode_convert(enc, pcm_buf, src_ptr,
+			    pcm_block / enc->sample_size));
+			pcm_ptr = pcm_buf;
+		}
+		pcm_len = pcm_block / enc->sample_size * sizeof *pcm_ptr;
+
+		bjxa_encode_channel(enc, dst_ptr, pcm_ptr, 0, pcm_len);
+		dst_ptr += enc->block_size;
+		dst_len -= enc->block_size;
+
+		if (enc->channels == 2) {
+			bjxa_encode_channel(enc, dst_ptr, pcm_ptr + 1, 1,
+			    pcm_len);
+			dst_ptr += enc->block_size;
+			dst_len -= enc->block_size;
+		}
+
+		src_ptr += pcm_block;
+		src_len -= pcm_block;
+		blocks++;
+
+		enc->stats->blocks++;
+		enc->stats->samples += pcm_block / enc->sample_size;
+
+		if (enc->stream) {
+			/* a truncated block ends the stream */
+			enc->samples += pcm_block / frame;
+			enc->data_len += fmt->block_size_xa;
+			if (pcm_block < src_block)
+				fmt->blocks = 0;
+			if (bjxa_encode_full(enc))
+				break;
+			if (pcm_block > src_len)
+				pcm_block = (unsigned)src_len;
+			continue;
+		}
+
+		fmt->data_len_pcm -= pcm_block;
+		fmt->blocks--;
+		if (pcm_block > fmt->data_len_pcm)
+			pcm_block = fmt->data_len_pcm;
+	}
+
+	BJXA_PROBE4(encode__done, enc, blocks,
+	    (uintptr_t)src_ptr - (uintptr_t)src,
+	    (uintptr_t)dst_ptr - (uintptr_t)dst);
+	return (blocks);
+}
+
+/* transcode XA blocks */
+
+#define BJXA_TRANSCODE_BLOCKS	16
+
+int
+bjxa_transcode(bjxa_decoder_t *dec, bjxa_encoder_t *enc, void *dst,
+    size_t dst_len, const void *src, size_t src_len)
+{
+	int16_t pcm[BJXA_BLOCK_STEREO * BJXA_TRANSCODE_BLOCKS];
+	const uint8_t *src_ptr;
+	uint8_t *dst_ptr;
+	unsigned src_block, dst_block, pcm_block;
+	size_t chunk;
+	int blocks = 0, res;
+
+	CHECK_OBJ(dec, BJXA_DECODER_MAGIC);
+	CHECK_OBJ(enc, BJXA_ENCODER_MAGIC);
+	CHECK_PTR(dst);
+	CHECK_PTR(src);
+	BJXA_COND_CHECK(dec->block_size != 0, EINVAL);
+	BJXA_COND_CHECK(enc->sample_size == sizeof *pcm, EINVAL);
+	BJXA_COND_CHECK(enc->channels == dec->fmt->channels, EINVAL);
+	BJXA_PROTO_CHECK(dec->fmt->blocks > 0);
+	BJXA_PROTO_CHECK(enc->fmt->blocks > 0);
+
+	src_block = dec->fmt->block_size_xa;
+	dst_block = enc->fmt->block_size_xa;
+	pcm_block = dec->fmt->block_size_pcm;
+	BJXA_BUFFER_CHECK(src_len >= src_block);
+	BJXA_BUFFER_CHECK(dst_len >= dst_block);
+
+	src_ptr = src;
+	dst_ptr = dst;
+
+	/* XA blocks always hold 32 samples per channel, so one decoded
+	 * block is encoded to exactly one block.
+	 */
+	while (dec->fmt->blocks > 0 && enc->fmt->blocks > 0 &&
+	    src_len >= src_block && dst_len >= dst_block) {
+		chunk = BJXA_TRANSCODE_BLOCKS;
+		if (chunk > src_len / src_block)
+			chunk = src_len / src_block;
+		if (chunk > dst_len / dst_block)
+			chunk = dst_len / dst_block;
+
+		res = bjxa_decode(dec, pcm, sizeof pcm, src_ptr,
+		    chunk * src_block);
+		BJXA_TRY(res);
+		BJXA_PROTO_CHECK(res > 0);
+		BJXA_PROTO_CHECK(bjxa_encode(enc, dst_ptr, dst_len, pcm,
+		    (size_t)res * pcm_block) == res);
+
+		src_ptr += (size_t)res * src_block;
+		src_len -= (size_t)res * src_block;
+		dst_ptr += (size_t)res * dst_block;
+		dst_len -= (size_t)res * dst_block;
+		blocks += res;
+	}
+
+	return (blocks);
+}
+
+/* WAVE file format */
+
+#define WAVE_HEADER_LEN		16
+#define WAVE_HEADER_EXT_LEN	40
+#define WAVE_FORMAT_PCM		1
+#define WAVE_FORMAT_IEEE_FLOAT	3
+#define WAVE_FORMAT_EXTENSIBLE	0xfffe
+#define WAVE_LEN_UNKNOWN	UINT32_MAX
+
+/* KSDATAFORMAT_SUBTYPE_* GUIDs without the leading format tag */
+static const uint8_t wave_subformat_guid[] = {
+	0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00,
+	0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71
+};
+
+static int
+mmatch(const uint8_t *buf, const char *str)
+{
+
+	assert(buf != NULL);
+	assert(str != NULL);
+	assert(strlen(str) == 4);
+
+	return (!memcmp(buf, str, 4));
+}
+
+static int
+bjxa_parse_wave_fmt(bjxa_format_t *fmt, const uint8_t *buf, uint32_t len)
+{
+	uint32_t wave_rate, wave_bytes;
+	uint16_t wave_fmt, wave_chan, wave_block, wave_bits, wave_ext,
+	    wave_valid;
+
+	BJXA_PROTO_CHECK(len >= WAVE_HEADER_LEN);
 
-	BJXA_TRY(mgets(&buf, "RIFF"));
-	riff_data = mread_le32(&buf);
-	BJXA_TRY(mgets(&buf, "WAVEfmt "));
-	wave_hdr = mread_le32(&buf);
 	wave_fmt = mread_le16(&buf);
 	wave_chan = mread_le16(&buf);
 	wave_rate = mread_le32(&buf);
 	wave_bytes = mread_le32(&buf);
 	wave_block = mread_le16(&buf);
 	wave_bits = mread_le16(&buf);
-	BJXA_TRY(mgets(&buf, "data"));
-	wave_data = mread_le32(&buf);
 
-	assert((uintptr_t)buf - (uintptr_t)src == BJXA_HEADER_SIZE_RIFF);
+	if (wave_fmt == WAVE_FORMAT_EXTENSIBLE) {
+		BJXA_PROTO_CHECK(len >= WAVE_HEADER_EXT_LEN);
+		wave_ext = mread_le16(&buf);
+		wave_valid = mread_le16(&buf);
+		(void)mread_le32(&buf); /* channel mask */
+		wave_fmt = mread_le16(&buf);
+		BJXA_PROTO_CHECK(wave_ext >= WAVE_HEADER_EXT_LEN - 18);
+		BJXA_PROTO_CHECK(wave_valid > 0 && wave_valid <= wave_bits);
+		BJXA_PROTO_CHECK(!memcmp(buf, wave_subformat_guid,
+		    sizeof wave_subformat_guid));
+	}
+
+	/* 32 bits samples are always floating point */
+	if (wave_fmt == WAVE_FORMAT_IEEE_FLOAT)
+		BJXA_PROTO_CHECK(wave_bits == 32);
+	else {
+		BJXA_PROTO_CHECK(wave_fmt == WAVE_FORMAT_PCM);
+		BJXA_PROTO_CHECK(wave_bits == 8 || wave_bits == 16 ||
+		    wave_bits == 24);
+	}
 
-	BJXA_PROTO_CHECK(riff_data >= BJXA_HEADER_SIZE_RIFF - 8 + wave_data);
-	BJXA_PROTO_CHECK(wave_hdr == WAVE_HEADER_LEN);
-	BJXA_PROTO_CHECK(wave_fmt == WAVE_FORMAT_PCM);
 	BJXA_PROTO_CHECK(wave_chan == 1 || wave_chan == 2);
 	BJXA_PROTO_CHECK(wave_rate > 0 && wave_rate < UINT16_MAX);
-	BJXA_PROTO_CHECK(wave_block == wave_chan * sizeof(uint16_t));
+	BJXA_PROTO_CHECK(wave_block == wave_chan * wave_bits / 8);
 	BJXA_PROTO_CHECK(wave_bytes == wave_rate * wave_block);
-	BJXA_PROTO_CHECK(wave_data % wave_block == 0);
-	BJXA_PROTO_CHECK(wave_bits == 16);
 
-	memset(&tmp, 0, sizeof tmp);
+	memset(fmt, 0, sizeof *fmt);
+	fmt->samples_rate = wave_rate;
+	fmt->sample_bits = (uint8_t)wave_bits;
+	fmt->channels = wave_chan;
+	return (0);
+}
+
+ssize_t
+bjxa_parse_riff_header(bjxa_format_t *fmt, const void *src, size_t len)
+{
+	bjxa_format_t tmp;
+	uint32_t riff_data, chunk_len, wave_data;
+	const uint8_t *buf;
+	size_t off;
+	int wave_fmt = 0;
+
+	CHECK_PTR(fmt);
+	CHECK_PTR(src);
+	BJXA_BUFFER_CHECK(len >= BJXA_HEADER_SIZE_RIFF);
+
+	buf = src;
+
+	BJXA_TRY(mgets(&buf, "RIFF"));
+	riff_data = mread_le32(&buf);
+	BJXA_TRY(mgets(&buf, "WAVE"));
+
+	/* walk the chunks until the "data" chunk, skipping unknown ones */
+	while (1) {
+		off = (uintptr_t)buf - (uintptr_t)src;
+		BJXA_BUFFER_CHECK(off <= len && len - off >= 8);
+		if (mmatch(buf, "data"))
+			break;
+
+		buf += 4;
+		chunk_len = mread_le32(&buf);
+		off += 8;
+		BJXA_BUFFER_CHECK(len - off >= chunk_len);
+
+		if (mmatch(buf - 8, "fmt ")) {
+			BJXA_PROTO_CHECK(!wave_fmt);
+			BJXA_TRY(bjxa_parse_wave_fmt(&tmp, buf, chunk_len));
+			wave_fmt = 1;
+		}
+
+		buf += chunk_len;
+		if (chunk_len & 1)
+			buf++; /* pad byte */
+	}
+
+	BJXA_PROTO_CHECK(wave_fmt);
+	buf += 4;
+	wave_data = mread_le32(&buf);
+	off += 8;
+
+	/* streams of unknown length, usually coming from a pipe */
+	if (wave_data == WAVE_LEN_UNKNOWN)
+		wave_data = 0;
+	if (riff_data != 0 && riff_data != WAVE_LEN_UNKNOWN) {
+		BJXA_PROTO_CHECK(riff_data >= off - 8);
+		BJXA_PROTO_CHECK(riff_data - (off - 8) >= wave_data);
+	}
+
+	BJXA_PROTO_CHECK(
+	    wave_data % (tmp.channels * tmp.sample_bits / 8) == 0);
+
 	tmp.data_len_pcm = wave_data;
-	tmp.samples_rate = wave_rate;
-	tmp.sample_bits = 16;
-	tmp.channels = wave_chan;
 	(void)memcpy(fmt, &tmp, sizeof tmp);
 
-	return (BJXA_HEADER_SIZE_RIFF);
+	assert(off <= SSIZE_MAX);
+	return ((ssize_t)off);
+}
+
+static int
+bjxa_fread_all(FILE *file, void *buf, size_t len)
+{
+
+	if (len > 0 && fread(buf, len, 1, file) != 1) {
+		if (feof(file))
+			errno = EIO;
+		return (-1);
+	}
+	return (0);
+}
+
+static int
+bjxa_fskip(FILE *file, uint32_t len)
+{
+	uint8_t buf[256];
+	size_t n;
+
+	while (len > 0) {
+		n = len < sizeof buf ? len : sizeof buf;
+		BJXA_TRY(bjxa_fread_all(file, buf, n));
+		len -= n;
+	}
+	return (0);
 }
 
 ssize_t
 bjxa_fread_riff_header(bjxa_format_t *fmt, FILE *file)
 {
-	uint8_t buf[BJXA_HEADER_SIZE_RIFF];
+	uint8_t buf[BJXA_HEADER_SIZE_RIFF - WAVE_HEADER_LEN +
+	    WAVE_HEADER_EXT_LEN], *hdr;
+	const uint8_t *ptr;
+	uint32_t chunk_len, fmt_len;
+	size_t len = 0;
 	ssize_t ret;
 
 	CHECK_PTR(fmt);
 	CHECK_PTR(file);
 
-	if (fread(buf, sizeof buf, 1, file) != 1) {
-		if (feof(file))
-			errno = EIO;
-		return (-1);
+	/* only keep the chunks needed to parse a canonical header */
+	BJXA_TRY(bjxa_fread_all(file, buf, 12));
+	hdr = buf + 12;
+	len += 12;
+
+	while (1) {
+		BJXA_TRY(bjxa_fread_all(file, hdr, 8));
+		len += 8;
+		if (mmatch(hdr, "data"))
+			break;
+
+		ptr = hdr + 4;
+		chunk_len = mread_le32(&ptr);
+		BJXA_PROTO_CHECK(chunk_len < UINT32_MAX);
+		if (chunk_len & 1)
+			chunk_len++; /* pad byte */
+		len += chunk_len;
+
+		if (!mmatch(hdr, "fmt ")) {
+			BJXA_TRY(bjxa_fskip(file, chunk_len));
+			continue;
+		}
+
+		BJXA_PROTO_CHECK(hdr == buf + 12);
+
+		fmt_len = chunk_len;
+		if (fmt_len > WAVE_HEADER_EXT_LEN)
+			fmt_len = WAVE_HEADER_EXT_LEN;
+		BJXA_TRY(bjxa_fread_all(file, hdr + 8, fmt_len));
+		BJXA_TRY(bjxa_fskip(file, chunk_len - fmt_len));
+		hdr[4] = (uint8_t)fmt_len;
+		hdr[5] = hdr[6] = hdr[7] = 0;
+		hdr += 8 + fmt_len;
 	}
 
-	ret = bjxa_parse_riff_header(fmt, buf, sizeof buf);
+	BJXA_PROTO_CHECK(hdr != buf + 12);
+	ret = bjxa_parse_riff_header(fmt, buf,
+	    (uintptr_t)hdr + 8 - (uintptr_t)buf);
 	if (ret < 0) {
 		assert(errno != EINVAL);
 		assert(errno != ENOBUFS);
+		return (ret);
 	}
-	return (ret);
+
+	assert(len <= SSIZE_MAX);
+	return ((ssize_t)len);
 }
 
 ssize_t
@@ -994,3 +2428,507 @@ bjxa_fwrite_pcm(const int16_t *src, size_t len, FILE *file)
 
 	return (0);
 }
+
+/* job pool */
+
+struct bjxa_queue {
+	bjxa_job_t		**jobs;
+	size_t			head;
+	size_t			len;
+	size_t			size;
+};
+
+struct bjxa_worker {
+	bjxa_pool_t		*pool;
+	bjxa_decoder_t		*dec;
+	pthread_t		thread;
+};
+
+struct bjxa_pool {
+	uint32_t		magic;
+#define BJXA_POOL_MAGIC		0x5f1d7a03
+	unsigned		workers;
+	unsigned		started;
+	unsigned		shutdown;
+	size_t			busy;
+	bjxa_job_f		*cb;
+	pthread_mutex_t		mtx;
+	pthread_cond_t		job_cond;
+	pthread_cond_t		done_cond;
+	struct bjxa_queue	pending[1];
+	struct bjxa_queue	done[1];
+	struct bjxa_worker	*worker;
+};
+
+static int
+bjxa_queue_reserve(struct bjxa_queue *queue, size_t len)
+{
+	bjxa_job_t **jobs;
+	size_t n, size;
+
+	if (len <= queue->size)
+		return (0);
+
+	size = queue->size > 0 ? queue->size : 16;
+	while (size < len)
+		size *= 2;
+
+	jobs = malloc(size * sizeof *jobs);
+	if (jobs == NULL)
+		return (-1);
+
+	for (n = 0; n < queue->len; n++)
+		jobs[n] = queue->jobs[(queue->head + n) % queue->size];
+
+	free(queue->jobs);
+	queue->jobs = jobs;
+	queue->head = 0;
+	queue->size = size;
+	return (0);
+}
+
+static void
+bjxa_queue_push(struct bjxa_queue *queue, bjxa_job_t *job)
+{
+
+	assert(queue->len < queue->size);
+	queue->jobs[(queue->head + queue->len) % queue->size] = job;
+	queue->len++;
+}
+
+static bjxa_job_t *
+bjxa_queue_pop(struct bjxa_queue *queue)
+{
+	bjxa_job_t *job;
+
+	if (queue->len == 0)
+		return (NULL);
+
+	job = queue->jobs[queue->head];
+	queue->head = (queue->head + 1) % queue->size;
+	queue->len--;
+	return (job);
+}
+
+static int
+bjxa_pool_decode(bjxa_decoder_t *dec, bjxa_job_t *job)
+{
+	const uint8_t *src;
+	size_t src_len;
+
+	CHECK_PTR(job->src);
+	CHECK_PTR(job->dst);
+	BJXA_TRY(bjxa_parse_header(dec, job->src, job->src_len));
+	BJXA_TRY(bjxa_decode_format(dec, &job->fmt));
+
+	src = (const uint8_t *)job->src + BJXA_HEADER_SIZE_XA;
+	src_len = job->src_len - BJXA_HEADER_SIZE_XA;
+	BJXA_BUFFER_CHECK(job->dst_len >= job->fmt.data_len_pcm);
+	BJXA_BUFFER_CHECK(src_len >=
+	    (size_t)job->fmt.blocks * job->fmt.block_size_xa);
+
+	return (bjxa_decode(dec, job->dst, job->dst_len, src, src_len));
+}
+
+static void *
+bjxa_pool_worker(void *priv)
+{
+	struct bjxa_worker *wrk;
+	bjxa_pool_t *pool;
+	bjxa_job_t *job;
+
+	wrk = priv;
+	pool = wrk->pool;
+
+	(void)pthread_mutex_lock(&pool->mtx);
+	while (1) {
+		while (pool->pending->len == 0 && !pool->shutdown)
+			(void)pthread_cond_wait(&pool->job_cond, &pool->mtx);
+
+		/* pending jobs are drained before shutting down */
+		job = bjxa_queue_pop(pool->pending);
+		if (job == NULL)
+			break;
+		(void)pthread_mutex_unlock(&pool->mtx);
+
+		job->status = bjxa_pool_decode(wrk->dec, job);
+		job->error = job->status < 0 ? errno : 0;
+		if (pool->cb != NULL)
+			pool->cb(job);
+
+		(void)pthread_mutex_lock(&pool->mtx);
+		if (pool->cb == NULL)
+			bjxa_queue_push(pool->done, job);
+		assert(pool->busy > 0);
+		pool->busy--;
+		(void)pthread_cond_broadcast(&pool->done_cond);
+	}
+	(void)pthread_mutex_unlock(&pool->mtx);
+
+	return (NULL);
+}
+
+static void
+bjxa_pool_stop(bjxa_pool_t *pool)
+{
+	unsigned n;
+
+	(void)pthread_mutex_lock(&pool->mtx);
+	pool->shutdown = 1;
+	(void)pthread_cond_broadcast(&pool->job_cond);
+	(void)pthread_mutex_unlock(&pool->mtx);
+
+	for (n = 0; n < pool->started; n++)
+		(void)pthread_join(pool->worker[n].thread, NULL);
+
+	for (n = 0; n < pool->workers; n++)
+		if (pool->worker[n].dec != NULL)
+			(void)bjxa_free_decoder(&pool->worker[n].dec);
+
+	(void)pthread_cond_destroy(&pool->done_cond);
+	(void)pthread_cond_destroy(&pool->job_cond);
+	(void)pthread_mutex_destroy(&pool->mtx);
+	free(pool->pending->jobs);
+	free(pool->done->jobs);
+	free(pool->worker);
+	FREE_OBJ(pool);
+}
+
+bjxa_pool_t *
+bjxa_pool(unsigned workers, bjxa_job_f *cb)
+{
+	bjxa_pool_t *pool;
+	unsigned n;
+	int err;
+
+	if (workers == 0 || workers > BJXA_POOL_MAX) {
+		errno = EINVAL;
+		return (NULL);
+	}
+
+	ALLOC_OBJ(pool, BJXA_POOL_MAGIC);
+	if (pool == NULL)
+		return (NULL);
+
+	pool->workers = workers;
+	pool->cb = cb;
+	(void)pthread_mutex_init(&pool->mtx, NULL);
+	(void)pthread_cond_init(&pool->job_cond, NULL);
+	(void)pthread_cond_init(&pool->done_cond, NULL);
+
+	pool->worker = calloc(workers, sizeof *pool->worker);
+	if (pool->worker == NULL) {
+		bjxa_pool_stop(pool);
+		return (NULL);
+	}
+
+	for (n = 0; n < workers; n++) {
+		pool->worker[n].pool = pool;
+		pool->worker[n].dec = bjxa_decoder();
+		if (pool->worker[n].dec == NULL) {
+			err = errno;
+			bjxa_pool_stop(pool);
+			errno = err;
+			return (NULL);
+		}
+	}
+
+	for (n = 0; n < workers; n++) {
+		err = pthread_create(&pool->worker[n].thread, NULL,
+		    bjxa_pool_worker, pool->worker + n);
+		if (err != 0) {
+			bjxa_pool_stop(pool);
+			errno = err;
+			return (NULL);
+		}
+		pool->started++;
+	}
+
+	return (pool);
+}
+
+int
+bjxa_free_pool(bjxa_pool_t **poolp)
+{
+	bjxa_pool_t *pool;
+
+	TAKE_OBJ(pool, poolp, BJXA_POOL_MAGIC);
+	bjxa_pool_stop(pool);
+	return (0);
+}
+
+int
+bjxa_pool_submit(bjxa_pool_t *pool, bjxa_job_t *job)
+{
+	int ret = 0;
+
+	CHECK_OBJ(pool, BJXA_POOL_MAGIC);
+	CHECK_PTR(job);
+
+	job->status = -1;
+	job->error = EINPROGRESS;
+
+	(void)pthread_mutex_lock(&pool->mtx);
+
+	/* room for the completion is reserved upfront */
+	if (bjxa_queue_reserve(pool->pending, pool->pending->len + 1) < 0 ||
+	    (pool->cb == NULL && bjxa_queue_reserve(pool->done,
+	    pool->done->len + pool->busy + 1) < 0))
+		ret = -1;
+	else {
+		bjxa_queue_push(pool->pending, job);
+		pool->busy++;
+		(void)pthread_cond_signal(&pool->job_cond);
+	}
+
+	(void)pthread_mutex_unlock(&pool->mtx);
+	return (ret);
+}
+
+bjxa_job_t *
+bjxa_pool_poll(bjxa_pool_t *pool, unsigned wait)
+{
+	bjxa_job_t *job;
+
+	if (!VALID_OBJ(pool, BJXA_POOL_MAGIC)) {
+		errno = pool == NULL ? EFAULT : EINVAL;
+		return (NULL);
+	}
+
+	(void)pthread_mutex_lock(&pool->mtx);
+	while (wait && pool->done->len == 0 && pool->busy > 0)
+		(void)pthread_cond_wait(&pool->done_cond, &pool->mtx);
+	job = bjxa_queue_pop(pool->done);
+	(void)pthread_mutex_unlock(&pool->mtx);
+
+	if (job == NULL)
+		errno = EAGAIN;
+	return (job);
+}
+
+/* bundle */
+
+struct bjxa_bundle {
+	uint32_t		magic;
+#define BJXA_BUNDLE_MAGIC	0x7b0d1e2a
+	uint32_t		entries;
+	uint32_t		slots;
+	const uint8_t		*map;
+	size_t			len;
+	const uint8_t		*index;
+	const uint8_t		*table;
+};
+
+static int
+bjxa_bundle_check_entry(const bjxa_bundle_t *bundle, const uint8_t *buf)
+{
+	uint32_t offset, length, name, data_len, blocks;
+	uint8_t bits, channels;
+
+	buf += 8;
+	offset = mread_le32(&buf);
+	length = mread_le32(&buf);
+	name = mread_le32(&buf);
+	data_len = mread_le32(&buf);
+	blocks = mread_le32(&buf);
+	buf += 2;
+	bits = mread_le8(&buf);
+	channels = mread_le8(&buf);
+
+	BJXA_PROTO_CHECK(bits == 4 || bits == 6 || bits == 8);
+	BJXA_PROTO_CHECK(channels == 1 || channels == 2);
+	BJXA_PROTO_CHECK(blocks > 0);
+	BJXA_PROTO_CHECK(data_len > 0);
+	BJXA_PROTO_CHECK(data_len <= (uint64_t)blocks * BJXA_BLOCK_SAMPLES *
+	    channels * sizeof(int16_t));
+	BJXA_PROTO_CHECK(length == BJXA_HEADER_SIZE_XA +
+	    (uint64_t)blocks * (bits * 4 + 1) * channels);
+	BJXA_PROTO_CHECK(offset <= bundle->len);
+	BJXA_PROTO_CHECK(length <= bundle->len - offset);
+	BJXA_PROTO_CHECK(!memcmp(bundle->map + offset, "KWD1", 4));
+	BJXA_PROTO_CHECK(name < bundle->len);
+	BJXA_PROTO_CHECK(memchr(bundle->map + name, '\0',
+	    bundle->len - name) != NULL);
+	return (0);
+}
+
+static int
+bjxa_bundle_check(bjxa_bundle_t *bundle)
+{
+	const uint8_t *buf;
+	uint64_t index_len;
+	uint32_t n;
+
+	buf = bundle->map;
+	BJXA_PROTO_CHECK(bundle->len >= BJXA_BUNDLE_HEADER);
+	BJXA_TRY(mgets(&buf, BJXA_BUNDLE_ID));
+	BJXA_PROTO_CHECK(mread_le32(&buf) == BJXA_BUNDLE_VERSION);
+	bundle->entries = mread_le32(&buf);
+	bundle->slots = mread_le32(&buf);
+
+	/* a power of two, with room for empty slots */
+	BJXA_PROTO_CHECK(bundle->slots > bundle->entries);
+	BJXA_PROTO_CHECK((bundle->slots & (bundle->slots - 1)) == 0);
+
+	index_len = (uint64_t)bundle->entries * BJXA_BUNDLE_ENTRY +
+	    (uint64_t)bundle->slots * BJXA_BUNDLE_SLOT;
+	BJXA_PROTO_CHECK(index_len <= bundle->len - BJXA_BUNDLE_HEADER);
+
+	bundle->index = buf;
+	bundle->table = buf + (size_t)bundle->entries * BJXA_BUNDLE_ENTRY;
+
+	for (n = 0; n < bundle->entries; n++)
+		BJXA_TRY(bjxa_bundle_check_entry(bundle,
+		    bundle->index + (size_t)n * BJXA_BUNDLE_ENTRY));
+
+	buf = bundle->table;
+	for (n = 0; n < bundle->slots; n++)
+		BJXA_PROTO_CHECK(mread_le32(&buf) <= bundle->entries);
+
+	return (0);
+}
+
+bjxa_bundle_t *
+bjxa_bundle(const char *path)
+{
+	bjxa_bundle_t *bundle;
+	struct stat st;
+	void *map;
+	int fd, err;
+
+	if (path == NULL) {
+		errno = EFAULT;
+		return (NULL);
+	}
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return (NULL);
+
+	if (fstat(fd, &st) < 0) {
+		err = errno;
+		(void)close(fd);
+		errno = err;
+		return (NULL);
+	}
+
+	if (st.st_size < BJXA_BUNDLE_HEADER ||
+	    (uint64_t)st.st_size > SIZE_MAX) {
+		(void)close(fd);
+		errno = EPROTO;
+		return (NULL);
+	}
+
+	/* the mapping outlives the file descriptor */
+	map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	err = errno;
+	(void)close(fd);
+	if (map == MAP_FAILED) {
+		errno = err;
+		return (NULL);
+	}
+
+	ALLOC_OBJ(bundle, BJXA_BUNDLE_MAGIC);
+	if (bundle == NULL) {
+		(void)munmap(map, (size_t)st.st_size);
+		errno = ENOMEM;
+		return (NULL);
+	}
+
+	bundle->map = map;
+	bundle->len = (size_t)st.st_size;
+
+	if (bjxa_bundle_check(bundle) < 0) {
+		(void)munmap(map, bundle->len);
+		FREE_OBJ(bundle);
+		errno = EPROTO;
+		return (NULL);
+	}
+
+	return (bundle);
+}
+
+int
+bjxa_free_bundle(bjxa_bundle_t **bundlep)
+{
+	bjxa_bundle_t *bundle;
+	void *map;
+
+	TAKE_OBJ(bundle, bundlep, BJXA_BUNDLE_MAGIC);
+	map = (void *)(uintptr_t)bundle->map;
+	(void)munmap(map, bundle->len);
+	FREE_OBJ(bundle);
+	return (0);
+}
+
+int
+bjxa_bundle_entry(bjxa_bundle_t *bundle, uint32_t index, bjxa_entry_t *ent)
+{
+	const uint8_t *buf;
+	uint32_t offset, length, name;
+	uint8_t bits, channels;
+
+	CHECK_OBJ(bundle, BJXA_BUNDLE_MAGIC);
+	CHECK_PTR(ent);
+	BJXA_COND_CHECK(index < bundle->entries, EINVAL);
+
+	buf = bundle->index + (size_t)index * BJXA_BUNDLE_ENTRY + 8;
+	offset = mread_le32(&buf);
+	length = mread_le32(&buf);
+	name = mread_le32(&buf);
+
+	ent->name = (const char *)bundle->map + name;
+	ent->xa = bundle->map + offset;
+	ent->xa_len = length;
+
+	/* the same format as bjxa_decode_format() */
+	ent->fmt.data_len_pcm = mread_le32(&buf);
+	ent->fmt.blocks = mread_le32(&buf);
+	ent->fmt.samples_rate = mread_le16(&buf);
+	bits = mread_le8(&buf);
+	channels = mread_le8(&buf);
+	ent->fmt.sample_bits = 16;
+	ent->fmt.channels = channels;
+	ent->fmt.block_size_xa = (uint8_t)((bits * 4 + 1) * channels);
+	ent->fmt.block_size_pcm = (uint8_t)(BJXA_BLOCK_SAMPLES * channels *
+	    sizeof(int16_t));
+	return (0);
+}
+
+int
+bjxa_bundle_find(bjxa_bundle_t *bundle, const char *name, bjxa_entry_t *ent)
+{
+	const uint8_t *buf;
+	uint64_t hash, ent_hash;
+	uint32_t mask, slot, index, probes;
+
+	CHECK_OBJ(bundle, BJXA_BUNDLE_MAGIC);
+	CHECK_PTR(name);
+	CHECK_PTR(ent);
+
+	hash = bjxa_bundle_hash(name);
+	mask = bundle->slots - 1;
+	slot = (uint32_t)hash & mask;
+
+	/* linear probing, the table always has empty slots */
+	for (probes = 0; probes < bundle->slots; probes++) {
+		buf = bundle->table + (size_t)slot * BJXA_BUNDLE_SLOT;
+		index = mread_le32(&buf);
+		if (index == 0)
+			break;
+		index--;
+
+		buf = bundle->index + (size_t)index * BJXA_BUNDLE_ENTRY;
+		ent_hash = mread_le32(&buf);
+		ent_hash |= (uint64_t)mread_le32(&buf) << 32;
+		if (ent_hash == hash) {
+			BJXA_TRY(bjxa_bundle_entry(bundle, index, ent));
+			if (!strcmp(ent->name, name))
+				return ((int)index);
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	errno = ENOENT;
+	return (-1);
+}
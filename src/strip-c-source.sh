@@ -12,7 +12,7 @@ strip_source() {
 		strip == 1 { strip = 0 }
 		license == 1 { license = 0 }
 		$0 == "/* end strip */" { strip = 1 }
-		$1 == "*/" && license = 2 { license = 1 }
+		$1 == "*/" && license == 2 { license = 1 }
 	'
 }
 
@@ -0,0 +1,109 @@
+#!/bin/sh
+#
+# Copyright (C) 2020  Dridi Boukelmoune
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+. "$(dirname "$0")"/test_setup.sh
+
+mkdir -p "$WORK_DIR"/in/sub
+cp "$TEST_DIR"/square-mono-4.xa "$TEST_DIR"/square-stereo-8.xa \
+	"$WORK_DIR"/in
+cp "$TEST_DIR"/square-mono-6.xa "$WORK_DIR"/in/sub
+cp "$TEST_DIR"/square-mono.wav "$WORK_DIR"/in/sub
+
+_ ----------------
+_ Decode directory
+_ ----------------
+
+expect_success "^files: 3$" bjxa batch decode --jobs 2 "$WORK_DIR"/in
+
+expect_sha1 "4b10d39db9abfb75bb3561d7a789ca5afb046c75" \
+	cat "$WORK_DIR"/in/square-stereo-8.wav
+
+expect_sha1 "ce3991eda98db098e45e876944d8324302726a66" \
+	cat "$WORK_DIR"/in/sub/square-mono-6.wav
+
+_ -----------
+_ Mirror tree
+_ -----------
+
+expect_success "^failed: 0$" bjxa batch decode --output "$WORK_DIR"/out \
+	"$WORK_DIR"/in/
+
+expect_sha1 "ce3991eda98db098e45e876944d8324302726a66" \
+	cat "$WORK_DIR"/out/sub/square-mono-6.wav
+
+_ ---------
+_ File list
+_ ---------
+
+echo "$WORK_DIR"/in/sub/square-mono.wav >"$WORK_DIR"/list
+
+expect_success "^files: 1$" bjxa batch encode --bits 4 "$WORK_DIR"/list
+
+bjxa encode --bits 4 "$TEST_DIR"/square-mono.wav "$WORK_DIR"/mono-4.xa
+
+cmp "$WORK_DIR"/mono-4.xa "$WORK_DIR"/in/sub/square-mono.xa
+
+expect_success "^files: 1$" sh -c 'bjxa batch encode -' <"$WORK_DIR"/list
+
+_ ----------------
+_ Asynchronous I/O
+_ ----------------
+
+expect_success "^backend: stdio$" bjxa batch decode "$WORK_DIR"/in
+
+expect_success "^failed: 0$" bjxa batch decode --io-uring \
+	--output "$WORK_DIR"/uring "$WORK_DIR"/in
+
+expect_sha1 "4b10d39db9abfb75bb3561d7a789ca5afb046c75" \
+	cat "$WORK_DIR"/uring/square-stereo-8.wav
+
+expect_sha1 "ce3991eda98db098e45e876944d8324302726a66" \
+	cat "$WORK_DIR"/uring/sub/square-mono-6.wav
+
+expect_success "^backend: stdio$" bjxa batch encode --io-uring \
+	--output "$WORK_DIR"/uring "$WORK_DIR"/in
+
+_ --------------
+_ Invalid inputs
+_ --------------
+
+echo junk >"$WORK_DIR"/in/junk.xa
+
+expect_error "junk.xa: failed" bjxa batch decode "$WORK_DIR"/in
+
+test ! -e "$WORK_DIR"/in/junk.wav
+
+expect_error "junk.xa: failed" bjxa batch decode --io-uring "$WORK_DIR"/in
+
+test ! -e "$WORK_DIR"/in/junk.wav
+
+expect_error "nonexistent" bjxa batch decode "$WORK_DIR"/nonexistent
+
+# a list may not escape the output directory
+printf '%s\n' ../square-mono-4.xa square-mono-6.xa >"$WORK_DIR"/unsafe
+
+if (cd "$WORK_DIR"/in/sub &&
+	bjxa batch decode --output ../../safe ../../unsafe) \
+	>"$WORK_DIR"/unsafe.out 2>"$WORK_DIR"/unsafe.err
+then
+	false
+fi
+
+grep "^failed: 1$" "$WORK_DIR"/unsafe.out
+grep "square-mono-4.xa: unsafe path" "$WORK_DIR"/unsafe.err
+test ! -e "$WORK_DIR"/square-mono-4.wav
+test -e "$WORK_DIR"/safe/square-mono-6.wav
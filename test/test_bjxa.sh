@@ -86,3 +86,56 @@ expect_error "Missing number of bits per sample" bjxa encode --bits
 expect_error "Invalid number of bits per sample" bjxa encode --bits 5
 
 expect_error "Invalid number of bits per sample" bjxa encode --bits 8001
+
+expect_error "Unknown option" bjxa encode --jnk
+
+expect_error "Unknown option" bjxa decode --jnk
+
+_ -----------------
+_ Compare arguments
+_ -----------------
+
+expect_error "Missing arguments" bjxa compare
+
+expect_error "Missing arguments" bjxa compare "$TEST_DIR"/square-mono-4.xa
+
+expect_error "Too many arguments" bjxa compare a b c
+
+expect_error "Unknown option" bjxa compare --jnk
+
+expect_error "Missing number of worst blocks" bjxa compare --worst
+
+expect_error "Invalid number of worst blocks" bjxa compare --worst 0
+
+expect_error "Invalid number of worst blocks" bjxa compare --worst 65536
+
+expect_error "Error:" bjxa compare "$WORK_DIR"/nonexistent.xa \
+	"$TEST_DIR"/square-mono.wav
+
+expect_error "Error:" bjxa compare "$TEST_DIR"/square-mono-4.xa \
+	"$WORK_DIR"/nonexistent.wav
+
+_ ---------------
+_ Batch arguments
+_ ---------------
+
+expect_error "Missing batch action" bjxa batch
+
+expect_error "Unknown batch action" bjxa batch compare
+
+expect_error "Missing arguments" bjxa batch decode
+
+expect_error "Too many arguments" bjxa batch decode a b
+
+expect_error "Unknown option" bjxa batch decode --bits 4 a
+
+expect_error "Unknown option" bjxa batch encode --jnk a
+
+expect_error "Missing number of jobs" bjxa batch decode --jobs
+
+expect_error "Invalid number of jobs" bjxa batch decode --jobs 0 a
+
+expect_error "Missing output directory" bjxa batch decode --output
+
+expect_error "Invalid number of bits per sample" \
+	bjxa batch encode --bits 5 a
@@ -0,0 +1,88 @@
+#!/bin/sh
+#
+# Copyright (C) 2020  Dridi Boukelmoune
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+. "$(dirname "$0")"/test_setup.sh
+
+mkdir -p "$WORK_DIR"/in/sub
+cp "$TEST_DIR"/square-mono-4.xa "$TEST_DIR"/square-stereo-8.xa \
+	"$WORK_DIR"/in
+cp "$TEST_DIR"/square-stereo-6.xa "$WORK_DIR"/in/sub
+
+_ -----------
+_ Pack bundle
+_ -----------
+
+(
+	cd "$WORK_DIR"/in
+	bjxa pack ../all.bjxb square-mono-4.xa ./square-stereo-8.xa \
+		sub/square-stereo-6.xa
+)
+
+test -s "$WORK_DIR"/all.bjxb
+
+expect_error "duplicate name" bjxa pack "$WORK_DIR"/dup.bjxb \
+	"$TEST_DIR"/square-mono-4.xa "$TEST_DIR"/square-mono-4.xa
+
+test ! -e "$WORK_DIR"/dup.bjxb
+
+_ -------------
+_ Unpack bundle
+_ -------------
+
+bjxa unpack "$WORK_DIR"/all.bjxb "$WORK_DIR"/out
+
+cmp "$WORK_DIR"/in/square-mono-4.xa "$WORK_DIR"/out/square-mono-4.xa
+cmp "$WORK_DIR"/in/square-stereo-8.xa "$WORK_DIR"/out/square-stereo-8.xa
+cmp "$WORK_DIR"/in/sub/square-stereo-6.xa \
+	"$WORK_DIR"/out/sub/square-stereo-6.xa
+
+_ -----------------------
+_ Decode from the mapping
+_ -----------------------
+
+bjxa unpack --decode "$WORK_DIR"/all.bjxb "$WORK_DIR"/wav
+
+expect_sha1 "4b10d39db9abfb75bb3561d7a789ca5afb046c75" \
+	cat "$WORK_DIR"/wav/square-stereo-8.wav
+
+bjxa decode "$TEST_DIR"/square-stereo-6.xa "$WORK_DIR"/stereo-6.wav
+
+cmp "$WORK_DIR"/stereo-6.wav "$WORK_DIR"/wav/sub/square-stereo-6.wav
+
+_ --------------
+_ Invalid inputs
+_ --------------
+
+expect_error "Protocol error" bjxa unpack "$TEST_DIR"/square-mono-4.xa \
+	"$WORK_DIR"/junk
+
+expect_error "square-mono.wav" bjxa pack "$WORK_DIR"/junk.bjxb \
+	"$TEST_DIR"/square-mono.wav
+
+head -c 1000 "$WORK_DIR"/all.bjxb >"$WORK_DIR"/short.bjxb
+
+expect_error "Protocol error" bjxa unpack "$WORK_DIR"/short.bjxb \
+	"$WORK_DIR"/junk
+
+expect_error "Missing arguments" bjxa pack "$WORK_DIR"/junk.bjxb
+
+(
+	cd "$WORK_DIR"/out
+	bjxa pack ../evil.bjxb ../in/square-mono-4.xa
+)
+
+expect_error "unsafe name" bjxa unpack "$WORK_DIR"/evil.bjxb "$WORK_DIR"/out
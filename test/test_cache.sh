@@ -0,0 +1,102 @@
+#!/bin/sh
+#
+# Copyright (C) 2020  Dridi Boukelmoune
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+. "$(dirname "$0")"/test_setup.sh
+
+CACHE_DIR=$WORK_DIR/cache
+
+cache_entries() {
+	find "$CACHE_DIR" -name '*.xa' | wc -l | tr -d ' '
+}
+
+_ ----------
+_ Cache miss
+_ ----------
+
+bjxa encode "$TEST_DIR"/square-mono.wav "$WORK_DIR"/ref.xa
+bjxa encode --cache "$CACHE_DIR" "$TEST_DIR"/square-mono.wav \
+	"$WORK_DIR"/miss.xa
+cmp "$WORK_DIR"/ref.xa "$WORK_DIR"/miss.xa
+test "$(cache_entries)" = 1
+
+entry=$(find "$CACHE_DIR" -name '*.xa')
+cmp "$WORK_DIR"/ref.xa "$entry"
+
+# other options are other entries
+bjxa encode --bits 4 --cache "$CACHE_DIR" <"$TEST_DIR"/square-mono.wav \
+	>"$WORK_DIR"/miss-4.xa
+bjxa encode --bits 4 "$TEST_DIR"/square-mono.wav "$WORK_DIR"/ref-4.xa
+cmp "$WORK_DIR"/ref-4.xa "$WORK_DIR"/miss-4.xa
+test "$(cache_entries)" = 2
+
+_ ---------
+_ Cache hit
+_ ---------
+
+# a cached file is copied as-is, even when it was tampered with
+cp "$TEST_DIR"/square-mono-8.xa "$entry"
+
+bjxa encode --cache "$CACHE_DIR" "$TEST_DIR"/square-mono.wav \
+	"$WORK_DIR"/hit.xa
+cmp "$TEST_DIR"/square-mono-8.xa "$WORK_DIR"/hit.xa
+cp "$WORK_DIR"/ref.xa "$entry"
+
+_ -------
+_ Pruning
+_ -------
+
+# the least recently used entry is evicted first
+touch -t 200001010000 "$entry"
+bjxa encode --bits 8 --cache "$CACHE_DIR" --cache-size 2 \
+	"$TEST_DIR"/square-stereo.wav "$WORK_DIR"/stereo-8.xa
+test ! -e "$entry"
+test "$(cache_entries)" = 2
+
+# until the cache fits, even without the latest entry
+bjxa encode --cache "$CACHE_DIR" --cache-size 1 \
+	"$TEST_DIR"/square-stereo.wav "$WORK_DIR"/stereo.xa
+test "$(cat "$CACHE_DIR"/*.xa | wc -c)" -le 1048576
+rm -f "$CACHE_DIR"/*.xa
+
+_ ------------
+_ Batch encode
+_ ------------
+
+mkdir -p "$WORK_DIR"/in
+cp "$TEST_DIR"/square-mono.wav "$TEST_DIR"/square-stereo.wav \
+	"$WORK_DIR"/in
+
+expect_success "^failed: 0$" bjxa batch encode --jobs 2 \
+	--cache "$CACHE_DIR" --output "$WORK_DIR"/out1 "$WORK_DIR"/in
+test "$(cache_entries)" = 2
+
+expect_success "^failed: 0$" bjxa batch encode --jobs 2 \
+	--cache "$CACHE_DIR" --output "$WORK_DIR"/out2 "$WORK_DIR"/in
+test "$(cache_entries)" = 2
+
+cmp "$WORK_DIR"/ref.xa "$WORK_DIR"/out2/square-mono.xa
+bjxa encode "$TEST_DIR"/square-stereo.wav "$WORK_DIR"/ref-stereo.xa
+cmp "$WORK_DIR"/ref-stereo.xa "$WORK_DIR"/out2/square-stereo.xa
+
+_ ---------------
+_ Invalid options
+_ ---------------
+
+expect_error "Missing cache directory" bjxa encode --cache
+expect_error "Invalid cache size" bjxa encode --cache-size 0
+expect_error "Unknown option" bjxa transcode --cache "$CACHE_DIR"
+expect_error "Unknown option" bjxa batch decode --cache "$CACHE_DIR"
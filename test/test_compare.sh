@@ -0,0 +1,75 @@
+#!/bin/sh
+#
+# Copyright (C) 2020  Dridi Boukelmoune
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+. "$(dirname "$0")"/test_setup.sh
+
+_ ------------
+_ 4 bit stereo
+_ ------------
+
+expect_success "^samples: 1323000$" bjxa compare \
+	"$TEST_DIR"/square-stereo-4.xa "$TEST_DIR"/square-stereo.wav
+
+expect_success "^snr: 22.20$" bjxa compare \
+	"$TEST_DIR"/square-stereo-4.xa "$TEST_DIR"/square-stereo.wav
+
+expect_success "^psnr: 28.33$" bjxa compare \
+	"$TEST_DIR"/square-stereo-4.xa "$TEST_DIR"/square-stereo.wav
+
+expect_success "^worst\[0\]: block 1969 error 4259$" bjxa compare \
+	--worst 2 "$TEST_DIR"/square-stereo-4.xa "$TEST_DIR"/square-stereo.wav
+
+expect_success "^worst\[1\]: block 0 error 3629$" bjxa compare \
+	--worst 2 "$TEST_DIR"/square-stereo-4.xa "$TEST_DIR"/square-stereo.wav
+
+_ ----------
+_ 8 bit mono
+_ ----------
+
+expect_success "^snr: 24.06$" bjxa compare \
+	"$TEST_DIR"/square-mono-8.xa "$TEST_DIR"/square-mono.wav
+
+expect_success "^peak_error: 1836$" bjxa compare \
+	"$TEST_DIR"/square-mono-8.xa "$TEST_DIR"/square-mono.wav
+
+_ --------------
+_ Decoded output
+_ --------------
+
+bjxa decode "$TEST_DIR"/square-mono-6.xa "$WORK_DIR"/square-mono-6.wav
+
+expect_success "^psnr: inf$" bjxa compare \
+	"$TEST_DIR"/square-mono-6.xa "$WORK_DIR"/square-mono-6.wav
+
+expect_success "^peak_error: 0$" bjxa compare \
+	"$TEST_DIR"/square-mono-6.xa "$WORK_DIR"/square-mono-6.wav
+
+_ ---------------
+_ Format mismatch
+_ ---------------
+
+expect_error "format mismatch" bjxa compare \
+	"$TEST_DIR"/square-mono-6.xa "$TEST_DIR"/square-stereo.wav
+
+_ -------------------
+_ Truncated reference
+_ -------------------
+
+head -c 1000044 "$TEST_DIR"/square-stereo.wav >"$WORK_DIR"/short.wav
+
+expect_error "WAV too short" bjxa compare \
+	"$TEST_DIR"/square-stereo-6.xa "$WORK_DIR"/short.wav
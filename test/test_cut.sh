@@ -0,0 +1,94 @@
+#!/bin/sh
+#
+# Copyright (C) 2020  Dridi Boukelmoune
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+. "$(dirname "$0")"/test_setup.sh
+
+_ -----------
+_ Cut streams
+_ -----------
+
+bjxa cut "$TEST_DIR"/square-mono-4.xa "$WORK_DIR"/full.xa
+cmp "$TEST_DIR"/square-mono-4.xa "$WORK_DIR"/full.xa
+
+bjxa cut --to 1001 "$TEST_DIR"/square-stereo-6.xa "$WORK_DIR"/head.xa
+bjxa cut --from 1001 <"$TEST_DIR"/square-stereo-6.xa >"$WORK_DIR"/tail.xa
+
+expect_success "head.xa,,6,2,44100,32032," bjxa info "$WORK_DIR"/head.xa
+expect_success "tail.xa,,6,2,44100,629468,19671,.*,4352,4352,23552,23552$" \
+	bjxa info "$WORK_DIR"/tail.xa
+
+# the tail decodes to the same samples as the original stream
+bjxa decode "$TEST_DIR"/square-stereo-6.xa "$WORK_DIR"/full.wav
+bjxa decode "$WORK_DIR"/tail.xa "$WORK_DIR"/tail.wav
+tail -c +$((44 + 1001 * 128 + 1)) "$WORK_DIR"/full.wav >"$WORK_DIR"/full.pcm
+tail -c +45 "$WORK_DIR"/tail.wav >"$WORK_DIR"/tail.pcm
+cmp "$WORK_DIR"/full.pcm "$WORK_DIR"/tail.pcm
+
+_ -----------
+_ Loop points
+_ -----------
+
+# 100 blocks of 32 samples with a loop point at sample 1000
+expect_success "square-loop-4.xa,,4,1,44100,3200,100,0.073,1000," \
+	bjxa info "$TEST_DIR"/square-loop-4.xa
+
+bjxa cut "$TEST_DIR"/square-loop-4.xa "$WORK_DIR"/loop.xa
+cmp "$TEST_DIR"/square-loop-4.xa "$WORK_DIR"/loop.xa
+
+bjxa cut --from 10 "$TEST_DIR"/square-loop-4.xa "$WORK_DIR"/loop.xa
+expect_success "loop.xa,,4,1,44100,2880,90,0.065,680," \
+	bjxa info "$WORK_DIR"/loop.xa
+
+bjxa cut --from 40 "$TEST_DIR"/square-loop-4.xa "$WORK_DIR"/loop.xa
+expect_success "loop.xa,,4,1,44100,1920,60,0.044,0," \
+	bjxa info "$WORK_DIR"/loop.xa
+
+bjxa cut --to 20 "$TEST_DIR"/square-loop-4.xa "$WORK_DIR"/loop.xa
+expect_success "loop.xa,,4,1,44100,640,20,0.015,0," \
+	bjxa info "$WORK_DIR"/loop.xa
+
+_ --------------
+_ Concat streams
+_ --------------
+
+bjxa concat "$WORK_DIR"/join.xa "$WORK_DIR"/head.xa "$WORK_DIR"/tail.xa
+cmp "$TEST_DIR"/square-stereo-6.xa "$WORK_DIR"/join.xa
+
+bjxa cut --from 100 --to 200 "$TEST_DIR"/square-mono-8.xa \
+	"$WORK_DIR"/part.xa
+bjxa concat - "$WORK_DIR"/part.xa "$WORK_DIR"/part.xa \
+	"$TEST_DIR"/square-mono-8.xa >"$WORK_DIR"/parts.xa
+
+expect_success "parts.xa,,8,1,44100,667900,20872," \
+	bjxa info "$WORK_DIR"/parts.xa
+
+_ --------------
+_ Invalid inputs
+_ --------------
+
+expect_error "invalid range" bjxa cut --from 10 --to 10 \
+	"$TEST_DIR"/square-mono-4.xa "$WORK_DIR"/empty.xa
+expect_error "invalid range" bjxa cut --to 20673 \
+	"$TEST_DIR"/square-mono-4.xa "$WORK_DIR"/empty.xa
+expect_error "Invalid first block" bjxa cut --from -1
+expect_error "Missing last block" bjxa cut --to
+
+expect_error "can't be joined" bjxa concat "$WORK_DIR"/bad.xa \
+	"$TEST_DIR"/square-mono-4.xa "$TEST_DIR"/square-stereo-4.xa
+expect_error "can't be joined" bjxa concat "$WORK_DIR"/bad.xa \
+	"$TEST_DIR"/square-mono-4.xa "$TEST_DIR"/square-mono-4.xa
+expect_error "Missing arguments" bjxa concat "$WORK_DIR"/bad.xa
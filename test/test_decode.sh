@@ -120,3 +120,96 @@ EOF
 
 expect_sha1 "56ba3f62bf27ac9fd19cd97bcda06b4db327e612" \
 	bjxa decode <"$WORK_DIR"/bin
+
+_ ----------
+_ Statistics
+_ ----------
+
+expect_sha1 "56ba3f62bf27ac9fd19cd97bcda06b4db327e612" \
+	bjxa decode --stats <"$WORK_DIR"/bin
+
+expect_success "^blocks: 1$" \
+	sh -c 'bjxa decode --stats 2>&1 >/dev/null' <"$WORK_DIR"/bin
+
+expect_success "^factor\[2\]: 2$" \
+	sh -c 'bjxa decode --stats 2>&1 >/dev/null' <"$WORK_DIR"/bin
+
+expect_success "^clamps: [1-9]" \
+	sh -c 'bjxa decode --stats 2>&1 >/dev/null' <"$WORK_DIR"/bin
+
+_ ---------------
+_ Digital silence
+_ ---------------
+
+# Zero samples are only silent without a gain factor, or with a silent
+# predictor state. The left channel of the second block decays from the
+# state left by the first block.
+
+mk_hex <<EOF
+4b574431 | KWD1 (id)
+66000000 | 102 (nDataLen)
+60000000 | 96 (nSamples)
+44ac     | 44100 (nSamplesPerSec)
+04       | 4 (nBits)
+02       | 2 (nChannels)
+00000000 | 0 (nLoopPtr)
+0000     | 0 (befL[0])
+0000     | 0 (befL[1])
+0000     | 0 (befR[0])
+0000     | 0 (befR[1])
+00000000 | 0 (pad)
+20       | left profile (high gain, low range)
+77777777 | left data
+77777777 | left data
+77777777 | left data
+77777777 | left data
+00       | right profile (no gain)
+00000000 | right data
+00000000 | right data
+00000000 | right data
+00000000 | right data
+20       | left profile, silent data but a predictor state
+00000000 | left data
+00000000 | left data
+00000000 | left data
+00000000 | left data
+30       | right profile, silent data and predictor state
+00000000 | right data
+00000000 | right data
+00000000 | right data
+00000000 | right data
+00       | left profile (no gain)
+00000000 | left data
+00000000 | left data
+00000000 | left data
+00000000 | left data
+40       | right profile, silent data and predictor state
+00000000 | right data
+00000000 | right data
+00000000 | right data
+00000000 | right data
+EOF
+
+expect_sha1 "f23db970103ad59b2162a190d27dcf98bd5bebf8" \
+	bjxa decode <"$WORK_DIR"/bin
+
+expect_success "^silent: 4$" \
+	sh -c 'bjxa decode --stats 2>&1 >/dev/null' <"$WORK_DIR"/bin
+
+_ --------------
+_ Channel mixing
+_ --------------
+
+expect_sha1 "d8461eeaf61313263e5f896d6eff2aaf1dbd6e17" \
+	bjxa decode --mix left "$TEST_DIR"/square-stereo-6.xa
+
+expect_sha1 "a998ab035ef394fa01424ce9508022fe0dfd0b71" \
+	bjxa decode --mix right <"$TEST_DIR"/square-stereo-6.xa
+
+expect_sha1 "2450ce7146b03a5d9b9f6f48adf58eaa0d057c86" \
+	bjxa decode --stats --mix mono "$TEST_DIR"/square-stereo-6.xa
+
+expect_error "Invalid argument" \
+	bjxa decode --mix mono "$TEST_DIR"/square-mono-6.xa
+expect_error "Invalid channel mix" bjxa decode --mix both
+expect_error "Missing channel mix" bjxa decode --mix
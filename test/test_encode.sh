@@ -0,0 +1,309 @@
+#!/bin/sh
+#
+# Copyright (C) 2020  Dridi Boukelmoune
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+. "$(dirname "$0")"/test_setup.sh
+
+_ ------------
+_ 8 bit stereo
+_ ------------
+
+expect_sha1 "d7702c45e627ff22430edad3b16125844bc53637" \
+	cat <"$TEST_DIR"/square-stereo.wav
+
+expect_sha1 "1d34cf95cf518dde306175fffded026c1295112f" \
+	bjxa encode --bits 8 <"$TEST_DIR"/square-stereo.wav
+
+_ ----------
+_ 8 bit mono
+_ ----------
+
+expect_sha1 "b2621a223e53be1d8fadd135ddf939936be82e20" \
+	cat <"$TEST_DIR"/square-mono.wav
+
+expect_sha1 "82d39ab8e3ee1d5832afcff3c9e5bd35b708f014" \
+	bjxa encode --bits 8 <"$TEST_DIR"/square-mono.wav
+
+_ ------------
+_ 6 bit stereo
+_ ------------
+
+expect_sha1 "76779e51d6ee5e45ac673bb81751c9f83588e2bf" \
+	bjxa encode --bits 6 <"$TEST_DIR"/square-stereo.wav
+
+_ ----------
+_ 6 bit mono
+_ ----------
+
+expect_sha1 "ce97d26d4e0f4a93fbf2883c56a1607ecc543bea" \
+	bjxa encode --bits 6 <"$TEST_DIR"/square-mono.wav
+
+_ ------------
+_ 4 bit stereo
+_ ------------
+
+expect_sha1 "d525f1818f6913ee408d2dfb194c75cb62010160" \
+	bjxa encode --bits 4 <"$TEST_DIR"/square-stereo.wav
+
+_ ----------
+_ 4 bit mono
+_ ----------
+
+expect_sha1 "422af2b8247caaff011c3a925e7735c4c4e09fc7" \
+	bjxa encode --bits 4 <"$TEST_DIR"/square-mono.wav
+
+
+_ -----------------------
+_ Streaming WAV from pipe
+_ -----------------------
+
+mk_hex <<EOF
+52494646 | RIFF (id)
+ffffffff | unknown (size)
+57415645 | WAVE (format)
+666d7420 | fmt (id)
+10000000 | 16 (size)
+0100     | 1 (audio format)
+0100     | 1 (channels)
+44ac0000 | 44100 (sample rate)
+88580100 | 88200 (byte rate)
+0200     | 2 (block align)
+1000     | 16 (bits per sample)
+64617461 | data (id)
+ffffffff | unknown (size)
+EOF
+
+cat "$WORK_DIR"/bin >"$WORK_DIR"/stream.wav
+tail -c +45 "$TEST_DIR"/square-mono.wav >>"$WORK_DIR"/stream.wav
+
+expect_sha1 "ce97d26d4e0f4a93fbf2883c56a1607ecc543bea" \
+	sh -c 'cat | bjxa encode | cat' <"$WORK_DIR"/stream.wav
+
+_ -----------------------
+_ Streaming WAV to a file
+_ -----------------------
+
+bjxa encode --bits 4 - "$WORK_DIR"/stream.xa <"$WORK_DIR"/stream.wav
+
+expect_sha1 "422af2b8247caaff011c3a925e7735c4c4e09fc7" \
+	cat "$WORK_DIR"/stream.xa
+
+_ -------------------
+_ Empty streaming WAV
+_ -------------------
+
+expect_error "bjxa_fwrite_header" bjxa encode <"$WORK_DIR"/bin
+
+# no header placeholder is left in a seekable output
+expect_error "bjxa_fwrite_header" bjxa encode - "$WORK_DIR"/empty.xa \
+	<"$WORK_DIR"/bin
+test ! -s "$WORK_DIR"/empty.xa
+
+_ --------------------
+_ Non-canonical chunks
+_ --------------------
+
+mk_hex <<EOF
+52494646 | RIFF (id)
+ffffffff | unknown (size)
+57415645 | WAVE (format)
+4c495354 | LIST (id)
+0b000000 | 11 (size)
+494e464f | INFO (list type)
+6a6e6b00 | junk
+6a6e6b   | junk
+00       | pad byte
+666d7420 | fmt (id)
+28000000 | 40 (size)
+feff     | 65534 (audio format, extensible)
+0100     | 1 (channels)
+44ac0000 | 44100 (sample rate)
+88580100 | 88200 (byte rate)
+0200     | 2 (block align)
+1000     | 16 (bits per sample)
+1600     | 22 (extension size)
+1000     | 16 (valid bits per sample)
+04000000 | 4 (channel mask, front center)
+0100     | 1 (sub-format, PCM)
+00000000 | sub-format GUID
+10008000 | sub-format GUID
+00aa0038 | sub-format GUID
+9b71     | sub-format GUID
+66616374 | fact (id)
+04000000 | 4 (size)
+fc170a00 | 661500 (samples)
+64617461 | data (id)
+f82f1400 | 1323000 (size)
+EOF
+
+cat "$WORK_DIR"/bin >"$WORK_DIR"/chunks.wav
+tail -c +45 "$TEST_DIR"/square-mono.wav >>"$WORK_DIR"/chunks.wav
+
+expect_sha1 "ce97d26d4e0f4a93fbf2883c56a1607ecc543bea" \
+	bjxa encode <"$WORK_DIR"/chunks.wav
+
+expect_sha1 "ce97d26d4e0f4a93fbf2883c56a1607ecc543bea" \
+	sh -c 'cat | bjxa encode' <"$WORK_DIR"/chunks.wav
+
+_ -------------------
+_ 24 bits PCM samples
+_ -------------------
+
+mk_hex <<EOF
+52494646 | RIFF (id)
+18481e00 | 1984536 (size)
+57415645 | WAVE (format)
+666d7420 | fmt (id)
+10000000 | 16 (size)
+0100     | 1 (audio format, PCM)
+0100     | 1 (channels)
+44ac0000 | 44100 (sample rate)
+cc040200 | 132300 (byte rate)
+0300     | 3 (block align)
+1800     | 24 (bits per sample)
+64617461 | data (id)
+f4471e00 | 1984500 (size)
+EOF
+
+# widen 16 bits samples, the encoder should round them back
+cat "$WORK_DIR"/bin >"$WORK_DIR"/24bits.wav
+tail -c +45 "$TEST_DIR"/square-mono.wav |
+"$XXD" -p -c2 |
+sed 's/^/00/' |
+"$XXD" -r -p >>"$WORK_DIR"/24bits.wav
+
+expect_sha1 "ce97d26d4e0f4a93fbf2883c56a1607ecc543bea" \
+	bjxa encode <"$WORK_DIR"/24bits.wav
+
+# dithering only changes the rounding of some samples
+expect_sha1 "ab96f472854f5260f09708f18750f6a70501882c" \
+	bjxa encode --dither <"$WORK_DIR"/24bits.wav
+
+_ ------------------
+_ 8 bits PCM samples
+_ ------------------
+
+mk_hex <<EOF
+52494646 | RIFF (id)
+20180a00 | 661536 (size)
+57415645 | WAVE (format)
+666d7420 | fmt (id)
+10000000 | 16 (size)
+0100     | 1 (audio format, PCM)
+0100     | 1 (channels)
+44ac0000 | 44100 (sample rate)
+44ac0000 | 44100 (byte rate)
+0100     | 1 (block align)
+0800     | 8 (bits per sample)
+64617461 | data (id)
+fc170a00 | 661500 (size)
+EOF
+
+# keep the most significant byte of 16 bits samples, and flip its sign bit,
+# 6 bits XA samples do not depend on the least significant byte
+cat "$WORK_DIR"/bin >"$WORK_DIR"/8bits.wav
+tail -c +45 "$TEST_DIR"/square-mono.wav |
+"$XXD" -p -c2 |
+sed 's/^..//; h; s/.$//; y/0123456789abcdef/89abcdef01234567/; G; s/\n.//' |
+"$XXD" -r -p >>"$WORK_DIR"/8bits.wav
+
+expect_sha1 "ce97d26d4e0f4a93fbf2883c56a1607ecc543bea" \
+	bjxa encode <"$WORK_DIR"/8bits.wav
+
+# 8 bits XA blocks are larger than their 8 bits PCM samples
+expect_sha1 "82d39ab8e3ee1d5832afcff3c9e5bd35b708f014" \
+	bjxa encode --bits 8 "$WORK_DIR"/8bits.wav
+
+_ ----------------
+_ Silence trimming
+_ ----------------
+
+mk_hex <<EOF
+52494646 | RIFF (id)
+ac311400 | 1323436 (size)
+57415645 | WAVE (format)
+666d7420 | fmt (id)
+10000000 | 16 (size)
+0100     | 1 (audio format, PCM)
+0100     | 1 (channels)
+44ac0000 | 44100 (sample rate)
+88580100 | 88200 (byte rate)
+0200     | 2 (block align)
+1000     | 16 (bits per sample)
+64617461 | data (id)
+88311400 | 1323400 (size)
+EOF
+
+# surround the samples with 100 silent samples on both sides
+cat "$WORK_DIR"/bin >"$WORK_DIR"/padded.wav
+head -c 200 /dev/zero >>"$WORK_DIR"/padded.wav
+tail -c +45 "$TEST_DIR"/square-mono.wav >>"$WORK_DIR"/padded.wav
+head -c 200 /dev/zero >>"$WORK_DIR"/padded.wav
+
+expect_sha1 "ce97d26d4e0f4a93fbf2883c56a1607ecc543bea" \
+	bjxa encode --trim-silence <"$WORK_DIR"/padded.wav
+
+expect_sha1 "ce97d26d4e0f4a93fbf2883c56a1607ecc543bea" \
+	sh -c 'cat | bjxa encode --trim-silence' <"$WORK_DIR"/padded.wav
+
+mk_hex <<EOF
+52494646 | RIFF (id)
+e8180a00 | 661736 (size)
+57415645 | WAVE (format)
+666d7420 | fmt (id)
+10000000 | 16 (size)
+0100     | 1 (audio format, PCM)
+0100     | 1 (channels)
+44ac0000 | 44100 (sample rate)
+44ac0000 | 44100 (byte rate)
+0100     | 1 (block align)
+0800     | 8 (bits per sample)
+64617461 | data (id)
+c4180a00 | 661700 (size)
+EOF
+
+# unsigned 8 bits silence
+cat "$WORK_DIR"/bin >"$WORK_DIR"/padded8.wav
+head -c 100 /dev/zero | tr '\0' '\200' >>"$WORK_DIR"/padded8.wav
+tail -c +45 "$WORK_DIR"/8bits.wav >>"$WORK_DIR"/padded8.wav
+head -c 100 /dev/zero | tr '\0' '\200' >>"$WORK_DIR"/padded8.wav
+
+expect_sha1 "ce97d26d4e0f4a93fbf2883c56a1607ecc543bea" \
+	bjxa encode --trim-silence <"$WORK_DIR"/padded8.wav
+
+mk_hex <<EOF
+52494646 | RIFF (id)
+a4000000 | 164 (size)
+57415645 | WAVE (format)
+666d7420 | fmt (id)
+10000000 | 16 (size)
+0100     | 1 (audio format, PCM)
+0100     | 1 (channels)
+44ac0000 | 44100 (sample rate)
+88580100 | 88200 (byte rate)
+0200     | 2 (block align)
+1000     | 16 (bits per sample)
+64617461 | data (id)
+80000000 | 128 (size)
+EOF
+
+# a silent file keeps a single sample
+cat "$WORK_DIR"/bin >"$WORK_DIR"/silent.wav
+head -c 128 /dev/zero >>"$WORK_DIR"/silent.wav
+
+bjxa encode --trim-silence "$WORK_DIR"/silent.wav "$WORK_DIR"/silent.xa
+
+expect_success "silent.xa,,6,1,44100,1,1," bjxa info "$WORK_DIR"/silent.xa
@@ -0,0 +1,165 @@
+#!/bin/sh
+#
+# Copyright (C) 2020  Dridi Boukelmoune
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+. "$(dirname "$0")"/test_setup.sh
+
+_ ----------
+_ Empty file
+_ ----------
+
+expect_error "bjxa_fread_riff_header" bjxa encode </dev/null
+
+_ ------------------
+_ Wrong magic number
+_ ------------------
+
+mk_hex <<EOF
+52494658 | RIFX (id)
+24000000 | 36 (size)
+57415645 | WAVE (format)
+666d7420 | fmt (id)
+10000000 | 16 (size)
+0100     | 1 (audio format)
+0100     | 1 (channels)
+44ac0000 | 44100 (sample rate)
+88580100 | 88200 (byte rate)
+0200     | 2 (block align)
+1000     | 16 (bits per sample)
+64617461 | data (id)
+00000000 | 0 (size)
+EOF
+
+expect_error "bjxa_fread_riff_header" bjxa encode <"$WORK_DIR"/bin
+
+_ --------------
+_ Missing format
+_ --------------
+
+mk_hex <<EOF
+52494646 | RIFF (id)
+24000000 | 36 (size)
+57415645 | WAVE (format)
+4c495354 | LIST (id)
+18000000 | 24 (size)
+494e464f | INFO (list type)
+6a6e6b6a | junk
+6e6b6a6e | junk
+6b6a6e6b | junk
+6a6e6b6a | junk
+6e6b6a6e | junk
+64617461 | data (id)
+00000000 | 0 (size)
+EOF
+
+expect_error "bjxa_fread_riff_header" bjxa encode <"$WORK_DIR"/bin
+
+_ ---------------
+_ Truncated chunk
+_ ---------------
+
+mk_hex <<EOF
+52494646 | RIFF (id)
+ffffffff | unknown (size)
+57415645 | WAVE (format)
+4c495354 | LIST (id)
+00010000 | 256 (size)
+494e464f | INFO (list type)
+EOF
+
+expect_error "bjxa_fread_riff_header" bjxa encode <"$WORK_DIR"/bin
+
+_ -------------------------
+_ Extensible non-PCM format
+_ -------------------------
+
+mk_hex <<EOF
+52494646 | RIFF (id)
+ffffffff | unknown (size)
+57415645 | WAVE (format)
+666d7420 | fmt (id)
+28000000 | 40 (size)
+feff     | 65534 (audio format, extensible)
+0100     | 1 (channels)
+44ac0000 | 44100 (sample rate)
+88580100 | 88200 (byte rate)
+0200     | 2 (block align)
+1000     | 16 (bits per sample)
+1600     | 22 (extension size)
+1000     | 16 (valid bits per sample)
+04000000 | 4 (channel mask, front center)
+0200     | 2 (sub-format, ADPCM)
+00000000 | sub-format GUID
+10008000 | sub-format GUID
+00aa0038 | sub-format GUID
+9b71     | sub-format GUID
+64617461 | data (id)
+ffffffff | unknown (size)
+EOF
+
+expect_error "bjxa_fread_riff_header" bjxa encode <"$WORK_DIR"/bin
+
+_ -------------------
+_ Duplicate fmt chunk
+_ -------------------
+
+mk_hex <<EOF
+52494646 | RIFF (id)
+ffffffff | unknown (size)
+57415645 | WAVE (format)
+666d7420 | fmt (id)
+10000000 | 16 (size)
+0100     | 1 (audio format)
+0100     | 1 (channels)
+44ac0000 | 44100 (sample rate)
+88580100 | 88200 (byte rate)
+0200     | 2 (block align)
+1000     | 16 (bits per sample)
+666d7420 | fmt (id)
+10000000 | 16 (size)
+0100     | 1 (audio format)
+0100     | 1 (channels)
+44ac0000 | 44100 (sample rate)
+88580100 | 88200 (byte rate)
+0200     | 2 (block align)
+1000     | 16 (bits per sample)
+64617461 | data (id)
+ffffffff | unknown (size)
+EOF
+
+expect_error "bjxa_fread_riff_header" bjxa encode <"$WORK_DIR"/bin
+
+_ ---------------------------
+_ 32 bits integer PCM samples
+_ ---------------------------
+
+mk_hex <<EOF
+52494646 | RIFF (id)
+ffffffff | unknown (size)
+57415645 | WAVE (format)
+666d7420 | fmt (id)
+10000000 | 16 (size)
+0100     | 1 (audio format, PCM)
+0100     | 1 (channels)
+44ac0000 | 44100 (sample rate)
+10b10200 | 176400 (byte rate)
+0400     | 4 (block align)
+2000     | 32 (bits per sample)
+64617461 | data (id)
+ffffffff | unknown (size)
+EOF
+
+expect_error "bjxa_fread_riff_header" bjxa encode <"$WORK_DIR"/bin
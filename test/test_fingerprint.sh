@@ -0,0 +1,76 @@
+#!/bin/sh
+#
+# Copyright (C) 2020  Dridi Boukelmoune
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+. "$(dirname "$0")"/test_setup.sh
+
+_ ----------
+_ Exact hash
+_ ----------
+
+expect_success "^path,error,samples,hash,fingerprint,duplicate$" \
+	bjxa fingerprint "$TEST_DIR"/square-mono-4.xa
+
+expect_success "square-mono-4.xa,,661500,bd3eda05e16c48a8,708e2256f27e9bbb,$" \
+	bjxa fingerprint "$TEST_DIR"/square-mono-4.xa
+
+# the loop point is ignored by the decoder
+cp "$TEST_DIR"/square-mono-4.xa "$WORK_DIR"/a.xa
+cp "$TEST_DIR"/square-mono-4.xa "$WORK_DIR"/b.xa
+printf '\001' |
+dd of="$WORK_DIR"/b.xa bs=1 seek=16 conv=notrunc 2>/dev/null
+if cmp -s "$WORK_DIR"/a.xa "$WORK_DIR"/b.xa
+then
+	false
+fi
+
+expect_success "b.xa,,661500,bd3eda05e16c48a8,.*,$WORK_DIR/a.xa$" \
+	bjxa fingerprint --distance 0 "$WORK_DIR"/b.xa "$WORK_DIR"/a.xa
+
+_ -----------------
+_ Perceptual prints
+_ -----------------
+
+# the same audio encoded with different bits sounds alike
+bjxa fingerprint --jobs 2 "$TEST_DIR" >"$WORK_DIR"/prints.csv
+grep "square-mono-4.xa,,.*,$" "$WORK_DIR"/prints.csv
+grep "square-mono-6.xa,,.*,$TEST_DIR/square-mono-4.xa$" "$WORK_DIR"/prints.csv
+grep "square-mono-8.xa,,.*,$TEST_DIR/square-mono-4.xa$" "$WORK_DIR"/prints.csv
+grep "square-stereo-4.xa,,.*,$" "$WORK_DIR"/prints.csv
+grep "square-stereo-8.xa,,.*,$TEST_DIR/square-stereo-4.xa$" \
+	"$WORK_DIR"/prints.csv
+
+bjxa fingerprint --distance 0 "$TEST_DIR" >"$WORK_DIR"/exact.csv
+test "$(grep -c ',$' "$WORK_DIR"/exact.csv)" -eq 7
+
+_ --------------
+_ Invalid inputs
+_ --------------
+
+head -c 100 "$TEST_DIR"/square-mono-4.xa >"$WORK_DIR"/short.xa
+
+if bjxa fingerprint "$TEST_DIR"/square-mono.wav "$WORK_DIR"/short.xa \
+	>"$WORK_DIR"/invalid.csv
+then
+	false
+fi
+
+grep "square-mono.wav,Protocol error,,,,$" "$WORK_DIR"/invalid.csv
+grep "short.xa,Protocol error,,,,$" "$WORK_DIR"/invalid.csv
+
+expect_error "Invalid distance" bjxa fingerprint --distance 65
+expect_error "Missing distance" bjxa fingerprint --distance
+expect_error "Missing arguments" bjxa fingerprint
@@ -0,0 +1,66 @@
+#!/bin/sh
+#
+# Copyright (C) 2020  Dridi Boukelmoune
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+. "$(dirname "$0")"/test_setup.sh
+
+_ ---------
+_ CSV index
+_ ---------
+
+expect_success "^path,error,bits,channels,samples_rate," \
+	bjxa info "$TEST_DIR"/square-mono-4.xa
+
+expect_success "square-stereo-8.xa,,8,2,44100,661500,20672,15.000,0,0,0,0,0$" \
+	bjxa info "$TEST_DIR"/square-stereo-8.xa
+
+expect_success "square-mono-6.xa,,6,1,.*,19614,137,920,1,0,0,$" \
+	bjxa info --jobs 2 --profiles "$TEST_DIR"
+
+_ ----------
+_ JSON index
+_ ----------
+
+expect_success '"factors": \[39228, 286, 1829, 1, 0\], "bad_profiles": 0}' \
+	bjxa info --json --profiles "$TEST_DIR"/square-stereo-4.xa
+
+_ ------------
+_ Bad profiles
+_ ------------
+
+cp "$TEST_DIR"/square-mono-4.xa "$WORK_DIR"/bad.xa
+printf '\120' |
+dd of="$WORK_DIR"/bad.xa bs=1 seek=$((32 + 17 * 10)) conv=notrunc 2>/dev/null
+
+if bjxa info --profiles "$WORK_DIR"/bad.xa >"$WORK_DIR"/bad.csv
+then
+	false
+fi
+
+grep ",1,10$" "$WORK_DIR"/bad.csv
+
+_ --------------
+_ Invalid inputs
+_ --------------
+
+if bjxa info "$TEST_DIR"/square-mono.wav >"$WORK_DIR"/wav.csv
+then
+	false
+fi
+
+grep "square-mono.wav,Protocol error," "$WORK_DIR"/wav.csv
+
+expect_error "Missing arguments" bjxa info
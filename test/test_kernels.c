@@ -0,0 +1,105 @@
+/*-
+ * Copyright (C) 2020  Dridi Boukelmoune
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Kernel equivalence.
+ *
+ * The kernels are static functions, so the library source is included
+ * directly. The SIMD kernels run on the same random blocks as the scalar
+ * kernels and must produce the same bytes, without writing past the end
+ * of the block. The test is skipped when no SIMD kernel can be selected.
+ */
+
+#ifdef NDEBUG
+#  undef NDEBUG
+#endif
+
+#define _DEFAULT_SOURCE
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libbjxa.c"
+
+#define KERNEL_BLOCKS	(1 << 16)
+#define KERNEL_GUARD	16
+#define KERNEL_SKIP	77
+
+#ifdef HAVE_SSSE3
+static uint32_t kernel_seed = 0x626a7861;
+
+static int16_t
+kernel_sample(void)
+{
+
+	/* xorshift32, reproducible across runs */
+	kernel_seed ^= kernel_seed << 13;
+	kernel_seed ^= kernel_seed >> 17;
+	kernel_seed ^= kernel_seed << 5;
+	return ((int16_t)(kernel_seed >> 16));
+}
+
+static void
+kernel_check(unsigned bits, bjxa_deflate_f *scalar, bjxa_deflate_f *simd)
+{
+	static const int16_t edges[] = { 0, 1, -1, INT16_MAX, INT16_MIN };
+	int16_t pcm[BJXA_BLOCK_SAMPLES];
+	uint8_t exp[32 + KERNEL_GUARD], got[32 + KERNEL_GUARD];
+	unsigned blk, n;
+
+	for (blk = 0; blk < KERNEL_BLOCKS; blk++) {
+		/* the first blocks are filled with edge values */
+		for (n = 0; n < BJXA_BLOCK_SAMPLES; n++)
+			pcm[n] = blk < 5 ? edges[(blk + n) % 5] :
+			    kernel_sample();
+
+		(void)memset(exp, 0xa5, sizeof exp);
+		(void)memset(got, 0xa5, sizeof got);
+		scalar(exp, pcm);
+		simd(got, pcm);
+
+		if (memcmp(exp, got, sizeof got) != 0) {
+			fprintf(stderr, "deflate %ubits: block %u differs\n",
+			    bits, blk);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	printf("deflate %ubits: %u blocks\n", bits, KERNEL_BLOCKS);
+}
+#endif
+
+int
+main(void)
+{
+
+#ifdef HAVE_SSSE3
+	if (__builtin_cpu_supports("ssse3")) {
+		kernel_check(4, bjxa_deflate_4bits, bjxa_deflate_4bits_ssse3);
+		kernel_check(6, bjxa_deflate_6bits, bjxa_deflate_6bits_ssse3);
+		kernel_check(8, bjxa_deflate_8bits, bjxa_deflate_8bits_ssse3);
+		return (EXIT_SUCCESS);
+	}
+#endif
+
+	return (KERNEL_SKIP);
+}
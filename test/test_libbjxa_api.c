@@ -277,6 +277,1348 @@ ADD_TEST_CASE(pcm_samples_dumping)
 	assert(errno == EBADF);
 }
 
+ADD_TEST_CASE(seeking)
+{
+	bjxa_decoder_t *dec;
+	bjxa_format_t fmt;
+	FILE *file;
+	uint8_t *xa;
+	int16_t *pcm, *pcm_seek;
+	size_t pcm_len, xa_len, off;
+	void *junk;
+	int blocks, skip;
+
+	dec = bjxa_decoder();
+	assert(dec != NULL);
+
+	junk = strdup(random_junk);
+	assert(junk != NULL);
+
+	assert(bjxa_decode_sync(NULL, src_buf, sizeof src_buf) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_decode_sync(junk, src_buf, sizeof src_buf) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_decode_sync(dec, src_buf, sizeof src_buf) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_decode_seek(NULL, 0) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_decode_seek(junk, 0) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_decode_seek(dec, 0) == -1);
+	assert(errno == EINVAL);
+
+	file = fopen("test/square-stereo-4.xa", "r");
+	assert(file != NULL);
+	assert(bjxa_fread_header(dec, file) > 0);
+	assert(bjxa_decode_format(dec, &fmt) == 0);
+
+	assert(bjxa_decode_sync(dec, NULL, sizeof src_buf) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_decode_sync(dec, src_buf, 0) == -1);
+	assert(errno == ENOBUFS);
+
+	assert(bjxa_decode_seek(dec, fmt.blocks) == -1);
+	assert(errno == EINVAL);
+
+	xa_len = fmt.blocks * fmt.block_size_xa;
+	pcm_len = fmt.data_len_pcm;
+	xa = malloc(xa_len);
+	pcm = malloc(pcm_len);
+	pcm_seek = malloc(pcm_len);
+	assert(xa != NULL);
+	assert(pcm != NULL);
+	assert(pcm_seek != NULL);
+	assert(fread(xa, xa_len, 1, file) == 1);
+
+	assert(bjxa_decode(dec, pcm, pcm_len, xa, xa_len) ==
+	    (int)fmt.blocks);
+
+	/* resume from a sync block past the first half of the stream */
+	skip = (int)fmt.blocks / 2;
+	off = skip * fmt.block_size_xa;
+	blocks = bjxa_decode_sync(dec, xa + off, xa_len - off);
+	assert(blocks >= 0);
+	assert(blocks < (int)fmt.blocks - skip);
+	skip += blocks;
+	assert((xa[skip * fmt.block_size_xa] >> 4) == 0);
+
+	assert(bjxa_decode_seek(dec, skip) == 0);
+	off = skip * fmt.block_size_xa;
+	assert(bjxa_decode(dec, pcm_seek, pcm_len, xa + off, xa_len - off) ==
+	    (int)fmt.blocks - skip);
+	off = skip * fmt.block_size_pcm;
+	assert(!memcmp((uint8_t *)pcm + off, pcm_seek, pcm_len - off));
+
+	/* rewind to the beginning of the stream */
+	assert(bjxa_decode_seek(dec, 0) == 0);
+	assert(bjxa_decode(dec, pcm_seek, pcm_len, xa, xa_len) ==
+	    (int)fmt.blocks);
+	assert(!memcmp(pcm, pcm_seek, pcm_len));
+
+	assert(bjxa_free_decoder(&dec) == 0);
+	assert(dec == NULL);
+	free(junk);
+	free(xa);
+	free(pcm);
+	free(pcm_seek);
+	assert(fclose(file) == 0);
+}
+
+ADD_TEST_CASE(peaks)
+{
+	bjxa_decoder_t *dec;
+	bjxa_format_t fmt;
+	bjxa_peak_t *peaks, *ref;
+	FILE *file;
+	uint8_t *xa;
+	int16_t *pcm;
+	uint64_t squares, mean;
+	size_t pcm_len, xa_len, chunk, off, samples, len, n, m;
+	ssize_t res;
+	void *junk;
+	unsigned chan;
+
+	dec = bjxa_decoder();
+	assert(dec != NULL);
+
+	junk = strdup(random_junk);
+	assert(junk != NULL);
+
+	assert(bjxa_decode_window(NULL, 100) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_decode_window(junk, 100) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_decode_window(dec, 100) == -1);
+	assert(errno == EINVAL);
+
+	file = fopen("test/square-stereo-4.xa", "r");
+	assert(file != NULL);
+	assert(bjxa_fread_header(dec, file) > 0);
+	assert(bjxa_decode_format(dec, &fmt) == 0);
+
+	assert(bjxa_decode_window(dec, 0) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_decode_peaks(dec, (void *)dst_buf, 0, src_buf,
+	    sizeof src_buf) == -1);
+	assert(errno == EINVAL);
+
+	xa_len = fmt.blocks * fmt.block_size_xa;
+	pcm_len = fmt.data_len_pcm;
+	xa = malloc(xa_len);
+	pcm = malloc(pcm_len);
+	assert(xa != NULL);
+	assert(pcm != NULL);
+	assert(fread(xa, xa_len, 1, file) == 1);
+
+	assert(bjxa_decode(dec, pcm, pcm_len, xa, xa_len) ==
+	    (int)fmt.blocks);
+
+	/* windows spanning several blocks and several calls */
+	samples = pcm_len / (2 * sizeof *pcm);
+	len = 2 * ((samples + 99) / 100);
+	peaks = calloc(len, sizeof *peaks);
+	ref = calloc(len, sizeof *ref);
+	assert(peaks != NULL);
+	assert(ref != NULL);
+
+	for (n = 0; n < len; n++) {
+		chan = n % 2;
+		ref[n].min = INT16_MAX;
+		ref[n].max = INT16_MIN;
+		squares = 0;
+		for (m = n / 2 * 100; m < samples && m < n / 2 * 100 + 100;
+		    m++) {
+			if (pcm[m * 2 + chan] < ref[n].min)
+				ref[n].min = pcm[m * 2 + chan];
+			if (pcm[m * 2 + chan] > ref[n].max)
+				ref[n].max = pcm[m * 2 + chan];
+			squares += (uint64_t)((int32_t)pcm[m * 2 + chan] *
+			    pcm[m * 2 + chan]);
+		}
+		mean = squares / (m - n / 2 * 100);
+		ref[n].rms = 0;
+		while ((uint64_t)(ref[n].rms + 1) * (ref[n].rms + 1) <= mean)
+			ref[n].rms++;
+	}
+
+	assert(bjxa_decode_seek(dec, 0) == 0);
+	assert(bjxa_decode_window(dec, 100) == 0);
+
+	assert(bjxa_decode_peaks(dec, peaks, 0, xa, 7 * fmt.block_size_xa) ==
+	    -1);
+	assert(errno == ENOBUFS);
+
+	chunk = 7 * fmt.block_size_xa;
+	for (off = 0, n = 0; off < xa_len; off += chunk) {
+		if (chunk > xa_len - off)
+			chunk = xa_len - off;
+		res = bjxa_decode_peaks(dec, peaks + n, len - n, xa + off,
+		    chunk);
+		assert(res >= 0);
+		assert(res <= 2 * (7 * 32 / 100 + 2));
+		n += (size_t)res;
+	}
+
+	assert(n == len);
+	assert(!memcmp(peaks, ref, len * sizeof *peaks));
+
+	assert(bjxa_decode_peaks(dec, peaks, len, xa, xa_len) == -1);
+	assert(errno == EPROTO);
+
+	assert(bjxa_free_decoder(&dec) == 0);
+	free(junk);
+	free(xa);
+	free(pcm);
+	free(peaks);
+	free(ref);
+	assert(fclose(file) == 0);
+}
+
+ADD_TEST_CASE(channel_mixing)
+{
+	bjxa_decoder_t *dec;
+	bjxa_format_t fmt, mix_fmt;
+	bjxa_stats_t stats;
+	FILE *file;
+	uint8_t *xa;
+	int16_t *pcm, *mix;
+	size_t pcm_len, xa_len, n;
+	unsigned m;
+	void *junk;
+
+	dec = bjxa_decoder();
+	assert(dec != NULL);
+
+	junk = strdup(random_junk);
+	assert(junk != NULL);
+
+	assert(bjxa_decode_mix(NULL, BJXA_MIX_MONO) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_decode_mix(junk, BJXA_MIX_MONO) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_decode_mix(dec, BJXA_MIX_MONO) == -1);
+	assert(errno == EINVAL);
+
+	file = fopen("test/square-mono-4.xa", "r");
+	assert(file != NULL);
+	assert(bjxa_fread_header(dec, file) > 0);
+	assert(bjxa_decode_mix(dec, BJXA_MIX_LEFT) == -1);
+	assert(errno == EINVAL);
+	assert(bjxa_decode_mix(dec, BJXA_MIX_NONE) == 0);
+	assert(fclose(file) == 0);
+
+	file = fopen("test/square-stereo-4.xa", "r");
+	assert(file != NULL);
+	assert(bjxa_fread_header(dec, file) > 0);
+	assert(bjxa_decode_format(dec, &fmt) == 0);
+
+	assert(bjxa_decode_mix(dec, BJXA_MIX_MONO + 1) == -1);
+	assert(errno == EINVAL);
+
+	xa_len = fmt.blocks * fmt.block_size_xa;
+	pcm_len = fmt.data_len_pcm;
+	xa = malloc(xa_len);
+	pcm = malloc(pcm_len);
+	mix = malloc(pcm_len / 2);
+	assert(xa != NULL);
+	assert(pcm != NULL);
+	assert(mix != NULL);
+	assert(fread(xa, xa_len, 1, file) == 1);
+
+	assert(bjxa_decode(dec, pcm, pcm_len, xa, xa_len) ==
+	    (int)fmt.blocks);
+
+	for (m = BJXA_MIX_LEFT; m <= BJXA_MIX_MONO; m++) {
+		assert(bjxa_decode_seek(dec, 0) == 0);
+		assert(bjxa_decode_mix(dec, m) == 0);
+		assert(bjxa_decode_format(dec, &mix_fmt) == 0);
+		assert(mix_fmt.channels == 1);
+		assert(mix_fmt.block_size_xa == fmt.block_size_xa);
+		assert(mix_fmt.block_size_pcm == fmt.block_size_pcm / 2);
+		assert(mix_fmt.data_len_pcm == pcm_len / 2);
+
+		assert(bjxa_decode(dec, mix, pcm_len / 2, xa, xa_len) ==
+		    (int)fmt.blocks);
+
+		for (n = 0; n < pcm_len / 4; n++) {
+			if (m == BJXA_MIX_LEFT)
+				assert(mix[n] == pcm[n * 2]);
+			else if (m == BJXA_MIX_RIGHT)
+				assert(mix[n] == pcm[n * 2 + 1]);
+			else
+				assert(mix[n] ==
+				    (pcm[n * 2] + pcm[n * 2 + 1]) / 2);
+		}
+	}
+
+	/* a single channel skips the other channel's blocks */
+	assert(fseek(file, 0, SEEK_SET) == 0);
+	assert(bjxa_fread_header(dec, file) > 0);
+	assert(bjxa_decode_mix(dec, BJXA_MIX_LEFT) == 0);
+	assert(bjxa_decode(dec, mix, pcm_len / 2, xa, xa_len) ==
+	    (int)fmt.blocks);
+	assert(bjxa_decoder_stats(dec, &stats) == 0);
+	assert(stats.blocks == fmt.blocks);
+	assert(stats.samples == pcm_len / 4);
+	for (n = 0, m = 0; n < 5; n++)
+		m += (unsigned)stats.factors[n];
+	assert(m == fmt.blocks);
+
+	assert(bjxa_free_decoder(&dec) == 0);
+	free(junk);
+	free(xa);
+	free(pcm);
+	free(mix);
+	assert(fclose(file) == 0);
+}
+
+ADD_TEST_CASE(fingerprint)
+{
+	bjxa_decoder_t *dec;
+	bjxa_format_t fmt;
+	bjxa_fingerprint_t fp, ref;
+	FILE *file;
+	uint8_t *xa;
+	int16_t *pcm;
+	uint64_t hash, bits;
+	size_t pcm_len, xa_len, chunk, off, n;
+	unsigned dist;
+	void *junk;
+	int res;
+
+	dec = bjxa_decoder();
+	assert(dec != NULL);
+
+	junk = strdup(random_junk);
+	assert(junk != NULL);
+
+	assert(bjxa_decoder_fingerprint(NULL, &fp) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_decoder_fingerprint(junk, &fp) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_decoder_fingerprint(dec, &fp) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_decode_fingerprint(dec, src_buf, sizeof src_buf) == -1);
+	assert(errno == EPROTO);
+
+	file = fopen("test/square-mono-4.xa", "r");
+	assert(file != NULL);
+	assert(bjxa_fread_header(dec, file) > 0);
+	assert(bjxa_decode_format(dec, &fmt) == 0);
+
+	assert(bjxa_decode_fingerprint(dec, src_buf, 1) == -1);
+	assert(errno == ENOBUFS);
+
+	xa_len = fmt.blocks * fmt.block_size_xa;
+	pcm_len = fmt.data_len_pcm;
+	xa = malloc(xa_len);
+	pcm = malloc(pcm_len);
+	assert(xa != NULL);
+	assert(pcm != NULL);
+	assert(fread(xa, xa_len, 1, file) == 1);
+	assert(fclose(file) == 0);
+
+	assert(bjxa_decode(dec, pcm, pcm_len, xa, xa_len) ==
+	    (int)fmt.blocks);
+
+	/* FNV-1a of the little endian samples */
+	hash = UINT64_C(0xcbf29ce484222325);
+	for (n = 0; n < pcm_len / sizeof *pcm; n++) {
+		hash = (hash ^ ((uint16_t)pcm[n] & 0xff)) *
+		    UINT64_C(0x100000001b3);
+		hash = (hash ^ ((uint16_t)pcm[n] >> 8)) *
+		    UINT64_C(0x100000001b3);
+	}
+
+	assert(bjxa_decode_seek(dec, 0) == 0);
+	chunk = 7 * fmt.block_size_xa;
+	for (off = 0; off < xa_len; off += chunk) {
+		if (chunk > xa_len - off)
+			chunk = xa_len - off;
+		res = bjxa_decode_fingerprint(dec, xa + off, chunk);
+		assert(res == (int)(chunk / fmt.block_size_xa));
+	}
+
+	assert(bjxa_decode_fingerprint(dec, xa, xa_len) == -1);
+	assert(errno == EPROTO);
+
+	assert(bjxa_decoder_fingerprint(dec, &ref) == 0);
+	assert(ref.hash == hash);
+	assert(ref.samples == pcm_len / sizeof *pcm);
+	assert(ref.windows > 0);
+	assert(ref.windows <= ref.samples / 4096);
+
+	/* the fingerprint starts over after a seek */
+	assert(bjxa_decode_seek(dec, 0) == 0);
+	assert(bjxa_decode_fingerprint(dec, xa, xa_len) == (int)fmt.blocks);
+	assert(bjxa_decoder_fingerprint(dec, &fp) == 0);
+	assert(!memcmp(&fp, &ref, sizeof fp));
+	free(xa);
+
+	/* the same audio encoded with more bits sounds alike */
+	file = fopen("test/square-mono-8.xa", "r");
+	assert(file != NULL);
+	assert(bjxa_fread_header(dec, file) > 0);
+	assert(bjxa_decode_format(dec, &fmt) == 0);
+	xa_len = fmt.blocks * fmt.block_size_xa;
+	xa = malloc(xa_len);
+	assert(xa != NULL);
+	assert(fread(xa, xa_len, 1, file) == 1);
+	assert(fclose(file) == 0);
+
+	assert(bjxa_decode_fingerprint(dec, xa, xa_len) == (int)fmt.blocks);
+	assert(bjxa_decoder_fingerprint(dec, &fp) == 0);
+	assert(fp.hash != ref.hash);
+	assert(fp.samples == ref.samples);
+	for (dist = 0, bits = fp.print ^ ref.print; bits != 0; dist++)
+		bits &= bits - 1;
+	assert(dist <= 8);
+
+	assert(bjxa_free_decoder(&dec) == 0);
+	free(junk);
+	free(xa);
+	free(pcm);
+}
+
+ADD_TEST_CASE(encoder_seeking)
+{
+	bjxa_encoder_t *enc;
+	bjxa_format_t fmt, tmp;
+	uint8_t *pcm, *xa, *xa_seek;
+	uint32_t block;
+	size_t xa_len, off;
+	void *junk;
+	FILE *file;
+
+	enc = bjxa_encoder();
+	assert(enc != NULL);
+
+	junk = strdup(random_junk);
+	assert(junk != NULL);
+
+	assert(bjxa_encode_seek(NULL, 0) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_encode_seek(junk, 0) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_encode_seek(enc, 0) == -1);
+	assert(errno == EINVAL);
+
+	file = fopen("test/square-stereo.wav", "r");
+	assert(file != NULL);
+	assert(bjxa_fread_riff_header(&fmt, file) > 0);
+	pcm = malloc(fmt.data_len_pcm);
+	assert(pcm != NULL);
+	assert(fread(pcm, fmt.data_len_pcm, 1, file) == 1);
+	assert(fclose(file) == 0);
+
+	/* no seeking in streaming mode */
+	tmp = fmt;
+	tmp.data_len_pcm = 0;
+	assert(bjxa_encode_init(enc, &tmp, 6) == 0);
+	assert(bjxa_encode_seek(enc, 0) == -1);
+	assert(errno == EINVAL);
+
+	tmp = fmt;
+	assert(bjxa_encode_init(enc, &tmp, 6) == 0);
+	xa_len = (size_t)tmp.blocks * tmp.block_size_xa;
+	xa = malloc(xa_len);
+	xa_seek = malloc(xa_len);
+	assert(xa != NULL);
+	assert(xa_seek != NULL);
+
+	assert(bjxa_encode_seek(enc, tmp.blocks) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_encode(enc, xa, xa_len, pcm, fmt.data_len_pcm) ==
+	    (int)tmp.blocks);
+
+	/* encode again the second half of the stream */
+	block = tmp.blocks / 2;
+	off = (size_t)block * tmp.block_size_pcm;
+	assert(bjxa_encode_seek(enc, block) == 0);
+	assert(bjxa_encode(enc, xa_seek, xa_len, pcm + off,
+	    fmt.data_len_pcm - off) == (int)(tmp.blocks - block));
+	off = (size_t)block * tmp.block_size_xa;
+	assert(!memcmp(xa + off, xa_seek, xa_len - off));
+
+	/* and the last block alone, with fewer samples */
+	block = tmp.blocks - 1;
+	off = (size_t)block * tmp.block_size_pcm;
+	assert(fmt.data_len_pcm - off < tmp.block_size_pcm);
+	memset(dst_buf, 0, tmp.block_size_pcm);
+	memcpy(dst_buf, pcm + off, fmt.data_len_pcm - off);
+	assert(bjxa_encode_seek(enc, block) == 0);
+	assert(bjxa_encode(enc, xa_seek, xa_len, dst_buf,
+	    tmp.block_size_pcm) == 1);
+	off = (size_t)block * tmp.block_size_xa;
+	assert(!memcmp(xa + off, xa_seek, tmp.block_size_xa));
+
+	assert(bjxa_free_encoder(&enc) == 0);
+	assert(enc == NULL);
+	free(junk);
+	free(pcm);
+	free(xa);
+	free(xa_seek);
+}
+
+ADD_TEST_CASE(stream_encoding)
+{
+	bjxa_encoder_t *enc;
+	bjxa_format_t fmt;
+
+	enc = bjxa_encoder();
+	assert(enc != NULL);
+
+	memset(&fmt, 0, sizeof fmt);
+	fmt.samples_rate = 44100;
+	fmt.sample_bits = 16;
+	fmt.channels = 2;
+
+	assert(bjxa_encode_init(enc, &fmt, 4) == 0);
+	assert(fmt.blocks == 0);
+	assert(fmt.block_size_pcm == 128);
+	assert(fmt.block_size_xa == 34);
+
+	assert(bjxa_dump_header(enc, dst_buf, sizeof dst_buf) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_encode(enc, dst_buf, sizeof dst_buf, src_buf, 0) == -1);
+	assert(errno == ENOBUFS);
+
+	assert(bjxa_encode(enc, dst_buf, sizeof dst_buf, src_buf, 6) == -1);
+	assert(errno == ENOBUFS);
+
+	/* complete blocks keep the stream open */
+	assert(bjxa_encode(enc, dst_buf, sizeof dst_buf, src_buf, 256) == 2);
+	assert(bjxa_encode_format(enc, &fmt) == 0);
+	assert(fmt.blocks == 2);
+	assert(fmt.data_len_pcm == 256);
+
+	/* a truncated block ends it */
+	assert(bjxa_encode(enc, dst_buf, sizeof dst_buf, src_buf, 132) == 2);
+	assert(bjxa_encode(enc, dst_buf, sizeof dst_buf, src_buf, 128) == -1);
+	assert(errno == EPROTO);
+
+	assert(bjxa_encode_format(enc, &fmt) == 0);
+	assert(fmt.blocks == 4);
+	assert(fmt.data_len_pcm == 388);
+	assert(bjxa_dump_header(enc, dst_buf, sizeof dst_buf) ==
+	    BJXA_HEADER_SIZE_XA);
+
+	assert(bjxa_free_encoder(&enc) == 0);
+	assert(enc == NULL);
+}
+
+ADD_TEST_CASE(riff_header_parsing)
+{
+	bjxa_format_t fmt;
+	uint8_t buf[128];
+	FILE *file;
+
+	assert(bjxa_parse_riff_header(NULL, src_buf, sizeof src_buf) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_parse_riff_header(&fmt, NULL, sizeof src_buf) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_parse_riff_header(&fmt, src_buf, 0) == -1);
+	assert(errno == ENOBUFS);
+
+	assert(bjxa_fread_riff_header(NULL, stdin) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_fread_riff_header(&fmt, NULL) == -1);
+	assert(errno == EFAULT);
+
+	file = fopen("test/square-mono.wav", "r");
+	assert(file != NULL);
+	assert(fread(buf + 20, BJXA_HEADER_SIZE_RIFF, 1, file) == 1);
+	assert(fclose(file) == 0);
+
+	assert(bjxa_parse_riff_header(&fmt, buf + 20, BJXA_HEADER_SIZE_RIFF) ==
+	    BJXA_HEADER_SIZE_RIFF);
+	assert(fmt.data_len_pcm == 1323000);
+	assert(fmt.samples_rate == 44100);
+	assert(fmt.sample_bits == 16);
+	assert(fmt.channels == 1);
+
+	/* insert a chunk between the RIFF header and the fmt chunk */
+	memmove(buf, buf + 20, 12);
+	assert(buf[4] < UINT8_MAX - 20);
+	buf[4] += 20;
+	memcpy(buf + 12, "junk\x0c\x00\x00\x00", 8);
+	memset(buf + 20, 0, 12);
+
+	assert(bjxa_parse_riff_header(&fmt, buf, 40) == -1);
+	assert(errno == ENOBUFS);
+
+	assert(bjxa_parse_riff_header(&fmt, buf, BJXA_HEADER_SIZE_RIFF) == -1);
+	assert(errno == ENOBUFS);
+
+	assert(bjxa_parse_riff_header(&fmt, buf, BJXA_HEADER_SIZE_RIFF + 20) ==
+	    BJXA_HEADER_SIZE_RIFF + 20);
+	assert(fmt.data_len_pcm == 1323000);
+
+	/* not a chunk */
+	memcpy(buf + 12, "junk\xff\xff\xff\xff", 8);
+	assert(bjxa_parse_riff_header(&fmt, buf, sizeof buf) == -1);
+	assert(errno == ENOBUFS);
+
+	/* floating point samples */
+	memcpy(buf + 12, "junk\x0c\x00\x00\x00", 8);
+	memcpy(buf + 40, "\x03\x00", 2);
+	assert(bjxa_parse_riff_header(&fmt, buf, sizeof buf) == -1);
+	assert(errno == EPROTO);
+
+	memcpy(buf + 48, "\x10\xb1\x02\x00\x04\x00\x20\x00", 8);
+	assert(bjxa_parse_riff_header(&fmt, buf, sizeof buf) ==
+	    BJXA_HEADER_SIZE_RIFF + 20);
+	assert(fmt.data_len_pcm == 1323000);
+	assert(fmt.sample_bits == 32);
+}
+
+ADD_TEST_CASE(sample_conversion)
+{
+	bjxa_encoder_t *enc;
+	bjxa_format_t fmt;
+	int16_t pcm[32];
+	uint8_t src[128], ref[33], *ptr;
+	uint32_t raw;
+	float val;
+	unsigned n;
+	void *junk;
+
+	enc = bjxa_encoder();
+	assert(enc != NULL);
+
+	junk = strdup(random_junk);
+	assert(junk != NULL);
+
+	assert(bjxa_encode_dither(NULL, 1) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_encode_dither(junk, 1) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_encode_dither(enc, 1) == -1);
+	assert(errno == EINVAL);
+
+	memset(&fmt, 0, sizeof fmt);
+	fmt.samples_rate = 44100;
+	fmt.sample_bits = 12;
+	fmt.channels = 1;
+	fmt.data_len_pcm = 64;
+
+	assert(bjxa_encode_init(enc, &fmt, 4) == -1);
+	assert(errno == EINVAL);
+
+	/* reference block, with samples representable in 8 bits */
+	for (n = 0; n < 32; n++)
+		pcm[n] = (int16_t)(((int)n - 16) * 2048);
+
+	fmt.sample_bits = 16;
+	assert(bjxa_encode_init(enc, &fmt, 4) == 0);
+	assert(bjxa_encode_dither(enc, 1) == 0);
+	assert(bjxa_encode(enc, ref, sizeof ref, pcm, sizeof pcm) == 1);
+
+	/* 8 bits samples are unsigned */
+	for (n = 0; n < 32; n++)
+		src[n] = (uint8_t)((pcm[n] >> 8) + 128);
+
+	fmt.sample_bits = 8;
+	fmt.data_len_pcm = 32;
+	assert(bjxa_encode_init(enc, &fmt, 4) == 0);
+	assert(fmt.block_size_pcm == 64);
+	assert(bjxa_encode(enc, dst_buf, sizeof dst_buf, src, 31) == -1);
+	assert(errno == ENOBUFS);
+	assert(bjxa_encode(enc, dst_buf, sizeof dst_buf, src, 32) == 1);
+	assert(!memcmp(dst_buf, ref, fmt.block_size_xa));
+
+	/* 24 bits samples are rounded to the nearest 16 bits value */
+	ptr = src;
+	for (n = 0; n < 32; n++) {
+		raw = (uint32_t)(pcm[n] * 256 + (n % 2 ? -128 : 127));
+		*ptr++ = (uint8_t)raw;
+		*ptr++ = (uint8_t)(raw >> 8);
+		*ptr++ = (uint8_t)(raw >> 16);
+	}
+
+	fmt.sample_bits = 24;
+	fmt.data_len_pcm = 96;
+	assert(bjxa_encode_init(enc, &fmt, 4) == 0);
+	assert(fmt.block_size_pcm == 64);
+	assert(bjxa_encode(enc, dst_buf, sizeof dst_buf, src, 96) == 1);
+	assert(!memcmp(dst_buf, ref, fmt.block_size_xa));
+
+	/* floating point samples are clamped */
+	ptr = src;
+	for (n = 0; n < 32; n++) {
+		val = pcm[n] / 32768.0f;
+		if (n == 0)
+			val = -2.0f;
+		memcpy(&raw, &val, sizeof raw);
+		*ptr++ = (uint8_t)raw;
+		*ptr++ = (uint8_t)(raw >> 8);
+		*ptr++ = (uint8_t)(raw >> 16);
+		*ptr++ = (uint8_t)(raw >> 24);
+	}
+
+	fmt.sample_bits = 32;
+	fmt.data_len_pcm = 128;
+	assert(bjxa_encode_init(enc, &fmt, 4) == 0);
+	assert(fmt.block_size_pcm == 64);
+	assert(bjxa_encode(enc, dst_buf, sizeof dst_buf, src, 128) == 1);
+	assert(!memcmp(dst_buf, ref, fmt.block_size_xa));
+
+	/* dithering is reproducible */
+	assert(bjxa_encode_init(enc, &fmt, 8) == 0);
+	assert(bjxa_encode_dither(enc, 1) == 0);
+	assert(bjxa_encode(enc, ref, sizeof ref, src, 128) == 1);
+
+	assert(bjxa_encode_init(enc, &fmt, 8) == 0);
+	assert(bjxa_encode_dither(enc, 1) == 0);
+	assert(bjxa_encode(enc, dst_buf, sizeof dst_buf, src, 128) == 1);
+	assert(!memcmp(dst_buf, ref, fmt.block_size_xa));
+
+	assert(bjxa_free_encoder(&enc) == 0);
+	assert(enc == NULL);
+	free(junk);
+}
+
+ADD_TEST_CASE(statistics)
+{
+	bjxa_decoder_t *dec;
+	bjxa_encoder_t *enc;
+	bjxa_format_t fmt;
+	bjxa_stats_t stats;
+	uint8_t xa[256];
+	uint64_t sum;
+	unsigned n;
+	FILE *file;
+	void *junk;
+
+	dec = bjxa_decoder();
+	assert(dec != NULL);
+
+	enc = bjxa_encoder();
+	assert(enc != NULL);
+
+	junk = strdup(random_junk);
+	assert(junk != NULL);
+
+	assert(bjxa_decoder_stats(NULL, &stats) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_decoder_stats(junk, &stats) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_decoder_stats(dec, NULL) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_encoder_stats(NULL, &stats) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_encoder_stats(junk, &stats) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_encoder_stats(enc, NULL) == -1);
+	assert(errno == EFAULT);
+
+	file = fopen("test/square-stereo-4.xa", "r");
+	assert(file != NULL);
+	assert(bjxa_fread_header(dec, file) > 0);
+	assert(bjxa_decode_format(dec, &fmt) == 0);
+
+	assert(bjxa_decoder_stats(dec, &stats) == 0);
+	assert(stats.blocks == 0);
+
+	assert(fmt.block_size_xa * 4 <= sizeof xa);
+	assert(fread(xa, fmt.block_size_xa, 4, file) == 4);
+	assert(bjxa_decode(dec, dst_buf, sizeof dst_buf, xa,
+	    fmt.block_size_xa * 4) == 4);
+
+	/* one profile per channel and block */
+	assert(bjxa_decoder_stats(dec, &stats) == 0);
+	assert(stats.blocks == 4);
+	assert(stats.samples == fmt.block_size_pcm * 2);
+	for (n = 0, sum = 0; n < 5; n++)
+		sum += stats.factors[n];
+	assert(sum == 8);
+	for (n = 0, sum = 0; n < 16; n++)
+		sum += stats.ranges[n];
+	assert(sum == 8);
+
+	/* a new header resets the statistics */
+	assert(fseek(file, 0, SEEK_SET) == 0);
+	assert(bjxa_fread_header(dec, file) > 0);
+	assert(bjxa_decoder_stats(dec, &stats) == 0);
+	assert(stats.blocks == 0);
+
+	memset(&fmt, 0, sizeof fmt);
+	fmt.samples_rate = 44100;
+	fmt.sample_bits = 16;
+	fmt.channels = 1;
+	fmt.data_len_pcm = 64;
+	assert(bjxa_encode_init(enc, &fmt, 4) == 0);
+	assert(bjxa_encode(enc, dst_buf, sizeof dst_buf, src_buf, 64) == 1);
+
+	assert(bjxa_encoder_stats(enc, &stats) == 0);
+	assert(stats.blocks == 1);
+	assert(stats.samples == 32);
+	assert(stats.clamps == 0);
+	assert(stats.silent == 1);
+
+	assert(bjxa_free_decoder(&dec) == 0);
+	assert(bjxa_free_encoder(&enc) == 0);
+	free(junk);
+	assert(fclose(file) == 0);
+}
+
+static const char * const pool_files[] = {
+	"test/square-mono-4.xa",
+	"test/square-mono-6.xa",
+	"test/square-mono-8.xa",
+	"test/square-stereo-4.xa",
+	"test/square-stereo-6.xa",
+	"test/square-stereo-8.xa",
+};
+
+#define POOL_FILES (sizeof pool_files / sizeof *pool_files)
+
+static void
+pool_load(bjxa_job_t *job, const char *path)
+{
+	bjxa_decoder_t *dec;
+	bjxa_format_t fmt;
+	FILE *file;
+	long len;
+	void *src;
+
+	file = fopen(path, "r");
+	assert(file != NULL);
+	assert(fseek(file, 0, SEEK_END) == 0);
+	len = ftell(file);
+	assert(len > 0);
+	assert(fseek(file, 0, SEEK_SET) == 0);
+
+	src = malloc((size_t)len);
+	assert(src != NULL);
+	assert(fread(src, (size_t)len, 1, file) == 1);
+	assert(fclose(file) == 0);
+
+	dec = bjxa_decoder();
+	assert(dec != NULL);
+	assert(bjxa_parse_header(dec, src, (size_t)len) > 0);
+	assert(bjxa_decode_format(dec, &fmt) == 0);
+	assert(bjxa_free_decoder(&dec) == 0);
+
+	memset(job, 0, sizeof *job);
+	job->src = src;
+	job->src_len = (size_t)len;
+	job->dst_len = fmt.data_len_pcm;
+	job->dst = malloc(job->dst_len);
+	assert(job->dst != NULL);
+}
+
+static void
+pool_check(const bjxa_job_t *job)
+{
+	bjxa_decoder_t *dec;
+	bjxa_format_t fmt;
+	void *pcm;
+
+	assert(job->status > 0);
+	assert(job->error == 0);
+
+	dec = bjxa_decoder();
+	assert(dec != NULL);
+	assert(bjxa_parse_header(dec, job->src, job->src_len) ==
+	    BJXA_HEADER_SIZE_XA);
+	assert(bjxa_decode_format(dec, &fmt) == 0);
+	assert(!memcmp(&fmt, &job->fmt, sizeof fmt));
+	assert(job->status == (int)fmt.blocks);
+
+	pcm = malloc(fmt.data_len_pcm);
+	assert(pcm != NULL);
+	assert(bjxa_decode(dec, pcm, fmt.data_len_pcm,
+	    (const uint8_t *)job->src + BJXA_HEADER_SIZE_XA,
+	    job->src_len - BJXA_HEADER_SIZE_XA) == (int)fmt.blocks);
+	assert(!memcmp(pcm, job->dst, fmt.data_len_pcm));
+
+	assert(bjxa_free_decoder(&dec) == 0);
+	free(pcm);
+}
+
+static void
+pool_done(bjxa_job_t *job)
+{
+
+	assert(job->priv == pool_files);
+	job->priv = NULL;
+}
+
+ADD_TEST_CASE(job_pool)
+{
+	bjxa_job_t jobs[POOL_FILES * 4], bad, *job;
+	bjxa_pool_t *pool;
+	unsigned n;
+	void *junk;
+
+	junk = strdup(random_junk);
+	assert(junk != NULL);
+
+	assert(bjxa_pool(0, NULL) == NULL);
+	assert(errno == EINVAL);
+
+	assert(bjxa_pool(BJXA_POOL_MAX + 1, NULL) == NULL);
+	assert(errno == EINVAL);
+
+	assert(bjxa_free_pool(NULL) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_free_pool((bjxa_pool_t **)&junk) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_pool_submit(NULL, &bad) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_pool_submit(junk, &bad) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_pool_poll(NULL, 0) == NULL);
+	assert(errno == EFAULT);
+
+	assert(bjxa_pool_poll(junk, 0) == NULL);
+	assert(errno == EINVAL);
+
+	/* completion queue */
+	pool = bjxa_pool(4, NULL);
+	assert(pool != NULL);
+
+	assert(bjxa_pool_submit(pool, NULL) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_pool_poll(pool, 1) == NULL);
+	assert(errno == EAGAIN);
+
+	for (n = 0; n < POOL_FILES * 4; n++) {
+		pool_load(jobs + n, pool_files[n % POOL_FILES]);
+		assert(bjxa_pool_submit(pool, jobs + n) == 0);
+	}
+
+	memset(&bad, 0, sizeof bad);
+	bad.src = src_buf;
+	bad.src_len = sizeof src_buf;
+	bad.dst = dst_buf;
+	bad.dst_len = sizeof dst_buf;
+	assert(bjxa_pool_submit(pool, &bad) == 0);
+
+	for (n = 0; n <= POOL_FILES * 4; n++) {
+		job = bjxa_pool_poll(pool, 1);
+		assert(job != NULL);
+		if (job == &bad) {
+			assert(bad.status == -1);
+			assert(bad.error == EPROTO);
+		}
+		else
+			pool_check(job);
+	}
+
+	assert(bjxa_pool_poll(pool, 1) == NULL);
+	assert(errno == EAGAIN);
+
+	assert(bjxa_free_pool(&pool) == 0);
+	assert(pool == NULL);
+
+	/* completion callback */
+	pool = bjxa_pool(3, pool_done);
+	assert(pool != NULL);
+
+	for (n = 0; n < POOL_FILES * 4; n++) {
+		memset(jobs[n].dst, 0, jobs[n].dst_len);
+		jobs[n].priv = (void *)(uintptr_t)pool_files;
+		assert(bjxa_pool_submit(pool, jobs + n) == 0);
+	}
+
+	assert(bjxa_pool_poll(pool, 1) == NULL);
+	assert(errno == EAGAIN);
+
+	for (n = 0; n < POOL_FILES * 4; n++) {
+		assert(jobs[n].priv == NULL);
+		pool_check(jobs + n);
+	}
+
+	assert(bjxa_free_pool(&pool) == 0);
+
+	for (n = 0; n < POOL_FILES * 4; n++) {
+		free((void *)(uintptr_t)jobs[n].src);
+		free(jobs[n].dst);
+	}
+	free(junk);
+}
+
+ADD_TEST_CASE(bundle)
+{
+	bjxa_bundle_t *bundle;
+	bjxa_entry_t ent;
+	void *junk;
+
+	junk = strdup(random_junk);
+	assert(junk != NULL);
+
+	assert(bjxa_bundle(NULL) == NULL);
+	assert(errno == EFAULT);
+
+	assert(bjxa_bundle("test/nonexistent.bjxb") == NULL);
+	assert(errno == ENOENT);
+
+	assert(bjxa_bundle("test/square-mono-4.xa") == NULL);
+	assert(errno == EPROTO);
+
+	assert(bjxa_free_bundle(NULL) == -1);
+	assert(errno == EFAULT);
+
+	bundle = NULL;
+	assert(bjxa_free_bundle(&bundle) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_free_bundle((bjxa_bundle_t **)&junk) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_bundle_find(NULL, "name", &ent) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_bundle_find(junk, "name", &ent) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_bundle_entry(NULL, 0, &ent) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_bundle_entry(junk, 0, &ent) == -1);
+	assert(errno == EINVAL);
+
+	free(junk);
+}
+
+ADD_TEST_CASE(validation)
+{
+	static const char * const files[] = {
+		"test/square-mono-4.xa",
+		"test/square-mono-8.xa",
+		"test/square-stereo-6.xa",
+	};
+	bjxa_decoder_t *dec;
+	bjxa_format_t fmt;
+	uint8_t *xa, profile;
+	size_t xa_len, off, bad;
+	unsigned n, block_size;
+	void *junk;
+	FILE *file;
+
+	dec = bjxa_decoder();
+	assert(dec != NULL);
+
+	junk = strdup(random_junk);
+	assert(junk != NULL);
+
+	assert(bjxa_validate(NULL, src_buf, sizeof src_buf, &off) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_validate(junk, src_buf, sizeof src_buf, &off) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_validate(dec, NULL, sizeof src_buf, &off) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_validate(dec, src_buf, 0, &off) == -1);
+	assert(errno == ENOBUFS);
+
+	assert(bjxa_validate(dec, src_buf, sizeof src_buf, &off) == -1);
+	assert(errno == EPROTO);
+	assert(off == 0);
+
+	for (n = 0; n < sizeof files / sizeof *files; n++) {
+		file = fopen(files[n], "r");
+		assert(file != NULL);
+		assert(fseek(file, 0, SEEK_END) == 0);
+		xa_len = (size_t)ftell(file);
+		assert(fseek(file, 0, SEEK_SET) == 0);
+		xa = malloc(xa_len);
+		assert(xa != NULL);
+		assert(fread(xa, xa_len, 1, file) == 1);
+		assert(fclose(file) == 0);
+
+		assert(bjxa_validate(dec, xa, xa_len, NULL) == 0);
+		assert(bjxa_validate(dec, xa, xa_len, &off) == 0);
+		assert(off == 0);
+		assert(bjxa_decode_format(dec, &fmt) == 0);
+		block_size = fmt.block_size_xa / fmt.channels;
+
+		/* a truncated stream fails on its first incomplete block */
+		assert(bjxa_validate(dec, xa, xa_len - 1, &off) == -1);
+		assert(errno == EPROTO);
+		assert(off == xa_len - block_size);
+
+		/* invalid profiles in the middle of a vector period, then
+		 * in the last block of the stream
+		 */
+		bad = BJXA_HEADER_SIZE_XA + 1000 * fmt.block_size_xa +
+		    block_size;
+		profile = xa[bad];
+		xa[bad] = 0x5c;
+		assert(bjxa_validate(dec, xa, xa_len, &off) == -1);
+		assert(errno == EPROTO);
+		assert(off == bad);
+		xa[bad] = profile;
+
+		bad = xa_len - block_size;
+		profile = xa[bad];
+		xa[bad] = 0xf0;
+		assert(bjxa_validate(dec, xa, xa_len, &off) == -1);
+		assert(errno == EPROTO);
+		assert(off == bad);
+		xa[bad] = profile;
+
+		free(xa);
+	}
+
+	assert(bjxa_free_decoder(&dec) == 0);
+	free(junk);
+}
+
+ADD_TEST_CASE(editing)
+{
+	bjxa_decoder_t *dec;
+	bjxa_format_t fmt;
+	const void *src[2];
+	size_t src_len[2], xa_len, head_len, tail_len;
+	uint8_t *xa, *head, *tail, *join;
+	void *junk;
+	FILE *file;
+
+	dec = bjxa_decoder();
+	assert(dec != NULL);
+
+	junk = strdup(random_junk);
+	assert(junk != NULL);
+
+	file = fopen("test/square-stereo-4.xa", "r");
+	assert(file != NULL);
+	assert(fseek(file, 0, SEEK_END) == 0);
+	xa_len = (size_t)ftell(file);
+	assert(fseek(file, 0, SEEK_SET) == 0);
+	xa = malloc(xa_len);
+	head = malloc(xa_len);
+	tail = malloc(xa_len);
+	join = malloc(xa_len * 2);
+	assert(xa != NULL);
+	assert(head != NULL);
+	assert(tail != NULL);
+	assert(join != NULL);
+	assert(fread(xa, xa_len, 1, file) == 1);
+	assert(fclose(file) == 0);
+
+	assert(bjxa_cut(NULL, head, xa_len, xa, xa_len, 0, 1) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_cut(junk, head, xa_len, xa, xa_len, 0, 1) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_cut(dec, NULL, xa_len, xa, xa_len, 0, 1) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_cut(dec, head, xa_len, src_buf, sizeof src_buf, 0, 1) ==
+	    -1);
+	assert(errno == EPROTO);
+
+	assert(bjxa_cut(dec, head, xa_len, xa, xa_len - 1, 0, 1) == -1);
+	assert(errno == EPROTO);
+
+	assert(bjxa_cut(dec, head, xa_len, xa, xa_len, 1, 1) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_parse_header(dec, xa, xa_len) > 0);
+	assert(bjxa_decode_format(dec, &fmt) == 0);
+
+	assert(bjxa_cut(dec, head, xa_len, xa, xa_len, 0, fmt.blocks + 1) ==
+	    -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_cut(dec, head, 16, xa, xa_len, 0, 1) == -1);
+	assert(errno == ENOBUFS);
+
+	assert(bjxa_cut(dec, head, BJXA_HEADER_SIZE_XA, xa, xa_len, 0, 1) ==
+	    -1);
+	assert(errno == ENOBUFS);
+
+	/* split the stream in two and join the parts */
+	head_len = BJXA_HEADER_SIZE_XA + 5000 * fmt.block_size_xa;
+	tail_len = xa_len - 5000 * fmt.block_size_xa;
+	assert(bjxa_cut(dec, head, xa_len, xa, xa_len, 0, 5000) ==
+	    (ssize_t)head_len);
+	assert(bjxa_cut(dec, tail, xa_len, xa, xa_len, 5000, fmt.blocks) ==
+	    (ssize_t)tail_len);
+
+	src[0] = head;
+	src[1] = tail;
+	src_len[0] = head_len;
+	src_len[1] = tail_len;
+
+	assert(bjxa_concat(NULL, join, xa_len, src, src_len, 2) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_concat(junk, join, xa_len, src, src_len, 2) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_concat(dec, join, xa_len, NULL, src_len, 2) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_concat(dec, join, xa_len, src, src_len, 0) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_concat(dec, join, xa_len - 1, src, src_len, 2) == -1);
+	assert(errno == ENOBUFS);
+
+	assert(bjxa_concat(dec, join, xa_len, src, src_len, 2) ==
+	    (ssize_t)xa_len);
+	assert(!memcmp(xa, join, xa_len));
+
+	/* the head doesn't end with the initial state of the stream */
+	src[1] = xa;
+	src_len[1] = xa_len;
+	xa[BJXA_HEADER_SIZE_XA] = 0x13;
+	assert(bjxa_concat(dec, join, xa_len * 2, src, src_len, 2) == -1);
+	assert(errno == EINVAL);
+
+	/* the tail doesn't end with a complete block */
+	src[0] = tail;
+	src[1] = head;
+	src_len[0] = tail_len;
+	src_len[1] = head_len;
+	assert(bjxa_concat(dec, join, xa_len * 2, src, src_len, 2) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_free_decoder(&dec) == 0);
+	free(join);
+	free(tail);
+	free(head);
+	free(xa);
+	free(junk);
+}
+
+ADD_TEST_CASE(transcoding)
+{
+	bjxa_decoder_t *dec;
+	bjxa_encoder_t *enc;
+	bjxa_format_t fmt, fmt_out;
+	uint8_t *xa, *out, *ref;
+	int16_t *pcm;
+	size_t xa_len, out_len;
+	void *junk;
+	FILE *file;
+
+	dec = bjxa_decoder();
+	enc = bjxa_encoder();
+	assert(dec != NULL);
+	assert(enc != NULL);
+
+	junk = strdup(random_junk);
+	assert(junk != NULL);
+
+	assert(bjxa_transcode(NULL, enc, dst_buf, sizeof dst_buf, src_buf,
+	    sizeof src_buf) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_transcode(dec, NULL, dst_buf, sizeof dst_buf, src_buf,
+	    sizeof src_buf) == -1);
+	assert(errno == EFAULT);
+
+	assert(bjxa_transcode(junk, enc, dst_buf, sizeof dst_buf, src_buf,
+	    sizeof src_buf) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_transcode(dec, junk, dst_buf, sizeof dst_buf, src_buf,
+	    sizeof src_buf) == -1);
+	assert(errno == EINVAL);
+
+	assert(bjxa_transcode(dec, enc, dst_buf, sizeof dst_buf, src_buf,
+	    sizeof src_buf) == -1);
+	assert(errno == EINVAL);
+
+	file = fopen("test/square-mono-8.xa", "r");
+	assert(file != NULL);
+	assert(bjxa_fread_header(dec, file) > 0);
+	assert(bjxa_decode_format(dec, &fmt) == 0);
+
+	xa_len = (size_t)fmt.blocks * fmt.block_size_xa;
+	xa = malloc(xa_len);
+	pcm = malloc(fmt.data_len_pcm);
+	assert(xa != NULL);
+	assert(pcm != NULL);
+	assert(fread(xa, xa_len, 1, file) == 1);
+	assert(fclose(file) == 0);
+
+	/* the encoder is not ready */
+	assert(bjxa_transcode(dec, enc, dst_buf, sizeof dst_buf, xa,
+	    xa_len) == -1);
+	assert(errno == EINVAL);
+
+	fmt_out = fmt;
+	assert(bjxa_encode_init(enc, &fmt_out, 4) == 0);
+	out_len = (size_t)fmt_out.blocks * fmt_out.block_size_xa;
+	out = malloc(out_len);
+	ref = malloc(out_len);
+	assert(out != NULL);
+	assert(ref != NULL);
+
+	assert(bjxa_transcode(dec, enc, out, out_len, xa, 1) == -1);
+	assert(errno == ENOBUFS);
+
+	assert(bjxa_transcode(dec, enc, out, 1, xa, xa_len) == -1);
+	assert(errno == ENOBUFS);
+
+	assert(bjxa_transcode(dec, enc, out, out_len, xa, xa_len) ==
+	    (int)fmt.blocks);
+
+	/* same output as decoding and encoding the whole stream */
+	assert(bjxa_decode_seek(dec, 0) == 0);
+	assert(bjxa_decode(dec, pcm, fmt.data_len_pcm, xa, xa_len) ==
+	    (int)fmt.blocks);
+	fmt_out = fmt;
+	assert(bjxa_encode_init(enc, &fmt_out, 4) == 0);
+	assert(bjxa_encode(enc, ref, out_len, pcm, fmt.data_len_pcm) ==
+	    (int)fmt.blocks);
+	assert(!memcmp(out, ref, out_len));
+
+	/* the complete stream was already transcoded */
+	assert(bjxa_transcode(dec, enc, out, out_len, xa, xa_len) == -1);
+	assert(errno == EPROTO);
+
+	assert(bjxa_free_decoder(&dec) == 0);
+	assert(bjxa_free_encoder(&enc) == 0);
+	free(ref);
+	free(out);
+	free(pcm);
+	free(xa);
+	free(junk);
+}
+
 int
 main(void)
 {
@@ -292,5 +1634,19 @@ main(void)
 	RUN_TEST_CASE(decoding);
 	RUN_TEST_CASE(riff_header_dumping);
 	RUN_TEST_CASE(pcm_samples_dumping);
+	RUN_TEST_CASE(seeking);
+	RUN_TEST_CASE(peaks);
+	RUN_TEST_CASE(channel_mixing);
+	RUN_TEST_CASE(fingerprint);
+	RUN_TEST_CASE(riff_header_parsing);
+	RUN_TEST_CASE(encoder_seeking);
+	RUN_TEST_CASE(stream_encoding);
+	RUN_TEST_CASE(sample_conversion);
+	RUN_TEST_CASE(statistics);
+	RUN_TEST_CASE(job_pool);
+	RUN_TEST_CASE(bundle);
+	RUN_TEST_CASE(validation);
+	RUN_TEST_CASE(editing);
+	RUN_TEST_CASE(transcoding);
 	return (EXIT_SUCCESS);
 }
@@ -0,0 +1,64 @@
+#!/bin/sh
+#
+# Copyright (C) 2020  Dridi Boukelmoune
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+. "$(dirname "$0")"/test_setup.sh
+
+_ ----------
+_ Mono peaks
+_ ----------
+
+expect_sha1 "200c895f9d8e47f40711e30af5284b4283672e45" \
+	bjxa peaks "$TEST_DIR"/square-mono-4.xa
+
+# BJXP, version 1, 2584 windows of 256 samples, 44100Hz, 1 channel
+bjxa peaks "$TEST_DIR"/square-mono-4.xa "$WORK_DIR"/mono.peaks
+expect_success "^424a585001000000180a00000001000044ac0100$" \
+	sh -c "head -c 20 '$WORK_DIR'/mono.peaks | '$XXD' -p"
+
+_ ------------
+_ Stereo peaks
+_ ------------
+
+expect_sha1 "6e0e1ea45b8d85402844cd9322739adc3483a107" \
+	bjxa peaks --window 1024 <"$TEST_DIR"/square-stereo-8.xa
+
+# 646 windows of 2 channels, 6 bytes each
+bjxa peaks --window 1024 "$TEST_DIR"/square-stereo-8.xa \
+	"$WORK_DIR"/stereo.peaks
+test "$(wc -c <"$WORK_DIR"/stereo.peaks)" -eq $((20 + 646 * 2 * 6))
+
+_ -----------------
+_ Window boundaries
+_ -----------------
+
+# a stream cut at a window boundary has the same remaining peaks
+bjxa cut --from 8 "$TEST_DIR"/square-mono-4.xa "$WORK_DIR"/tail.xa
+bjxa peaks "$WORK_DIR"/tail.xa "$WORK_DIR"/tail.peaks
+tail -c +$((20 + 6 + 1)) "$WORK_DIR"/mono.peaks >"$WORK_DIR"/mono.data
+tail -c +$((20 + 1)) "$WORK_DIR"/tail.peaks >"$WORK_DIR"/tail.data
+cmp "$WORK_DIR"/mono.data "$WORK_DIR"/tail.data
+
+_ --------------
+_ Invalid inputs
+_ --------------
+
+expect_error "Invalid window size" bjxa peaks --window 0
+expect_error "Missing window size" bjxa peaks --window
+expect_error "Too many arguments" bjxa peaks a b c
+
+head -c 100 "$TEST_DIR"/square-mono-4.xa >"$WORK_DIR"/short.xa
+expect_error "End of file" bjxa peaks "$WORK_DIR"/short.xa /dev/null
@@ -0,0 +1,67 @@
+#!/bin/sh
+#
+# Copyright (C) 2020  Dridi Boukelmoune
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+. "$(dirname "$0")"/test_setup.sh
+
+_ --------------------
+_ Sequential transcode
+_ --------------------
+
+# same output as a decode and encode round trip
+bjxa decode "$TEST_DIR"/square-stereo-8.xa |
+bjxa encode --bits 4 >"$WORK_DIR"/pipe.xa
+
+bjxa transcode --bits 4 "$TEST_DIR"/square-stereo-8.xa "$WORK_DIR"/seq.xa
+cmp "$WORK_DIR"/pipe.xa "$WORK_DIR"/seq.xa
+
+bjxa transcode --bits 8 <"$TEST_DIR"/square-mono-4.xa >"$WORK_DIR"/up.xa
+expect_success "up.xa,,8,1,44100,661500,20672," \
+	bjxa info "$WORK_DIR"/up.xa
+
+_ ------------------
+_ Parallel transcode
+_ ------------------
+
+bjxa transcode --jobs 1 --bits 4 "$TEST_DIR"/square-stereo-8.xa \
+	"$WORK_DIR"/one.xa
+cmp "$WORK_DIR"/seq.xa "$WORK_DIR"/one.xa
+
+bjxa transcode --jobs 4 --bits 4 "$TEST_DIR"/square-stereo-8.xa \
+	"$WORK_DIR"/par.xa
+
+expect_success "par.xa: ok" bjxa verify "$WORK_DIR"/par.xa
+expect_success "par.xa,,4,2,44100,661500,20672," \
+	bjxa info "$WORK_DIR"/par.xa
+
+# segments start with a sync block, with little effect on the quality
+bjxa decode "$TEST_DIR"/square-stereo-8.xa "$WORK_DIR"/ref.wav
+bjxa compare "$WORK_DIR"/seq.xa "$WORK_DIR"/ref.wav |
+grep snr: >"$WORK_DIR"/seq.txt
+bjxa compare "$WORK_DIR"/par.xa "$WORK_DIR"/ref.wav |
+grep snr: >"$WORK_DIR"/par.txt
+cmp "$WORK_DIR"/seq.txt "$WORK_DIR"/par.txt
+
+_ --------------
+_ Invalid inputs
+_ --------------
+
+expect_error "bjxa_fread_header" bjxa transcode \
+	"$TEST_DIR"/square-mono.wav "$WORK_DIR"/bad.xa
+expect_error "bjxa_parse_header" bjxa transcode --jobs 2 \
+	"$TEST_DIR"/square-mono.wav "$WORK_DIR"/bad.xa
+expect_error "Invalid number of jobs" bjxa transcode --jobs 0
+expect_error "Invalid number of bits" bjxa transcode --bits 5
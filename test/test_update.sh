@@ -0,0 +1,78 @@
+#!/bin/sh
+#
+# Copyright (C) 2020  Dridi Boukelmoune
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+. "$(dirname "$0")"/test_setup.sh
+
+_ ---------------
+_ Unchanged files
+_ ---------------
+
+bjxa encode "$TEST_DIR"/square-mono.wav "$WORK_DIR"/old.xa
+bjxa update "$TEST_DIR"/square-mono.wav "$WORK_DIR"/old.xa \
+	"$TEST_DIR"/square-mono.wav "$WORK_DIR"/same.xa
+cmp "$WORK_DIR"/old.xa "$WORK_DIR"/same.xa
+
+_ -------------
+_ Changed files
+_ -------------
+
+# silence 200 bytes straddling blocks 5000 to 5003
+cp "$TEST_DIR"/square-mono.wav "$WORK_DIR"/edit.wav
+dd if=/dev/zero of="$WORK_DIR"/edit.wav bs=1 seek=320054 count=200 \
+	conv=notrunc 2>/dev/null
+
+bjxa encode "$WORK_DIR"/edit.wav "$WORK_DIR"/full.xa
+bjxa update "$TEST_DIR"/square-mono.wav "$WORK_DIR"/old.xa \
+	<"$WORK_DIR"/edit.wav >"$WORK_DIR"/edit.xa
+cmp "$WORK_DIR"/full.xa "$WORK_DIR"/edit.xa
+
+# unchanged blocks are copied, even when they differ from a new encoding
+cp "$WORK_DIR"/old.xa "$WORK_DIR"/tamper.xa
+printf x | dd of="$WORK_DIR"/tamper.xa bs=1 seek=2537 conv=notrunc \
+	2>/dev/null
+printf x | dd of="$WORK_DIR"/tamper.xa bs=1 seek=125037 conv=notrunc \
+	2>/dev/null
+bjxa update "$TEST_DIR"/square-mono.wav "$WORK_DIR"/tamper.xa \
+	"$WORK_DIR"/edit.wav "$WORK_DIR"/tamper-edit.xa
+test "$(cmp -l "$WORK_DIR"/full.xa "$WORK_DIR"/tamper-edit.xa |
+	awk '{print $1}')" = 2538
+
+# a different length
+bjxa cut --to 10000 "$TEST_DIR"/square-mono-6.xa |
+bjxa decode >"$WORK_DIR"/short.wav
+bjxa encode "$WORK_DIR"/short.wav "$WORK_DIR"/short-full.xa
+bjxa update "$TEST_DIR"/square-mono.wav "$WORK_DIR"/old.xa \
+	"$WORK_DIR"/short.wav "$WORK_DIR"/short.xa
+cmp "$WORK_DIR"/short-full.xa "$WORK_DIR"/short.xa
+
+bjxa update "$WORK_DIR"/short.wav "$WORK_DIR"/short.xa \
+	"$TEST_DIR"/square-mono.wav "$WORK_DIR"/long.xa
+cmp "$WORK_DIR"/old.xa "$WORK_DIR"/long.xa
+
+_ --------------
+_ Invalid inputs
+_ --------------
+
+expect_error "format mismatch" bjxa update "$TEST_DIR"/square-mono.wav \
+	"$WORK_DIR"/old.xa "$TEST_DIR"/square-stereo.wav
+expect_error "previous files mismatch" bjxa update \
+	"$TEST_DIR"/square-mono.wav "$TEST_DIR"/square-stereo-6.xa \
+	"$TEST_DIR"/square-mono.wav
+expect_error "bjxa_fread_header" bjxa update "$TEST_DIR"/square-mono.wav \
+	"$TEST_DIR"/square-mono.wav "$TEST_DIR"/square-mono.wav
+expect_error "Missing arguments" bjxa update "$TEST_DIR"/square-mono.wav
+expect_error "Unknown option" bjxa update --bits 4
@@ -0,0 +1,70 @@
+#!/bin/sh
+#
+# Copyright (C) 2020  Dridi Boukelmoune
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+. "$(dirname "$0")"/test_setup.sh
+
+_ -------------
+_ Valid streams
+_ -------------
+
+expect_success "square-mono-4.xa: ok$" \
+	bjxa verify "$TEST_DIR"/square-mono-4.xa
+
+expect_success "^-: ok$" \
+	bjxa verify - <"$TEST_DIR"/square-stereo-8.xa
+
+_ --------------
+_ Invalid blocks
+_ --------------
+
+cp "$TEST_DIR"/square-stereo-6.xa "$WORK_DIR"/bad.xa
+printf '\120' |
+dd of="$WORK_DIR"/bad.xa bs=1 seek=$((32 + 50 * 10 + 25)) conv=notrunc \
+	2>/dev/null
+
+if bjxa verify "$TEST_DIR"/square-mono-6.xa "$WORK_DIR"/bad.xa \
+	>"$WORK_DIR"/bad.txt
+then
+	false
+fi
+
+grep "square-mono-6.xa: ok$" "$WORK_DIR"/bad.txt
+grep "bad.xa: Protocol error at offset 557 (block 10)$" "$WORK_DIR"/bad.txt
+
+head -c 1000 "$TEST_DIR"/square-mono-4.xa >"$WORK_DIR"/short.xa
+
+if bjxa verify "$WORK_DIR"/short.xa >"$WORK_DIR"/short.txt
+then
+	false
+fi
+
+grep "short.xa: Protocol error at offset 984 (block 56)$" \
+	"$WORK_DIR"/short.txt
+
+_ --------------
+_ Invalid inputs
+_ --------------
+
+if bjxa verify "$TEST_DIR"/square-mono.wav >"$WORK_DIR"/wav.txt
+then
+	false
+fi
+
+grep "square-mono.wav: Protocol error$" "$WORK_DIR"/wav.txt
+
+expect_error "Missing arguments" bjxa verify
+expect_error "No such file" bjxa verify "$WORK_DIR"/nonexistent.xa